@@ -34,27 +34,117 @@
 
 // Stack
 #define INITIAL_STACK_LENGTH 10
-#define INCREMENT_STACK_STEP 10
 #define MAX_STACK_LENGTH 99
 #define MAX_VIEWABLE_STACK 16
 
 // History
 #define INITIAL_HISTORY_LENGTH 10
-#define INCREMENT_HISTORY_STEP 10
+#define MAX_HISTORY_LENGTH 1000
 #define HISTORY_MAX_VIEWABLE_ELEMENTS 17
 
 // Memory
 #define INITIAL_MEMORIES_LENGTH 10
 #define MAX_MEMORIES_LENGTH 99
-#define INCREMENT_MEMORIES_STEP 5
 #define MEMORY_MAX_VIEWABLE_ELEMENTS 17
 #define MAX_MEMORY_NAME_LENGTH 10
+#define SHARED_REGISTERS 64
+#define SHARED_NAMESPACE "default"
+#define SHARED_READ_RETRIES 1024
+
+// Arena
+#define ARENA_CHUNK_BYTES 16384
+#define ARENA_MIN_BLOCK 32
+#define ARENA_SIZE_CLASSES 4
+
+// Journal
+#define INITIAL_JOURNAL_LENGTH 4096
+
+// Objects
+#define INCREMENT_OBJECTS_STEP 64
+#define COLLECT_OBJECTS_THRESHOLD 256
+
+// Big integers: limbs above which the faster multiplications kick in
+#define KARATSUBA_THRESHOLD 24
+#define TOOM3_THRESHOLD 400
+#define MAX_BIGINT_LIMBS (1 << 24)
+
+// Memoized operations: results kept for each of them
+#define MEMO_CACHE_LENGTH 256
+
+// Words Settings
+#define INITIAL_PROGRAM_LENGTH 16
+#define INCREMENT_WORDS_STEP 10
+#define INLINE_WORD_THRESHOLD 32
+#define INFIX_CACHE_LENGTH 32
+#define SCRATCH_STACK_LENGTH MAX_STACK_LENGTH
+#define MAX_CONTROL_DEPTH 16
+
+// RC file, in the home directory
+#define RC_FILE ".lukarc"
+#define RC_CACHE_FILE ".lukarc.cache"
+
+// Sequences Settings
+#define SEQUENCE_BLOCK_LENGTH 1024
+#define SEQUENCE_PREVIEW_LENGTH 3
+#define PARALLEL_MIN_LENGTH 65536
+#define MAX_WORKERS 64
+
+// Matrices Settings
+#define MATRIX_VECTOR_BYTES 32
+#define MATRIX_BLOCK_COLS 256
+#define MATRIX_BLOCK_DEPTH 128
+#define MATRIX_TILE 32
+#define MATRIX_PARALLEL_SIZE (1 << 21)
+#define MAX_MATRIX_SIZE 100000
+
+// FFT Settings
+#define FFT_PLAN_CACHE_LENGTH 8
+#define DIRECT_CONVOLUTION_SIZE 4096
+
+// Scan Settings
+#define SCAN_VECTOR_BYTES 32
+
+// Random Settings
+#define RANDOM_VECTOR_BYTES 32
+#define RANDOM_BLOCK_LENGTH 65536
+
+// Solver Settings
+#define INITIAL_TOLERANCE 1e-10
+#define SOLVE_MAX_ITERATIONS 100
+#define INTEGRATE_MAX_INTERVALS 100000
+#define INTEGRATE_PARALLEL_INTERVALS 64
+
+// Plot Settings: the size of the plot in characters, the samples
+// of every dot column, and how many samples a worker takes at least
+#define PLOT_WIDTH 36
+#define PLOT_HEIGHT 16
+#define PLOT_OVERSAMPLING 4
+#define PLOT_PARALLEL_SAMPLES 64
+#define TABULATE_PARALLEL_SAMPLES 4096
+
+// Stream Settings: the bytes read from the input at once
+#define STREAM_BUFFER_LENGTH 65536
+
+// Polynomial Settings
+#define MAX_POLYNOMIAL_DEGREE (1 << 24)
+#define PROOTS_MAX_ITERATIONS 500
+
+// Sort Settings
+#define RADIX_BITS 11
+#define INSERTION_SORT_LENGTH 32
 
 // Modes
 #define INITIAL_MODE 'r'
 #define INITIAL_NUMERIC_FORMAT 's'
+#define INITIAL_ARITHMETIC_MODE 'd'
+#define INITIAL_DECIMAL_PLACES 2
+#define MAX_DECIMAL_PLACES 18
 #define INITIAL_HISTORY_MODE 'l'
 
+// Asynchronous execution
+#define BUSY_DELAY_MS 200
+#define BUSY_REFRESH_MS 100
+
 //UI 
 #define PROMPT_POSITION 24
 #define ERROR_POSITION 23
@@ -63,17 +153,33 @@
 // Standard includes needed by the program
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <limits.h>
 #include <string.h>
 #include <math.h>
+#include <float.h>
+#include <complex.h>
 #include <time.h>
 #include <getopt.h>
 #include <ctype.h>
+#include <errno.h>
 #include <termios.h>
 #include <unistd.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/select.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <stdatomic.h>
 
 // Definition of the global variables
 char mode = INITIAL_MODE;
 char numeric_format = INITIAL_NUMERIC_FORMAT;
+char arithmetic_mode = INITIAL_ARITHMETIC_MODE;
+int decimal_places = INITIAL_DECIMAL_PLACES;
 char history_mode = INITIAL_HISTORY_MODE;
 
 // Variables used for memories
@@ -82,24 +188,117 @@ char **memories = NULL;
 int n_memories = 0;
 int current_memories_length = INITIAL_MEMORIES_LENGTH;
 
+// Shared registers (memories named @name)
+struct shared_segment *shared_segment = NULL;
+char *shared_namespace = SHARED_NAMESPACE;
+
+// Window of the stream mode, 0 to run the calculator
+long stream_window = 0;
+
 // Variables used for history
 char **operation_log = NULL;
 int n_operation_log = 0;
 int current_history_length = INITIAL_HISTORY_LENGTH;
+int history_suspended = 0;
 
 // Variables used for stack
 double *stack = NULL;
 int sp = 0;
 int current_stack_length = INITIAL_STACK_LENGTH;
 
+// Variables used for the undo/redo journal
+struct journal_entry *journal = NULL;
+int journal_length = INITIAL_JOURNAL_LENGTH;
+unsigned long journal_head = 0;
+unsigned long journal_cursor = 0;
+unsigned long journal_end = 0;
+int journal_step = 0;
+int journal_broken_step = -1;
+int journal_collapsed = 0;
+double journal_saved_stack[MAX_STACK_LENGTH];
+int journal_saved_sp = 0;
+int journal_saved_length = 0;
+
+// Variables used for the objects living on the stack
+struct object *objects = NULL;
+int objects_length = 0;
+int objects_free = -1;
+int objects_created = 0;
+
+// Words
+struct word *words = NULL;
+struct program *programs = NULL;
+int n_words = 0;
+int current_words_length = 0;
+
+// Infix expressions
+struct infix_entry *infix_cache = NULL;
+unsigned long infix_clock = 0;
+
+// FFT plans
+struct fft_plan *fft_plans = NULL;
+unsigned long fft_clock = 0;
+
+// State of the random generator
+unsigned long long random_state[4];
+
+// Set by the commands whose result changes at every run (random
+// numbers, seed, shared registers), so the rc file isn't cached
+atomic_int unrepeatable = 0;
+
+// Tolerance of solve and integrate
+double tolerance = INITIAL_TOLERANCE;
+
+// Workers for the parallel loops (0 = one per processor)
+int n_workers = 0;
+
+// Variables used for the asynchronous execution of the commands
+volatile sig_atomic_t cancel_requested = 0;
+volatile sig_atomic_t terminal_owned_by_job = 0;
+volatile double job_progress = -1;
+double time_budget = 0;
+char typeahead[MAX_INPUT_BUFFER];
+int typeahead_length = 0;
+
+// Variables used for statistics
+struct statistics {
+  int n;
+  double mean_x, mean_y;
+  double m2_x, m2_y, c_xy;
+  double min_x, max_x;
+} statistics = {0};
+
 // UI
 int history_view_offset = 0;
 int memory_view_offset = 0;
 char error_buffer[70];
 
 // Local includes
+#include "luka_arena.c"
 #include "luka_stack.c"
+#include "luka_journal.c"
+#include "luka_async.c"
 #include "luka_functions.c"
+#include "luka_objects.c"
+#include "luka_bigint.c"
+#include "luka_dd.c"
+#include "luka_decimal.c"
+#include "luka_shared.c"
+#include "luka_stats.c"
+#include "luka_words.c"
+#include "luka_infix.c"
+#include "luka_parallel.c"
+#include "luka_sequences.c"
+#include "luka_matrix.c"
+#include "luka_fft.c"
+#include "luka_sort.c"
+#include "luka_scan.c"
+#include "luka_random.c"
+#include "luka_solve.c"
+#include "luka_plot.c"
+#include "luka_poly.c"
+#include "luka_rc.c"
+#include "luka_stream.c"
 #include "luka_ui.c"
 
 // Function Pointers
@@ -120,6 +319,40 @@ int check_input_if_numeric(char* input, double* value) {
   return endptr[0] == '\0';
 }
 
+/* Parse a number typed by the user, in the current arithmetic mode.
+   Returns 0 if the input isn't a number */
+int parse_numeric_input(char* input, double* value) {
+  if (arithmetic_mode == 'b' && is_integer_literal(input)) {
+    *value = make_bigint(bigint_from_string(input));
+    return 1;
+  }
+
+  struct decimal fixed;
+  if (arithmetic_mode == 'k' && decimal_parse(input, decimal_places, &fixed)) {
+    *value = make_decimal(fixed);
+    return 1;
+  }
+
+  if (!check_input_if_numeric(input, value) || is_object(*value)) return 0;
+
+  struct dd extended;
+  if (arithmetic_mode == 'q' && isfinite(*value) && dd_parse(input, &extended)) {
+    *value = make_dd(extended);
+  }
+
+  return 1;
+}
+
+/* Push the input to the stack if it's numeric */
+int push_numeric_input(char* input) {
+  double value = 0;
+
+  if (!parse_numeric_input(input, &value)) return 0;
+
+  push(value);
+  return 1;
+}
+
 /* Set Mode:
    d = DEG mode
    r = RAD mode */
@@ -173,15 +406,67 @@ void set_memory_history_mode(void) {
 
 /* Compute the command received */
 int compute(char* input) {
-  double value = 0;
   operation_2o operation_2o = NULL;
   operation_1o operation_1o = NULL;
   operation_0o_with_parameter operation_0o_with_parameter = NULL;
   operation_0o operation_0o = NULL;
+  struct word *word = NULL;
 
   char parameter[100] = "";
   char command[100] = "";
 
+  // Every command is a single step for undo and redo
+  journal_begin_step();
+
+  // Between two commands every object still in use is reachable
+  maybe_collect_objects();
+
+  // A word definition takes the whole line
+  if (input[0] == ':' && (input[1] == ' ' || input[1] == '\0')) {
+    define_word(input);
+    return 0;
+  }
+
+  // An expression seen before is run at once, without compiling the line
+  if (is_infix_expression(input) && is_cached_infix_expression(input)) {
+    evaluate_infix(input);
+    return 0;
+  }
+
+  /* A line of many commands is compiled and run as a single one
+     too, unless it reads as an infix expression: "2 3 *" is a line
+     of commands, "2 * 3" an expression */
+  char saved_error[sizeof(error_buffer)];
+  char line_error[sizeof(error_buffer)] = "";
+  struct program *line = NULL;
+  strcpy(saved_error, error_buffer);
+  if (is_command_line(input)) {
+    error_buffer[0] = '\0';
+    line = compile_line(input);
+    strcpy(line_error, error_buffer);
+    strcpy(error_buffer, saved_error);
+  }
+
+  if (is_infix_expression(input)) {
+    int infix = line == NULL || (!has_adjacent_numbers(input) && get_infix_program(input) != NULL);
+    strcpy(error_buffer, saved_error);
+    if (infix) {
+      if (line != NULL) program_free(line);
+      evaluate_infix(input);
+      return 0;
+    }
+  }
+
+  if (line != NULL) {
+    run_line(line, input);
+    return 0;
+  }
+
+  if (line_error[0] != '\0') {
+    strcpy(error_buffer, line_error);
+    return 0;
+  }
+
   char* token = strtok(input, " ");
   int i = 0;
   while (token != NULL) {
@@ -192,8 +477,13 @@ int compute(char* input) {
 
   /* If the input is numeric just push it to the stack
      and return */
-  if (check_input_if_numeric(command, &value)) {
-    push(value);
+  if (push_numeric_input(command)) {
+    return 0;
+  }
+
+  // User defined words come first, so they can redefine a command
+  if ((word = get_word(command))) {
+    run_word(word);
     return 0;
   }
 
@@ -249,12 +539,12 @@ void power_fgets(char *buffer, int max_len) {
 
     int i = 0;
     while (i < max_len - 1) {
-        char c = getchar();
+        char c = read_key();
 
         if (c == 27) { // if an escape char has been pressed...
-          char seq1 = getchar();
+          char seq1 = read_key();
           if (seq1 == '[') {
-            char seq2 = getchar();
+            char seq2 = read_key();
             switch (seq2) {
             case 'A': strcpy(buffer, "arrow_up\0"); break; 
             case 'B': strcpy(buffer, "arrow_down\0"); break;
@@ -289,19 +579,28 @@ void power_fgets(char *buffer, int max_len) {
     disable_raw_mode(&old_termios);
 }
 
+/* Turn a line to lower case, except the file names given to aload
+   and mload, that may have capitals */
+void lowercase_input(char *input) {
+  int file_name = 0;
+  while (*input) {
+    input += strspn(input, " ");
+    size_t length = strcspn(input, " ");
+    if (!file_name) {
+      for (size_t i = 0; i < length; i++) input[i] = tolower((unsigned char) input[i]);
+    }
+    file_name = (length == 5 && (strncmp(input, "aload", 5) == 0 || strncmp(input, "mload", 5) == 0));
+    input += length;
+  }
+}
+
 /* Get the user input */
 void get_input(char* input) {
     locate(1,PROMPT_POSITION);
     printf("─────────\n");
     printf("‣ ");
     power_fgets(input, MAX_INPUT_BUFFER - 1);
-
-    // to lower case
-    while (*input) {
-        *input = tolower((unsigned char)*input);
-        input++;
-    }
-
+    lowercase_input(input);
     input[strcspn(input, "\n")] = '\0';
 }
 
@@ -309,28 +608,73 @@ void get_input(char* input) {
 void handle_command_line_parameters(int argc, char* argv[]) {
   int opt = 0;
   int option_index = 0;
+  int rc = 1;
+  char option_mode = 0;
+  char option_format = 0;
 
   static struct option long_options[] = {
     {"deg", no_argument, 0, 'd'},
     {"rad", no_argument, 0, 'r'},
     {"sci", no_argument, 0, 's'},
     {"fix", no_argument, 0, 'f'},
+    {"journal", required_argument, 0, 'j'},
+    {"budget", required_argument, 0, 'b'},
+    {"shared", required_argument, 0, 'S'},
+    {"norc", no_argument, 0, 'n'},
+    {"stream", required_argument, 0, 'w'},
     {"help", no_argument, 0, 'h'},
     {"version", no_argument, 0, 'V'},
     {0, 0, 0, 0}
   };
 
-  while ((opt = getopt_long(argc, argv, "drsfV", long_options, &option_index))!=-1) {
+  while ((opt = getopt_long(argc, argv, "drsfj:b:S:nw:V", long_options, &option_index))!=-1) {
     switch(opt) {
-      case 'd': set_mode('d'); break;
-      case 'r': set_mode('r'); break;
-      case 's': set_numeric_format('s'); break;
-      case 'f': set_numeric_format('f'); break;
+      case 'd': option_mode = 'd'; break;
+      case 'r': option_mode = 'r'; break;
+      case 's': option_format = 's'; break;
+      case 'f': option_format = 'f'; break;
+      case 'n': rc = 0; break;
+      case 'j': 
+        journal_length = atoi(optarg);
+        if (journal_length < 1) {
+          fprintf(stderr, "The journal must have at least 1 entry\n");
+          exit(1);
+        }
+        break;
+      case 'b':
+        if (!check_input_if_numeric(optarg, &time_budget) || time_budget < 0) {
+          fprintf(stderr, "The time budget must be a number of seconds\n");
+          exit(1);
+        }
+        break;
+      case 'w':
+        stream_window = atol(optarg);
+        if (stream_window < 1) {
+          fprintf(stderr, "The stream window must have at least 1 number\n");
+          exit(1);
+        }
+        break;
+      case 'S':
+        if (strlen(optarg) > 32 || strspn(optarg, "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_-") != strlen(optarg)) {
+          fprintf(stderr, "The shared namespace must be up to 32 letters, digits, - or _\n");
+          exit(1);
+        }
+        shared_namespace = optarg;
+        if (get_shared_segment() == NULL) {
+          fprintf(stderr, "Can't open the shared registers of %s\n", shared_namespace);
+          exit(1);
+        }
+        break;
       case 'h': show_command_line_help(); exit(0);
       case 'V': show_version(); exit(0);
       case '?': exit(1);
     }
   }
+
+  // The rc file comes first, so the options override it
+  if (rc) load_rc();
+  if (option_mode) set_mode(option_mode);
+  if (option_format) set_numeric_format(option_format);
 }
 
 /* Get the no operands operation corresponding
@@ -357,6 +701,18 @@ operation_0o get_operation_0o(char* operation) {
     return push_random;
   }
 
+  if (strcmp(operation, "rndn") == 0) {
+    return push_normal;
+  }
+
+  if (strcmp(operation, "runif") == 0) {
+    return push_uniform_array;
+  }
+
+  if (strcmp(operation, "rnorm") == 0) {
+    return push_normal_array;
+  }
+
   if (strcmp(operation, "e") == 0) {
     return push_e;
   }
@@ -369,6 +725,130 @@ operation_0o get_operation_0o(char* operation) {
     return set_deg_mode;
   }
 
+  if (strcmp(operation, "big") == 0) {
+    return set_big_arithmetic_mode;
+  }
+
+  if (strcmp(operation, "dd") == 0) {
+    return set_dd_arithmetic_mode;
+  }
+
+  if (strcmp(operation, "dbl") == 0) {
+    return set_double_arithmetic_mode;
+  }
+
+  if (strcmp(operation, "range") == 0) {
+    return push_range;
+  }
+
+  if (strcmp(operation, "array") == 0) {
+    return push_array;
+  }
+
+  if (strcmp(operation, "sum") == 0) {
+    return sequence_sum;
+  }
+
+  if (strcmp(operation, "prod") == 0) {
+    return sequence_product;
+  }
+
+  if (strcmp(operation, "min") == 0) {
+    return sequence_min;
+  }
+
+  if (strcmp(operation, "max") == 0) {
+    return sequence_max;
+  }
+
+  if (strcmp(operation, "len") == 0) {
+    return sequence_length;
+  }
+
+  if (strcmp(operation, "cumsum") == 0) {
+    return cumulative_sum;
+  }
+
+  if (strcmp(operation, "cumprod") == 0) {
+    return cumulative_product;
+  }
+
+  if (strcmp(operation, "cummax") == 0) {
+    return cumulative_max;
+  }
+
+  if (strcmp(operation, "cummin") == 0) {
+    return cumulative_min;
+  }
+
+  if (strcmp(operation, "diff") == 0) {
+    return difference;
+  }
+
+  if (strcmp(operation, "sort") == 0) {
+    return sort_array;
+  }
+
+  if (strcmp(operation, "median") == 0) {
+    return compute_median;
+  }
+
+  if (strcmp(operation, "rank") == 0) {
+    return rank_array;
+  }
+
+  if (strcmp(operation, "uniq") == 0) {
+    return unique_array;
+  }
+
+  if (strcmp(operation, "matrix") == 0) {
+    return push_matrix;
+  }
+
+  if (strcmp(operation, "eye") == 0) {
+    return push_identity;
+  }
+
+  if (strcmp(operation, "inv") == 0) {
+    return invert_matrix;
+  }
+
+  if (strcmp(operation, "trn") == 0) {
+    return transpose_matrix;
+  }
+
+  if (strcmp(operation, "det") == 0) {
+    return push_determinant;
+  }
+
+  if (strcmp(operation, "fft") == 0) {
+    return compute_fft;
+  }
+
+  if (strcmp(operation, "ifft") == 0) {
+    return compute_ifft;
+  }
+
+  if (strcmp(operation, "conv") == 0) {
+    return compute_convolution;
+  }
+
+  if (strcmp(operation, "psd") == 0) {
+    return compute_power_spectrum;
+  }
+
+  if (strcmp(operation, "poly") == 0) {
+    return push_polynomial;
+  }
+
+  if (strcmp(operation, "peval") == 0) {
+    return evaluate_polynomial;
+  }
+
+  if (strcmp(operation, "proots") == 0) {
+    return compute_polynomial_roots;
+  }
+
   if (strcmp(operation, "fix") == 0) {
     return set_fix_numeric_format;
   }
@@ -381,6 +861,14 @@ operation_0o get_operation_0o(char* operation) {
       return show_license_message;
   }
 
+  if (strcmp(operation, "mem") == 0) {
+    return show_memory_usage;
+  }
+
+  if (strcmp(operation, "show") == 0) {
+    return show_value;
+  }
+
   if ((strcmp(operation, "help") == 0) ||
       (strcmp(operation, "h") == 0)) {
     return show_help;
@@ -401,6 +889,47 @@ operation_0o get_operation_0o(char* operation) {
     return swap;
   }
 
+  if ((strcmp(operation, "Σ+") == 0) ||
+      (strcmp(operation, "s+") == 0)) {
+    return sigma_plus;
+  }
+
+  if ((strcmp(operation, "Σ-") == 0) ||
+      (strcmp(operation, "s-") == 0)) {
+    return sigma_minus;
+  }
+
+  if ((strcmp(operation, "Σclr") == 0) ||
+      (strcmp(operation, "sclr") == 0)) {
+    return sigma_clear;
+  }
+
+  if (strcmp(operation, "mean") == 0) {
+    return push_mean;
+  }
+
+  if (strcmp(operation, "sdev") == 0) {
+    return push_standard_deviation;
+  }
+
+  if (strcmp(operation, "lr") == 0) {
+    return push_linear_regression;
+  }
+
+  if (strcmp(operation, "corr") == 0) {
+    return push_correlation;
+  }
+
+  if ((strcmp(operation, "undo") == 0) ||
+      (strcmp(operation, "u") == 0)) {
+    return undo;
+  }
+
+  if ((strcmp(operation, "redo") == 0) ||
+      (strcmp(operation, "r") == 0)) {
+    return redo;
+  }
+
   if (strcmp(operation, "history") == 0) {
     return set_log_history_mode;
   }
@@ -430,6 +959,10 @@ operation_0o get_operation_0o(char* operation) {
     if (history_mode == 'm') {
       memory_view_offset = memory_view_offset + 1;
     }
+
+    if (history_mode == 'p') {
+      plot_zoom(0.5);
+    }
     return view_status;
   }
 
@@ -443,6 +976,10 @@ operation_0o get_operation_0o(char* operation) {
       memory_view_offset = memory_view_offset - 1;
       if (memory_view_offset < 0) memory_view_offset = 0;
     }
+
+    if (history_mode == 'p') {
+      plot_zoom(2);
+    }
     return view_status;
   }
 
@@ -461,6 +998,48 @@ operation_0o_with_parameter get_operation_0o_with_parameter(char *operation) {
   if (strcmp(operation, "del") == 0) {
     return del;}
 
+  if (strcmp(operation, "budget") == 0) {
+    return set_time_budget;}
+
+  if (strcmp(operation, "map") == 0) {
+    return sequence_map;}
+
+  if (strcmp(operation, "filter") == 0) {
+    return sequence_filter;}
+
+  if (strcmp(operation, "solve") == 0) {
+    return solve;}
+
+  if (strcmp(operation, "integrate") == 0) {
+    return integrate;}
+
+  if (strcmp(operation, "tol") == 0) {
+    return set_tolerance;}
+
+  if (strcmp(operation, "seed") == 0) {
+    return set_seed;}
+
+  if (strcmp(operation, "mc") == 0) {
+    return monte_carlo;}
+
+  if (strcmp(operation, "aload") == 0) {
+    return load_array;}
+
+  if (strcmp(operation, "pct") == 0) {
+    return compute_pct;}
+
+  if (strcmp(operation, "mload") == 0) {
+    return load_matrix;}
+
+  if (strcmp(operation, "dec") == 0) {
+    return set_decimal_arithmetic_mode;}
+
+  if (strcmp(operation, "tabulate") == 0) {
+    return tabulate;}
+
+  if (strcmp(operation, "plot") == 0) {
+    return plot_word;}
+
   return NULL;
 }
 
@@ -473,6 +1052,9 @@ operation_1o get_operation_1o(char *operation) {
   if (strcmp(operation, "sqrt") == 0) {
     return sqrt;}
 
+  if (strcmp(operation, "exp") == 0) {
+    return exp;}
+
   if (strcmp(operation, "log10") == 0) {
     return log10;}
 
@@ -527,20 +1109,47 @@ operation_2o get_operation_2o(char *operation) {
   if (strcmp(operation, "/") == 0) {
     return division;}
 
+  if ((strcmp(operation, "mod") == 0) ||
+      (strcmp(operation, "%") == 0)) {
+    return modulo;}
+
   if ((strcmp(operation, "power") == 0) ||
       (strcmp(operation, "pow") == 0) ||
       (strcmp(operation, "^") == 0)) {
     return to_power;}
 
+  if (strcmp(operation, "<") == 0) {
+    return less_than;}
+
+  if (strcmp(operation, ">") == 0) {
+    return greater_than;}
+
+  if (strcmp(operation, "<=") == 0) {
+    return less_or_equal;}
+
+  if (strcmp(operation, ">=") == 0) {
+    return greater_or_equal;}
+
+  if (strcmp(operation, "==") == 0) {
+    return equal_to;}
+
+  if (strcmp(operation, "!=") == 0) {
+    return not_equal_to;}
+
   return NULL;
 }
 
 /* Free all the pointers pointing the heap */ 
 void free_pointers(void) {
-  free(stack);
-  free(operation_log);
-  free(memories);
-  free(values);
+  free_history();
+  free_memories();
+  arena_free(stack);
+  free_journal();
+  free_objects();
+  free_infix_cache();
+  free_fft_plans();
+  free_words();
+  free_shared_segment();
 }
 
 /* Entry point */
@@ -550,30 +1159,33 @@ int main(int argc, char* argv[]) {
   // Call the free_pointers function when exiting
   atexit(free_pointers);
 
+  // Never leave the terminal in raw mode, even if a job exits the program
+  atexit(restore_job_terminal);
+
   /* Randomize the seed 
      of the random number generator*/
-  srand48(time(NULL));
+  randomize();
 
   /* Allocate memory */
-  operation_log = malloc(INITIAL_HISTORY_LENGTH * sizeof(char*));
+  operation_log = arena_alloc(ARENA_HISTORY, INITIAL_HISTORY_LENGTH * sizeof(char*));
   if (operation_log == NULL) {
     fprintf(stderr, "Failed to allocate operation log\n");
     exit(EXIT_FAILURE);
   }
 
-  memories = malloc(INITIAL_MEMORIES_LENGTH * sizeof(char*));
+  memories = arena_alloc(ARENA_MEMORIES, INITIAL_MEMORIES_LENGTH * sizeof(char*));
   if (memories == NULL) {
     fprintf(stderr, "Failed to allocate memory names\n");
     exit(EXIT_FAILURE);
   }
 
-  values = malloc(INITIAL_MEMORIES_LENGTH * sizeof(double));
+  values = arena_alloc(ARENA_MEMORIES, INITIAL_MEMORIES_LENGTH * sizeof(double));
   if (values == NULL) {
     fprintf(stderr, "Failed to allocate memory values\n");
     exit(EXIT_FAILURE);
   }
 
-  stack = malloc(INITIAL_STACK_LENGTH * sizeof(double));
+  stack = arena_alloc(ARENA_STACK, INITIAL_STACK_LENGTH * sizeof(double));
   if (stack == NULL) {
     fprintf(stderr, "Failed to allocate stack\n");
     exit(EXIT_FAILURE);
@@ -581,11 +1193,20 @@ int main(int argc, char* argv[]) {
 
   handle_command_line_parameters(argc, argv);
 
+  // In stream mode there's no calculator to show
+  if (stream_window > 0) return run_stream(stream_window);
+
+  journal = arena_alloc(ARENA_JOURNAL, journal_length * sizeof(struct journal_entry));
+  if (journal == NULL) {
+    fprintf(stderr, "Failed to allocate the undo journal\n");
+    exit(EXIT_FAILURE);
+  }
+
   // this is the REPL
   while (1) {                       // L
     view_status();                  // P
     get_input(input);               // R
-    if (compute(input)) break;      // E
+    if (run_command(input)) break;  // E
   }
 
   return 0;
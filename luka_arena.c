@@ -0,0 +1,243 @@
+// SPDX-License-Identifier: GPL-2.0
+/* luka_arena.c
+ *
+ * A simple RPN calculator for terminal
+ * made with love in Italy.
+ *
+ * Copyright 2025 Davide Mastromatteo
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/* ---------------
+   ARENA FUNCTIONS
+   --------------- */
+
+/* Everything that lives as long as the session (the stack, the
+   history, the memories, the journal, the objects with the values they
+   hold and the words) is allocated here, on behalf of a subsystem, so mem can
+   tell how many bytes each one holds.
+
+   Small blocks, like the history entries and the memory names, come
+   from pools of ARENA_CHUNK_BYTES chunks, one pool per size class.
+   A chunk is aligned to its size, so a block finds its chunk by
+   masking its address; when the last block of a chunk is freed the
+   chunk goes back to the system, unless it's the only one left in
+   its pool. Larger blocks go straight to malloc. Every block starts
+   with a small header telling its size, class and subsystem. */
+
+enum arena_subsystem {
+  ARENA_STACK,
+  ARENA_HISTORY,
+  ARENA_MEMORIES,
+  ARENA_JOURNAL,
+  ARENA_OBJECTS,
+  ARENA_ARRAYS,
+  ARENA_WORDS,
+  ARENA_SUBSYSTEMS
+};
+
+char *arena_subsystem_names[ARENA_SUBSYSTEMS] = {
+  "stack", "history", "memories", "journal", "objects", "arrays", "words"
+};
+
+struct arena_block {
+  size_t size;
+  int subsystem;
+  int size_class;
+};
+
+struct arena_chunk {
+  struct arena_chunk *next;
+  struct arena_chunk *prev;
+  struct arena_block *free;
+  int used;
+  int size_class;
+};
+
+/* The chunks of each size class that have some free block */
+struct arena_chunk *arena_pools[ARENA_SIZE_CLASSES];
+long arena_live[ARENA_SUBSYSTEMS];
+long arena_chunks = 0;
+long arena_pooled = 0;
+pthread_mutex_t arena_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Size of the blocks of a class, header included */
+size_t arena_class_size(int size_class) {
+  return (size_t) ARENA_MIN_BLOCK << size_class;
+}
+
+/* The smallest class holding a block, -1 if it's too big for the pools */
+int arena_size_class(size_t total) {
+  for (int c = 0; c < ARENA_SIZE_CLASSES; c++) {
+    if (total <= arena_class_size(c)) return c;
+  }
+  return -1;
+}
+
+/* The chunk a pooled block belongs to */
+struct arena_chunk *arena_chunk_of(struct arena_block *b) {
+  return (struct arena_chunk *) ((uintptr_t) b & ~(uintptr_t) (ARENA_CHUNK_BYTES - 1));
+}
+
+void arena_link(struct arena_chunk *chunk) {
+  chunk->prev = NULL;
+  chunk->next = arena_pools[chunk->size_class];
+  if (chunk->next != NULL) chunk->next->prev = chunk;
+  arena_pools[chunk->size_class] = chunk;
+}
+
+void arena_unlink(struct arena_chunk *chunk) {
+  if (chunk->prev != NULL) chunk->prev->next = chunk->next;
+  else arena_pools[chunk->size_class] = chunk->next;
+  if (chunk->next != NULL) chunk->next->prev = chunk->prev;
+}
+
+/* Get a new chunk for a pool, with all its blocks free */
+struct arena_chunk *arena_chunk_new(int size_class) {
+  struct arena_chunk *chunk = aligned_alloc(ARENA_CHUNK_BYTES, ARENA_CHUNK_BYTES);
+  if (chunk == NULL) {
+    printf("ERROR: You run out of memory. Exiting.");
+    exit(1);
+  }
+
+  size_t size = arena_class_size(size_class);
+  char *first = (char *) chunk + arena_class_size(0);
+  char *end = (char *) chunk + ARENA_CHUNK_BYTES;
+  chunk->free = NULL;
+  for (char *b = end - size; b >= first; b -= size) {
+    *(struct arena_block **) b = chunk->free;
+    chunk->free = (struct arena_block *) b;
+  }
+  chunk->used = 0;
+  chunk->size_class = size_class;
+  arena_link(chunk);
+  arena_chunks++;
+  return chunk;
+}
+
+/* Allocate size bytes on behalf of a subsystem,
+   NULL if a large block doesn't fit in memory */
+void *arena_try_alloc(int subsystem, size_t size) {
+  size_t total = size + sizeof(struct arena_block);
+  int c = arena_size_class(total);
+  struct arena_block *b;
+
+  if (c == -1 && (b = malloc(total)) == NULL) return NULL;
+
+  pthread_mutex_lock(&arena_lock);
+  if (c != -1) {
+    struct arena_chunk *chunk = arena_pools[c] != NULL ? arena_pools[c] : arena_chunk_new(c);
+    b = chunk->free;
+    chunk->free = *(struct arena_block **) b;
+    chunk->used++;
+    arena_pooled += arena_class_size(c);
+    if (chunk->free == NULL) arena_unlink(chunk);
+  }
+  b->size = size;
+  b->subsystem = subsystem;
+  b->size_class = c;
+  arena_live[subsystem] += size;
+  pthread_mutex_unlock(&arena_lock);
+  return b + 1;
+}
+
+/* Allocate size bytes on behalf of a subsystem */
+void *arena_alloc(int subsystem, size_t size) {
+  void *p = arena_try_alloc(subsystem, size);
+  if (p == NULL) {
+    printf("ERROR: You run out of memory. Exiting.");
+    exit(1);
+  }
+  return p;
+}
+
+/* Allocate size bytes set to zero on behalf of a subsystem,
+   NULL if a large block doesn't fit in memory */
+void *arena_try_calloc(int subsystem, size_t size) {
+  void *p = arena_try_alloc(subsystem, size);
+  if (p != NULL) memset(p, 0, size);
+  return p;
+}
+
+/* Free a block, giving its chunk back when it's empty */
+void arena_free(void *p) {
+  if (p == NULL) return;
+  struct arena_block *b = (struct arena_block *) p - 1;
+
+  pthread_mutex_lock(&arena_lock);
+  arena_live[b->subsystem] -= b->size;
+  if (b->size_class == -1) free(b);
+  else {
+    struct arena_chunk *chunk = arena_chunk_of(b);
+    arena_pooled -= arena_class_size(b->size_class);
+    if (chunk->free == NULL) arena_link(chunk);
+    *(struct arena_block **) b = chunk->free;
+    chunk->free = b;
+    chunk->used--;
+    if (chunk->used == 0 && (chunk->next != NULL || chunk->prev != NULL)) {
+      arena_unlink(chunk);
+      free(chunk);
+      arena_chunks--;
+    }
+  }
+  pthread_mutex_unlock(&arena_lock);
+}
+
+/* Resize a block, keeping its content and its subsystem.
+   NULL if it doesn't fit in memory, leaving the block as it was */
+void *arena_try_realloc(int subsystem, void *p, size_t size) {
+  if (p == NULL) return arena_try_alloc(subsystem, size);
+  struct arena_block *b = (struct arena_block *) p - 1;
+  size_t total = size + sizeof(struct arena_block);
+
+  // Big blocks grow in place when malloc can
+  if (b->size_class == -1 && arena_size_class(total) == -1) {
+    size_t old_size = b->size;
+    struct arena_block *grown = realloc(b, total);
+    if (grown == NULL) return NULL;
+    pthread_mutex_lock(&arena_lock);
+    grown->size = size;
+    arena_live[grown->subsystem] += (long) size - (long) old_size;
+    pthread_mutex_unlock(&arena_lock);
+    return grown + 1;
+  }
+
+  void *q = arena_try_alloc(subsystem, size);
+  if (q == NULL) return NULL;
+  memcpy(q, p, b->size < size ? b->size : size);
+  arena_free(p);
+  return q;
+}
+
+/* Resize a block, keeping its content and its subsystem */
+void *arena_realloc(int subsystem, void *p, size_t size) {
+  void *q = arena_try_realloc(subsystem, p, size);
+  if (q == NULL) {
+    printf("ERROR: You run out of memory. Exiting.");
+    exit(1);
+  }
+  return q;
+}
+
+/* Copy a string on behalf of a subsystem */
+char *arena_strdup(int subsystem, const char *s) {
+  size_t size = strlen(s) + 1;
+  return memcpy(arena_alloc(subsystem, size), s, size);
+}
+
+/* Size of a block, as it was asked */
+size_t arena_size(void *p) {
+  return p == NULL ? 0 : ((struct arena_block *) p - 1)->size;
+}
@@ -0,0 +1,238 @@
+// SPDX-License-Identifier: GPL-2.0
+/* luka_async.c
+ *
+ * A simple RPN calculator for terminal
+ * made with love in Italy.
+ *
+ * Copyright 2025 Davide Mastromatteo
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+int compute(char*);
+int check_input_if_numeric(char*, double*);
+void trim_history(void);
+
+/* -------------------------
+   ASYNCHRONOUS JOB FUNCTIONS
+   ------------------------- */
+
+/* Every command runs on a worker thread while the main thread keeps
+   the terminal alive: after BUSY_DELAY_MS it shows a busy indicator,
+   and Ctrl-C or Esc ask the job to stop. Long operations cooperate
+   calling job_cancelled() every now and then, and may report how far
+   they are with set_job_progress(). A cancelled command is rolled back
+   through the journal, so the stack is left as it was before it. */
+
+struct job {
+  char *input;
+  int result;
+  int done_pipe[2];
+};
+
+struct termios job_old_termios;
+int job_terminal_raw = 0;
+
+/* Tell if the running job has been asked to stop */
+int job_cancelled(void) {
+  return cancel_requested;
+}
+
+/* Report the progress of the running job (from 0 to 1) */
+void set_job_progress(double fraction) {
+  job_progress = fraction;
+}
+
+/* Wait for the user to press ENTER, taking the terminal
+   away from the main thread while the job waits */
+void wait_for_enter(void) {
+  terminal_owned_by_job = 1;
+  int c;
+  while ((c = getchar()) != '\n' && c != EOF);
+  terminal_owned_by_job = 0;
+}
+
+/* Read a key, consuming first what has been typed while a job was running */
+int read_key(void) {
+  if (typeahead_length > 0) {
+    int c = (unsigned char) typeahead[0];
+    memmove(typeahead, typeahead + 1, --typeahead_length);
+    return c;
+  }
+  return getchar();
+}
+
+/* Ctrl-C handler used while a job is running: the first one
+   asks the job to stop, the second one gives up and exits */
+void handle_job_interrupt(int signal_number) {
+  if (cancel_requested) {
+    signal(signal_number, SIG_DFL);
+    raise(signal_number);
+  }
+  cancel_requested = 1;
+}
+
+/* Give the terminal back in the state the job found it */
+void restore_job_terminal(void) {
+  if (job_terminal_raw) {
+    tcsetattr(STDIN_FILENO, TCSANOW, &job_old_termios);
+    job_terminal_raw = 0;
+  }
+}
+
+/* Body of the worker thread */
+void *job_thread(void *argument) {
+  struct job *j = argument;
+  j->result = compute(j->input);
+  if (write(j->done_pipe[1], "", 1) < 0) perror("write");
+  return NULL;
+}
+
+/* Get the elapsed seconds since a given time */
+double elapsed_since(struct timespec *start) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/* Show the busy indicator while a job is running */
+void show_busy(double elapsed) {
+  static const char *spinner[] = {"⠋", "⠙", "⠹", "⠸", "⠼", "⠴", "⠦", "⠧", "⠇", "⠏"};
+  static int frame = 0;
+
+  locate(1, ERROR_POSITION);
+  printf("\x1B[2K%s busy %.1fs", spinner[frame++ % 10], elapsed);
+  if (job_progress >= 0) printf(" %3.0f%%", job_progress * 100);
+  printf("  (Esc or Ctrl-C to cancel)");
+  fflush(stdout);
+}
+
+/* Look at what the user typed while the job was running:
+   Esc cancels the job, anything else is kept for the prompt */
+void handle_job_keyboard(void) {
+  char c;
+  if (read(STDIN_FILENO, &c, 1) != 1) return;
+
+  if (c == 27) {
+    /* Arrows send an escape sequence too:
+       only a lonely Esc cancels the job */
+    fd_set fds;
+    struct timeval no_wait = {0, 0};
+    FD_ZERO(&fds);
+    FD_SET(STDIN_FILENO, &fds);
+    if (select(STDIN_FILENO + 1, &fds, NULL, NULL, &no_wait) <= 0) {
+      cancel_requested = 1;
+      return;
+    }
+  }
+
+  if (typeahead_length < MAX_INPUT_BUFFER) typeahead[typeahead_length++] = c;
+}
+
+/* Run a command on the worker thread, keeping the UI responsive.
+   A cancelled command is rolled back through the journal, and the
+   random generator is put back too. Word definitions run right here,
+   they're quick and can't be cancelled; shared register writes and
+   the memo caches keep what a cancelled command did */
+int run_command(char *input) {
+  struct job j = { input, 0, {-1, -1} };
+  pthread_t worker;
+
+  trim_history();
+  if (input[0] == ':' && (input[1] == ' ' || input[1] == '\0')) return compute(input);
+  unsigned long journal_mark = journal_cursor;
+  int history_mark = n_operation_log;
+  unsigned long long random_mark[4];
+  memcpy(random_mark, random_state, sizeof(random_mark));
+  int interactive = isatty(STDIN_FILENO);
+  int budget_exceeded = 0;
+
+  cancel_requested = 0;
+  job_progress = -1;
+
+  if (pipe(j.done_pipe) != 0) return compute(input);
+  if (pthread_create(&worker, NULL, job_thread, &j) != 0) {
+    close(j.done_pipe[0]);
+    close(j.done_pipe[1]);
+    return compute(input);
+  }
+
+  signal(SIGINT, handle_job_interrupt);
+  if (interactive) {
+    struct termios raw_termios;
+    tcgetattr(STDIN_FILENO, &job_old_termios);
+    raw_termios = job_old_termios;
+    raw_termios.c_lflag &= ~(ICANON | ECHO);
+    tcsetattr(STDIN_FILENO, TCSANOW, &raw_termios);
+    job_terminal_raw = 1;
+  }
+
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  while (1) {
+    fd_set fds;
+    struct timeval timeout = {0, BUSY_REFRESH_MS * 1000};
+    int watch_keyboard = interactive && !terminal_owned_by_job;
+
+    FD_ZERO(&fds);
+    FD_SET(j.done_pipe[0], &fds);
+    if (watch_keyboard) FD_SET(STDIN_FILENO, &fds);
+
+    int ready = select(j.done_pipe[0] + 1, &fds, NULL, NULL, &timeout);
+    if (ready > 0 && FD_ISSET(j.done_pipe[0], &fds)) break;
+
+    // the job may have taken the terminal while we were waiting
+    if (ready > 0 && watch_keyboard && !terminal_owned_by_job && FD_ISSET(STDIN_FILENO, &fds)) {
+      handle_job_keyboard();
+    }
+
+    double elapsed = elapsed_since(&start);
+    if (time_budget > 0 && elapsed > time_budget && !cancel_requested) {
+      budget_exceeded = 1;
+      cancel_requested = 1;
+    }
+
+    if (elapsed * 1000 > BUSY_DELAY_MS && !terminal_owned_by_job) show_busy(elapsed);
+  }
+
+  pthread_join(worker, NULL);
+  close(j.done_pipe[0]);
+  close(j.done_pipe[1]);
+  restore_job_terminal();
+  signal(SIGINT, SIG_DFL);
+
+  if (cancel_requested) {
+    journal_rollback(journal_mark);
+    while (n_operation_log > history_mark) arena_free(operation_log[--n_operation_log]);
+    memcpy(random_state, random_mark, sizeof(random_mark));
+
+    if (budget_exceeded) sprintf(error_buffer, "ERROR: The command exceeded its time budget of %gs", time_budget);
+    else sprintf(error_buffer, "Cancelled");
+    cancel_requested = 0;
+    return 0;
+  }
+
+  return j.result;
+}
+
+/* Set the time budget (in seconds) of every command, 0 means no budget */
+void set_time_budget(char *parameter) {
+  double seconds = 0;
+  if (!check_input_if_numeric(parameter, &seconds) || seconds < 0) {
+    sprintf(error_buffer, "ERROR: The time budget must be a number of seconds");
+    return;
+  }
+  time_budget = seconds;
+}
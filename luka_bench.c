@@ -0,0 +1,279 @@
+// SPDX-License-Identifier: GPL-2.0
+/* luka_bench.c
+ *
+ * A simple RPN calculator for terminal
+ * made with love in Italy.
+ *
+ * Copyright 2025 Davide Mastromatteo
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+/* ----------
+   BENCHMARKS
+   ---------- */
+
+/* "make bench" builds luka with this file as its entry point and
+   prints the figures quoted when the big integers, the words, the
+   matrices and the sort were added: the factorial of 100000, the
+   multiplication algorithms around their thresholds, nested words
+   against the same commands typed one by one, the 1000×1000 matrix
+   product, solve and determinant, and the radix sort and introselect
+   against qsort. The inputs come from a fixed generator, so every run
+   measures the same work. */
+
+#define main luka_main
+#include "luka.c"
+#undef main
+
+#define BENCH_SORT_LENGTH 10000000
+#define BENCH_MATRIX_SIZE 1000
+#define BENCH_TYPED_ADDITIONS 200000
+
+#ifdef BENCH_BLAS
+/* The Fortran entry point, every BLAS has it */
+void dgemm_(const char *transa, const char *transb, const int *m, const int *n, const int *k,
+            const double *alpha, const double *a, const int *lda, const double *b, const int *ldb,
+            const double *beta, double *c, const int *ldc);
+#endif
+
+unsigned long long bench_state = 88172645463325252ULL;
+
+/* A fixed sequence of pseudo random numbers (xorshift64) */
+unsigned long long bench_random(void) {
+  bench_state ^= bench_state << 13;
+  bench_state ^= bench_state >> 7;
+  bench_state ^= bench_state << 17;
+  return bench_state;
+}
+
+double bench_uniform(void) {
+  return (bench_random() >> 11) * 0x1.0p-53;
+}
+
+double bench_now(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+/* Run a command as if it was typed, stopping at any error */
+void bench_run(const char *command) {
+  char input[MAX_INPUT_BUFFER];
+  snprintf(input, sizeof(input), "%s", command);
+  error_buffer[0] = '\0';
+  compute(input);
+  if (error_buffer[0] != '\0') {
+    fprintf(stderr, "%s: %s\n", command, error_buffer);
+    exit(1);
+  }
+}
+
+/* Time a command, in seconds */
+double bench_time(const char *command) {
+  double start = bench_now();
+  bench_run(command);
+  return bench_now() - start;
+}
+
+/* Push an array of values */
+void bench_push_array(double *values, long length) {
+  struct buffer *b = buffer_new(length);
+  if (b == NULL) {
+    fprintf(stderr, "The array doesn't fit in memory\n");
+    exit(1);
+  }
+  memcpy(b->data, values, length * sizeof(double));
+  push(make_array(b));
+}
+
+int bench_compare(const void *a, const void *b) {
+  double x = *(const double *) a, y = *(const double *) b;
+  return (x > y) - (x < y);
+}
+
+/* Time a multiplication of two n limbs magnitudes, in microseconds:
+   the best of a few rounds, the sizes are too close to trust one */
+double bench_multiply(void (*multiply)(limb *, const limb *, int, const limb *, int), int n) {
+  limb *a = malloc(n * sizeof(limb)), *b = malloc(n * sizeof(limb)), *r = malloc(2 * n * sizeof(limb));
+  for (int i = 0; i < n; i++) {
+    a[i] = (limb) bench_random() | 1;
+    b[i] = (limb) bench_random() | 1;
+  }
+
+  double best = INFINITY;
+  for (int round = 0; round < 5; round++) {
+    int runs = 0;
+    double start = bench_now(), elapsed;
+    do {
+      multiply(r, a, n, b, n);
+      runs++;
+    } while ((elapsed = bench_now() - start) < 0.02);
+    if (elapsed / runs < best) best = elapsed / runs;
+  }
+
+  free(a);
+  free(b);
+  free(r);
+  return best * 1e6;
+}
+
+void bench_big_integers(void) {
+  printf("Big integers\n");
+  bench_run("big");
+  double t = bench_time("100000 !");
+  int converted;
+  struct bigint *b = get_bigint(pick(sp), &converted);
+  printf("  100000!            %8.3f s   (%d limbs)\n", t, b->length);
+  bench_run("clear");
+  bench_run("dbl");
+
+  // The top level step of each method, recursing through mag_mul, then mag_mul itself
+  printf("  multiply, us       schoolbook  karatsuba      toom3    mag_mul   (thresholds %d, %d)\n", KARATSUBA_THRESHOLD, TOOM3_THRESHOLD);
+  int sizes[] = { 16, 24, 32, 48, 64, 100, 200, 300, 400, 600, 800, 1000, 2000, 4000 };
+  for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+    int n = sizes[i];
+    printf("  %4d x %4d limbs  %10.2f %10.2f %10.2f %10.2f\n", n, n, bench_multiply(mag_mul_schoolbook, n),
+           bench_multiply(mag_mul_karatsuba, n), bench_multiply(mag_mul_toom3, n), bench_multiply(mag_mul, n));
+  }
+}
+
+void bench_words(void) {
+  printf("Words\n");
+  char definition[64];
+  bench_run(": w0 1 + ;");
+  for (int i = 1; i <= 20; i++) {
+    snprintf(definition, sizeof(definition), ": w%d w%d w%d ;", i, i - 1, i - 1);
+    bench_run(definition);
+  }
+  bench_run("0");
+  double t = bench_time("w20");
+  printf("  nested word        %8.1f ns per addition (2^20 additions)\n", t / (1 << 20) * 1e9);
+  bench_run("clear");
+
+  bench_run("0");
+  double start = bench_now();
+  for (int i = 0; i < BENCH_TYPED_ADDITIONS; i++) {
+    bench_run("1");
+    bench_run("+");
+  }
+  printf("  typed one by one   %8.1f ns per addition\n", (bench_now() - start) / BENCH_TYPED_ADDITIONS * 1e9);
+  bench_run("clear");
+}
+
+void bench_matrices(void) {
+  int n = BENCH_MATRIX_SIZE;
+  long length = (long) n * n;
+  char command[64];
+  double *a = malloc(length * sizeof(double)), *b = malloc(length * sizeof(double)), *c = calloc(length, sizeof(double));
+  for (long i = 0; i < length; i++) {
+    a[i] = bench_uniform();
+    b[i] = bench_uniform();
+  }
+
+  printf("Matrices %dx%d\n", n, n);
+  double start = bench_now();
+  for (int i = 0; i < n; i++)
+    for (int j = 0; j < n; j++) {
+      double sum = 0;
+      for (int k = 0; k < n; k++) sum += a[(long) i * n + k] * b[(long) k * n + j];
+      c[(long) i * n + j] = sum;
+    }
+  double flops = 2.0 * n * n * n * 1e-9;
+  double t = bench_now() - start;
+  printf("  naive triple loop  %8.3f s  %5.1f GFLOP/s\n", t, flops / t);
+
+#ifdef BENCH_BLAS
+  // Column major: B·A of the transposes is the row major A·B
+  double one = 1, zero = 0, difference = 0;
+  double *d = malloc(length * sizeof(double));
+  start = bench_now();
+  dgemm_("N", "N", &n, &n, &n, &one, b, &n, a, &n, &zero, d, &n);
+  t = bench_now() - start;
+  for (long i = 0; i < length; i++) difference = fmax(difference, fabs(d[i] - c[i]));
+  printf("  BLAS dgemm         %8.3f s  %5.1f GFLOP/s  (differs by %.1e)\n", t, flops / t, difference);
+  free(d);
+#endif
+
+  snprintf(command, sizeof(command), "%d %d matrix", n, n);
+  bench_push_array(b, length);
+  bench_run(command);
+  bench_push_array(a, length);
+  bench_run(command);
+  t = bench_time("*");
+  printf("  multiply           %8.3f s  %5.1f GFLOP/s\n", t, flops / t);
+  bench_run("clear");
+
+  bench_push_array(b, length);
+  bench_run(command);
+  bench_push_array(a, length);
+  bench_run(command);
+  printf("  LU solve, %d rhs %8.3f s\n", n, bench_time("/"));
+  bench_run("clear");
+
+  bench_push_array(a, length);
+  bench_run(command);
+  printf("  determinant        %8.3f s\n", bench_time("det"));
+  bench_run("clear");
+
+  free(a);
+  free(b);
+  free(c);
+}
+
+/* Time the sort and the median of an array against qsort */
+void bench_sort_array(char *name, double *values, long length) {
+  double *copy = malloc(length * sizeof(double));
+  memcpy(copy, values, length * sizeof(double));
+  double start = bench_now();
+  qsort(copy, length, sizeof(double), bench_compare);
+  double t = bench_now() - start;
+  free(copy);
+
+  bench_push_array(values, length);
+  double sort = bench_time("sort");
+  bench_run("clear");
+  bench_push_array(values, length);
+  double median = bench_time("median");
+  bench_run("clear");
+  printf("  %-20s qsort %6.3f s   radix sort %6.3f s   median %6.3f s\n", name, t, sort, median);
+}
+
+void bench_sort(void) {
+  long length = BENCH_SORT_LENGTH;
+  double *values = malloc(length * sizeof(double));
+
+  printf("Sort, %ld values\n", length);
+  for (long i = 0; i < length; i++) values[i] = bench_uniform();
+  bench_sort_array("uniform doubles", values, length);
+  for (long i = 0; i < length; i++) values[i] = bench_random() % 1000;
+  bench_sort_array("integers < 1000", values, length);
+  free(values);
+}
+
+int main(void) {
+  operation_log = arena_alloc(ARENA_HISTORY, INITIAL_HISTORY_LENGTH * sizeof(char*));
+  memories = arena_alloc(ARENA_MEMORIES, INITIAL_MEMORIES_LENGTH * sizeof(char*));
+  values = arena_alloc(ARENA_MEMORIES, INITIAL_MEMORIES_LENGTH * sizeof(double));
+  stack = arena_alloc(ARENA_STACK, INITIAL_STACK_LENGTH * sizeof(double));
+  journal = arena_alloc(ARENA_JOURNAL, journal_length * sizeof(struct journal_entry));
+
+  printf("luka %s benchmarks, %d workers\n", APP_VERSION, parallel_workers());
+  bench_big_integers();
+  bench_words();
+  bench_matrices();
+  bench_sort();
+  return 0;
+}
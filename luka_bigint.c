@@ -0,0 +1,803 @@
+// SPDX-License-Identifier: GPL-2.0
+/* luka_bigint.c
+ *
+ * A simple RPN calculator for terminal
+ * made with love in Italy.
+ *
+ * Copyright 2025 Davide Mastromatteo
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/* -----------------------
+   BIG INTEGER FUNCTIONS
+   ----------------------- */
+
+/* Big integers are kept as sign and magnitude, the magnitude being
+   an array of 32 bit limbs, least significant first.
+   Multiplication switches from schoolbook to Karatsuba and then to
+   Toom-3 as the operands grow (see the thresholds in luka.c), and the
+   factorial multiplies the numbers by binary splitting, so that the
+   big multiplications are done between operands of the same size. */
+
+typedef uint32_t limb;
+
+struct bigint {
+  int sign;
+  int length;
+  limb *limbs;
+};
+
+struct object_class bigint_class;
+
+/* Allocate a big integer with room for a given number of limbs */
+struct bigint *bigint_new(int capacity) {
+  struct bigint *b = arena_alloc(ARENA_OBJECTS, sizeof(struct bigint));
+  limb *limbs = arena_alloc(ARENA_OBJECTS, (capacity > 0 ? capacity : 1) * sizeof(limb));
+  b->sign = 1;
+  b->length = 0;
+  b->limbs = limbs;
+  return b;
+}
+
+/* Free a big integer */
+void bigint_free(struct bigint *b) {
+  if (b == NULL) return;
+  arena_free(b->limbs);
+  arena_free(b);
+}
+
+/* Drop the leading zero limbs of a magnitude */
+int mag_normalize(const limb *a, int n) {
+  while (n > 0 && a[n - 1] == 0) n--;
+  return n;
+}
+
+/* Fix the length of a big integer after an operation */
+void bigint_normalize(struct bigint *b) {
+  b->length = mag_normalize(b->limbs, b->length);
+  if (b->length == 0) b->sign = 1;
+}
+
+/* Compare two magnitudes */
+int mag_cmp(const limb *a, int an, const limb *b, int bn) {
+  if (an != bn) return an > bn ? 1 : -1;
+  for (int i = an - 1; i >= 0; i--) {
+    if (a[i] != b[i]) return a[i] > b[i] ? 1 : -1;
+  }
+  return 0;
+}
+
+/* r = a + b. r needs max(an, bn) + 1 limbs and may be a */
+int mag_add(limb *r, const limb *a, int an, const limb *b, int bn) {
+  if (an < bn) {
+    const limb *t = a; a = b; b = t;
+    int tn = an; an = bn; bn = tn;
+  }
+
+  uint64_t carry = 0;
+  for (int i = 0; i < bn; i++) {
+    carry += (uint64_t) a[i] + b[i];
+    r[i] = (limb) carry;
+    carry >>= 32;
+  }
+  for (int i = bn; i < an; i++) {
+    carry += a[i];
+    r[i] = (limb) carry;
+    carry >>= 32;
+  }
+  r[an] = (limb) carry;
+  return an + (carry != 0);
+}
+
+/* Add b into r, which has rn limbs, propagating the carry */
+void mag_add_into(limb *r, int rn, const limb *b, int bn) {
+  uint64_t carry = 0;
+  int i = 0;
+  for (; i < bn; i++) {
+    carry += (uint64_t) r[i] + b[i];
+    r[i] = (limb) carry;
+    carry >>= 32;
+  }
+  for (; carry != 0 && i < rn; i++) {
+    carry += r[i];
+    r[i] = (limb) carry;
+    carry >>= 32;
+  }
+}
+
+/* r = a - b, with a >= b. r needs an limbs and may be a */
+int mag_sub(limb *r, const limb *a, int an, const limb *b, int bn) {
+  uint64_t borrow = 0;
+  for (int i = 0; i < bn; i++) {
+    uint64_t d = (uint64_t) a[i] - b[i] - borrow;
+    r[i] = (limb) d;
+    borrow = d >> 63;
+  }
+  for (int i = bn; i < an; i++) {
+    uint64_t d = (uint64_t) a[i] - borrow;
+    r[i] = (limb) d;
+    borrow = d >> 63;
+  }
+  return mag_normalize(r, an);
+}
+
+/* Schoolbook multiplication: r = a * b, r needs an + bn limbs */
+void mag_mul_schoolbook(limb *r, const limb *a, int an, const limb *b, int bn) {
+  memset(r, 0, (an + bn) * sizeof(limb));
+  for (int i = 0; i < an; i++) {
+    uint64_t carry = 0;
+    uint64_t ai = a[i];
+    for (int j = 0; j < bn; j++) {
+      carry += ai * b[j] + r[i + j];
+      r[i + j] = (limb) carry;
+      carry >>= 32;
+    }
+    r[i + bn] = (limb) carry;
+  }
+}
+
+void mag_mul(limb *r, const limb *a, int an, const limb *b, int bn);
+void mag_mul_toom3(limb *r, const limb *a, int an, const limb *b, int bn);
+
+/* Karatsuba multiplication: r = a * b, with an >= bn > an / 2 */
+void mag_mul_karatsuba(limb *r, const limb *a, int an, const limb *b, int bn) {
+  int m = an / 2;
+  const limb *a0 = a, *a1 = a + m, *b0 = b, *b1 = b + m;
+  int a0n = mag_normalize(a0, m), b0n = mag_normalize(b0, m);
+
+  limb *sa = malloc((an - m + 2) * sizeof(limb));
+  limb *sb = malloc((an - m + 2) * sizeof(limb));
+  limb *z1 = malloc((2 * (an - m) + 4) * sizeof(limb));
+  if (sa == NULL || sb == NULL || z1 == NULL) {
+    printf("ERROR: You run out of memory. Exiting.");
+    exit(1);
+  }
+
+  // z0 and z2 go straight in their place
+  memset(r, 0, (an + bn) * sizeof(limb));
+  mag_mul(r, a0, a0n, b0, b0n);
+  mag_mul(r + 2 * m, a1, an - m, b1, bn - m);
+
+  int san = mag_add(sa, a0, a0n, a1, an - m);
+  int sbn = mag_add(sb, b0, b0n, b1, bn - m);
+  san = mag_normalize(sa, san);
+  sbn = mag_normalize(sb, sbn);
+
+  // z1 = (a0 + a1)(b0 + b1) - z0 - z2
+  mag_mul(z1, sa, san, sb, sbn);
+  int z1n = mag_normalize(z1, san + sbn);
+  z1n = mag_sub(z1, z1, z1n, r, mag_normalize(r, 2 * m));
+  z1n = mag_sub(z1, z1, z1n, r + 2 * m, mag_normalize(r + 2 * m, an + bn - 2 * m));
+  mag_add_into(r + m, an + bn - m, z1, z1n);
+
+  free(sa);
+  free(sb);
+  free(z1);
+}
+
+/* r = a * b, where r needs an + bn limbs and can't overlap a or b */
+void mag_mul(limb *r, const limb *a, int an, const limb *b, int bn) {
+  if (an < bn) {
+    const limb *t = a; a = b; b = t;
+    int tn = an; an = bn; bn = tn;
+  }
+
+  if (bn < KARATSUBA_THRESHOLD) {
+    mag_mul_schoolbook(r, a, an, b, bn);
+    return;
+  }
+
+  // Unbalanced operands: multiply b by slices of a as long as b
+  if (2 * bn <= an) {
+    limb *t = malloc(2 * bn * sizeof(limb));
+    if (t == NULL) {
+      printf("ERROR: You run out of memory. Exiting.");
+      exit(1);
+    }
+    memset(r, 0, (an + bn) * sizeof(limb));
+    for (int offset = 0; offset < an; offset += bn) {
+      int slice = an - offset < bn ? an - offset : bn;
+      mag_mul(t, a + offset, slice, b, bn);
+      mag_add_into(r + offset, an + bn - offset, t, slice + bn);
+    }
+    free(t);
+    return;
+  }
+
+  if (bn >= TOOM3_THRESHOLD && 3 * bn > 2 * an + 6) {
+    mag_mul_toom3(r, a, an, b, bn);
+    return;
+  }
+
+  mag_mul_karatsuba(r, a, an, b, bn);
+}
+
+/* Copy a magnitude in a new big integer */
+struct bigint *bigint_from_mag(const limb *a, int n, int sign) {
+  n = mag_normalize(a, n);
+  struct bigint *b = bigint_new(n + 1);
+  memcpy(b->limbs, a, n * sizeof(limb));
+  b->length = n;
+  b->sign = n == 0 ? 1 : sign;
+  return b;
+}
+
+/* Signed addition (or subtraction if negate is -1) */
+struct bigint *bigint_add_signed(struct bigint *a, struct bigint *b, int negate) {
+  int bsign = b->sign * negate;
+  int n = (a->length > b->length ? a->length : b->length) + 1;
+  struct bigint *r = bigint_new(n);
+
+  if (a->sign == bsign) {
+    r->length = mag_add(r->limbs, a->limbs, a->length, b->limbs, b->length);
+    r->sign = a->sign;
+  } else if (mag_cmp(a->limbs, a->length, b->limbs, b->length) >= 0) {
+    r->length = mag_sub(r->limbs, a->limbs, a->length, b->limbs, b->length);
+    r->sign = a->sign;
+  } else {
+    r->length = mag_sub(r->limbs, b->limbs, b->length, a->limbs, a->length);
+    r->sign = bsign;
+  }
+  bigint_normalize(r);
+  return r;
+}
+
+/* a + b */
+struct bigint *bigint_add(struct bigint *a, struct bigint *b) {
+  return bigint_add_signed(a, b, 1);
+}
+
+/* a - b */
+struct bigint *bigint_sub(struct bigint *a, struct bigint *b) {
+  return bigint_add_signed(a, b, -1);
+}
+
+/* a * b */
+struct bigint *bigint_mul(struct bigint *a, struct bigint *b) {
+  struct bigint *r = bigint_new(a->length + b->length);
+  r->length = a->length + b->length;
+  if (a->length > 0 && b->length > 0) mag_mul(r->limbs, a->limbs, a->length, b->limbs, b->length);
+  r->sign = a->sign * b->sign;
+  bigint_normalize(r);
+  return r;
+}
+
+/* a * m, with m a small number */
+struct bigint *bigint_mul_small(struct bigint *a, limb m) {
+  struct bigint *r = bigint_new(a->length + 1);
+  uint64_t carry = 0;
+  for (int i = 0; i < a->length; i++) {
+    carry += (uint64_t) a->limbs[i] * m;
+    r->limbs[i] = (limb) carry;
+    carry >>= 32;
+  }
+  r->limbs[a->length] = (limb) carry;
+  r->length = a->length + 1;
+  r->sign = a->sign;
+  bigint_normalize(r);
+  return r;
+}
+
+/* Divide a magnitude by a small number in place, returning the remainder */
+limb mag_div_small(limb *a, int n, limb d) {
+  uint64_t remainder = 0;
+  for (int i = n - 1; i >= 0; i--) {
+    uint64_t current = (remainder << 32) | a[i];
+    a[i] = (limb) (current / d);
+    remainder = current % d;
+  }
+  return (limb) remainder;
+}
+
+/* a / d, when d is known to divide a */
+struct bigint *bigint_divexact_small(struct bigint *a, limb d) {
+  struct bigint *r = bigint_from_mag(a->limbs, a->length, a->sign);
+  mag_div_small(r->limbs, r->length, d);
+  bigint_normalize(r);
+  return r;
+}
+
+/* Toom-3 multiplication: r = a * b, with an >= bn > 2/3 an.
+   The operands are split in three pieces, evaluated in 0, 1, -1, -2
+   and infinity, multiplied pointwise and interpolated back with
+   Bodrato's sequence */
+void mag_mul_toom3(limb *r, const limb *a, int an, const limb *b, int bn) {
+  int k = (an + 2) / 3;
+
+  struct bigint a0 = { 1, mag_normalize(a, k), (limb*) a };
+  struct bigint a1 = { 1, mag_normalize(a + k, k), (limb*) a + k };
+  struct bigint a2 = { 1, mag_normalize(a + 2 * k, an - 2 * k), (limb*) a + 2 * k };
+  struct bigint b0 = { 1, mag_normalize(b, k), (limb*) b };
+  struct bigint b1 = { 1, mag_normalize(b + k, k), (limb*) b + k };
+  struct bigint b2 = { 1, mag_normalize(b + 2 * k, bn - 2 * k), (limb*) b + 2 * k };
+
+  // Evaluation
+  struct bigint *t = bigint_add(&a0, &a2);
+  struct bigint *pa1 = bigint_add(t, &a1);
+  struct bigint *pam1 = bigint_sub(t, &a1);
+  bigint_free(t);
+  t = bigint_add(pam1, &a2);
+  struct bigint *t2 = bigint_mul_small(t, 2);
+  struct bigint *pam2 = bigint_sub(t2, &a0);
+  bigint_free(t);
+  bigint_free(t2);
+
+  t = bigint_add(&b0, &b2);
+  struct bigint *pb1 = bigint_add(t, &b1);
+  struct bigint *pbm1 = bigint_sub(t, &b1);
+  bigint_free(t);
+  t = bigint_add(pbm1, &b2);
+  t2 = bigint_mul_small(t, 2);
+  struct bigint *pbm2 = bigint_sub(t2, &b0);
+  bigint_free(t);
+  bigint_free(t2);
+
+  // Pointwise multiplication
+  struct bigint *r0 = bigint_mul(&a0, &b0);
+  struct bigint *r1 = bigint_mul(pa1, pb1);
+  struct bigint *rm1 = bigint_mul(pam1, pbm1);
+  struct bigint *rm2 = bigint_mul(pam2, pbm2);
+  struct bigint *r4 = bigint_mul(&a2, &b2);
+  bigint_free(pa1); bigint_free(pam1); bigint_free(pam2);
+  bigint_free(pb1); bigint_free(pbm1); bigint_free(pbm2);
+
+  // Interpolation
+  t = bigint_sub(rm2, r1);
+  struct bigint *r3 = bigint_divexact_small(t, 3);
+  bigint_free(t);
+
+  t = bigint_sub(r1, rm1);
+  struct bigint *c1 = bigint_divexact_small(t, 2);
+  bigint_free(t);
+
+  struct bigint *c2 = bigint_sub(rm1, r0);
+
+  t = bigint_sub(c2, r3);
+  t2 = bigint_divexact_small(t, 2);
+  bigint_free(t);
+  t = bigint_mul_small(r4, 2);
+  bigint_free(r3);
+  r3 = bigint_add(t2, t);
+  bigint_free(t);
+  bigint_free(t2);
+
+  t = bigint_add(c2, c1);
+  bigint_free(c2);
+  c2 = bigint_sub(t, r4);
+  bigint_free(t);
+
+  t = bigint_sub(c1, r3);
+  bigint_free(c1);
+  c1 = t;
+
+  // Recomposition: all the coefficients are non negative
+  memset(r, 0, (an + bn) * sizeof(limb));
+  struct bigint *coefficients[] = { r0, c1, c2, r3, r4 };
+  for (int i = 0; i < 5; i++) {
+    mag_add_into(r + i * k, an + bn - i * k, coefficients[i]->limbs, coefficients[i]->length);
+    bigint_free(coefficients[i]);
+  }
+  bigint_free(r1);
+  bigint_free(rm1);
+  bigint_free(rm2);
+}
+
+/* Knuth's algorithm D: q = u / v and rem = u % v, with m >= n >= 2.
+   q needs m - n + 1 limbs, rem needs n limbs */
+void mag_divmod(limb *q, limb *rem, const limb *u, int m, const limb *v, int n) {
+  int s = __builtin_clz(v[n - 1]);
+  limb *vn = malloc(n * sizeof(limb));
+  limb *un = malloc((m + 1) * sizeof(limb));
+  if (vn == NULL || un == NULL) {
+    printf("ERROR: You run out of memory. Exiting.");
+    exit(1);
+  }
+
+  // Normalize so that the top limb of the divisor has its high bit set
+  for (int i = n - 1; i > 0; i--) vn[i] = (v[i] << s) | (limb) ((uint64_t) v[i - 1] >> (32 - s));
+  vn[0] = v[0] << s;
+  un[m] = (limb) ((uint64_t) u[m - 1] >> (32 - s));
+  for (int i = m - 1; i > 0; i--) un[i] = (u[i] << s) | (limb) ((uint64_t) u[i - 1] >> (32 - s));
+  un[0] = u[0] << s;
+
+  for (int j = m - n; j >= 0; j--) {
+    uint64_t numerator = ((uint64_t) un[j + n] << 32) | un[j + n - 1];
+    uint64_t qhat = numerator / vn[n - 1];
+    uint64_t rhat = numerator % vn[n - 1];
+
+    while (qhat > 0xFFFFFFFFULL || qhat * vn[n - 2] > ((rhat << 32) | un[j + n - 2])) {
+      qhat--;
+      rhat += vn[n - 1];
+      if (rhat > 0xFFFFFFFFULL) break;
+    }
+
+    // Multiply and subtract
+    int64_t borrow = 0, t;
+    for (int i = 0; i < n; i++) {
+      uint64_t p = qhat * vn[i];
+      t = (int64_t) un[i + j] - borrow - (int64_t) (p & 0xFFFFFFFFULL);
+      un[i + j] = (limb) t;
+      borrow = (int64_t) (p >> 32) - (t >> 32);
+    }
+    t = (int64_t) un[j + n] - borrow;
+    un[j + n] = (limb) t;
+
+    // We subtracted too much: add back
+    q[j] = (limb) qhat;
+    if (t < 0) {
+      q[j]--;
+      uint64_t carry = 0;
+      for (int i = 0; i < n; i++) {
+        carry += (uint64_t) un[i + j] + vn[i];
+        un[i + j] = (limb) carry;
+        carry >>= 32;
+      }
+      un[j + n] += (limb) carry;
+    }
+  }
+
+  for (int i = 0; i < n - 1; i++) rem[i] = (un[i] >> s) | (limb) ((uint64_t) un[i + 1] << (32 - s));
+  rem[n - 1] = un[n - 1] >> s;
+
+  free(vn);
+  free(un);
+}
+
+/* Truncated division: *quotient = a / b and *remainder = a % b */
+void bigint_divmod(struct bigint *a, struct bigint *b, struct bigint **quotient, struct bigint **remainder) {
+  struct bigint *q, *r;
+
+  if (mag_cmp(a->limbs, a->length, b->limbs, b->length) < 0) {
+    q = bigint_new(1);
+    r = bigint_from_mag(a->limbs, a->length, 1);
+  } else if (b->length == 1) {
+    q = bigint_from_mag(a->limbs, a->length, 1);
+    limb remainder_limb = mag_div_small(q->limbs, q->length, b->limbs[0]);
+    r = bigint_from_mag(&remainder_limb, 1, 1);
+  } else {
+    q = bigint_new(a->length - b->length + 1);
+    r = bigint_new(b->length);
+    mag_divmod(q->limbs, r->limbs, a->limbs, a->length, b->limbs, b->length);
+    q->length = a->length - b->length + 1;
+    r->length = b->length;
+  }
+
+  q->sign = a->sign * b->sign;
+  r->sign = a->sign;
+  bigint_normalize(q);
+  bigint_normalize(r);
+
+  if (quotient != NULL) *quotient = q; else bigint_free(q);
+  if (remainder != NULL) *remainder = r; else bigint_free(r);
+}
+
+/* Convert an integral double to a big integer */
+struct bigint *bigint_from_double(double value) {
+  struct bigint *b = bigint_new(34);
+  double magnitude = fabs(value);
+  int e;
+
+  // magnitude = mantissa * 2^e, with an integer mantissa of 53 bits
+  double mantissa = frexp(magnitude, &e);
+  uint64_t integer_mantissa = (uint64_t) ldexp(mantissa, 53);
+  e -= 53;
+
+  limb m[2] = { (limb) integer_mantissa, (limb) (integer_mantissa >> 32) };
+  if (e <= 0) {
+    uint64_t shifted = integer_mantissa >> -e;
+    m[0] = (limb) shifted;
+    m[1] = (limb) (shifted >> 32);
+    e = 0;
+  }
+
+  int limb_shift = e / 32, bit_shift = e % 32;
+  memset(b->limbs, 0, 34 * sizeof(limb));
+  uint64_t low = (uint64_t) m[0] << bit_shift;
+  uint64_t high = (uint64_t) m[1] << bit_shift;
+  b->limbs[limb_shift] = (limb) low;
+  b->limbs[limb_shift + 1] = (limb) ((low >> 32) | high);
+  b->limbs[limb_shift + 2] = (limb) (high >> 32);
+  b->length = limb_shift + 3;
+  b->sign = value < 0 ? -1 : 1;
+  bigint_normalize(b);
+  return b;
+}
+
+/* Convert a big integer to the nearest double */
+double bigint_to_double(struct bigint *b) {
+  long double r = 0;
+  int top = b->length - 3 > 0 ? b->length - 3 : 0;
+  for (int i = b->length - 1; i >= top; i--) r = r * 4294967296.0L + b->limbs[i];
+  return b->sign * (double) ldexpl(r, 32 * top);
+}
+
+/* Parse a string of decimal digits, with an optional sign */
+struct bigint *bigint_from_string(char *input) {
+  int sign = 1;
+  if (*input == '-' || *input == '+') {
+    if (*input == '-') sign = -1;
+    input++;
+  }
+
+  int digits = strlen(input);
+  struct bigint *b = bigint_new(digits / 9 + 2);
+  memset(b->limbs, 0, (digits / 9 + 2) * sizeof(limb));
+
+  // Eat the digits nine at a time: b = b * 10^9 + chunk
+  int first = digits % 9 == 0 ? 9 : digits % 9;
+  for (int i = 0; i < digits; ) {
+    int chunk_digits = i == 0 ? first : 9;
+    limb chunk = 0, scale = 1;
+    for (int k = 0; k < chunk_digits; k++, i++) {
+      chunk = chunk * 10 + (input[i] - '0');
+      scale *= 10;
+    }
+
+    uint64_t carry = chunk;
+    for (int k = 0; k < b->length; k++) {
+      carry += (uint64_t) b->limbs[k] * scale;
+      b->limbs[k] = (limb) carry;
+      carry >>= 32;
+    }
+    if (carry) b->limbs[b->length++] = (limb) carry;
+  }
+
+  b->sign = sign;
+  bigint_normalize(b);
+  return b;
+}
+
+/* Tell if a string is an integer literal */
+int is_integer_literal(char *input) {
+  if (*input == '-' || *input == '+') input++;
+  if (*input == '\0') return 0;
+  for (; *input; input++) {
+    if (!isdigit((unsigned char) *input)) return 0;
+  }
+  return 1;
+}
+
+/* Write the exact decimal digits of a big integer */
+void bigint_to_string(struct bigint *b, char *buffer) {
+  if (b->length == 0) {
+    strcpy(buffer, "0");
+    return;
+  }
+
+  struct bigint *t = bigint_from_mag(b->limbs, b->length, 1);
+  int chunks_length = b->length * 10 / 9 + 2;
+  limb *chunks = malloc(chunks_length * sizeof(limb));
+  if (chunks == NULL) {
+    printf("ERROR: You run out of memory. Exiting.");
+    exit(1);
+  }
+  int n = 0;
+  while (t->length > 0) {
+    chunks[n++] = mag_div_small(t->limbs, t->length, 1000000000);
+    t->length = mag_normalize(t->limbs, t->length);
+  }
+
+  char *p = buffer;
+  if (b->sign < 0) *p++ = '-';
+  p += sprintf(p, "%u", n > 0 ? chunks[n - 1] : 0);
+  for (int i = n - 2; i >= 0; i--) p += sprintf(p, "%09u", chunks[i]);
+
+  free(chunks);
+  bigint_free(t);
+}
+
+/* Compute base^exponent by repeated squaring */
+struct bigint *bigint_pow(struct bigint *base, unsigned long long exponent) {
+  struct bigint *result = bigint_new(1);
+  result->limbs[0] = 1;
+  result->length = 1;
+  struct bigint *square = bigint_from_mag(base->limbs, base->length, base->sign);
+
+  while (exponent > 0 && !job_cancelled()) {
+    if (exponent & 1) {
+      struct bigint *t = bigint_mul(result, square);
+      bigint_free(result);
+      result = t;
+    }
+    exponent >>= 1;
+    if (exponent > 0) {
+      struct bigint *t = bigint_mul(square, square);
+      bigint_free(square);
+      square = t;
+    }
+  }
+  bigint_free(square);
+  return result;
+}
+
+/* Multiply together all the numbers from low to high by binary splitting.
+   A cancelled job gets 1 at once, its result is thrown away anyway */
+struct bigint *bigint_product_range(unsigned long long low, unsigned long long high) {
+  struct bigint *r;
+  if (job_cancelled()) return bigint_from_double(1);
+
+  if (high - low < 16) {
+    r = bigint_from_double(1);
+    for (unsigned long long i = low; i <= high; i++) {
+      struct bigint *t;
+      if (i <= 0xFFFFFFFFULL) t = bigint_mul_small(r, (limb) i);
+      else {
+        struct bigint *factor = bigint_from_double((double) i);
+        t = bigint_mul(r, factor);
+        bigint_free(factor);
+      }
+      bigint_free(r);
+      r = t;
+    }
+    return r;
+  }
+
+  unsigned long long middle = low + (high - low) / 2;
+  struct bigint *left = bigint_product_range(low, middle);
+  struct bigint *right = bigint_product_range(middle + 1, high);
+  r = bigint_mul(left, right);
+  bigint_free(left);
+  bigint_free(right);
+  return r;
+}
+
+/* Compute n! */
+struct bigint *bigint_factorial(unsigned long long n) {
+  if (n < 2) return bigint_product_range(1, 1);
+  return bigint_product_range(2, n);
+}
+
+/* Wrap a big integer in a stack value */
+double make_bigint(struct bigint *b) {
+  return make_object(&bigint_class, b);
+}
+
+/* Get a big integer from a stack value: big integers are returned as
+   they are, integral doubles are converted (and must be freed)
+   and anything else gives NULL */
+struct bigint *get_bigint(double value, int *converted) {
+  *converted = 0;
+  struct bigint *b = get_object_data(value, &bigint_class);
+  if (b != NULL) return b;
+  if (is_object(value) || !isfinite(value) || value != floor(value)) return NULL;
+  *converted = 1;
+  return bigint_from_double(value);
+}
+
+/* Format a big integer: exact if it fits, scientific otherwise */
+void bigint_format(struct object *o, char *buffer, int size) {
+  struct bigint *b = o->data;
+
+  // 32 bits are a bit less than 9.64 decimal digits
+  if (b->length * 9.64 < size + 9.64) {
+    char exact[(b->length + 1) * 10 + 2];
+    bigint_to_string(b, exact);
+    if ((int) strlen(exact) < size) {
+      strcpy(buffer, exact);
+      return;
+    }
+  }
+
+  long double top = 0;
+  int skipped = b->length > 3 ? b->length - 3 : 0;
+  for (int i = b->length - 1; i >= skipped; i--) top = top * 4294967296.0L + b->limbs[i];
+  long double log10_value = log10l(top) + 32.0L * skipped * log10l(2.0L);
+  long double exponent = floorl(log10_value);
+  long double mantissa = powl(10.0L, log10_value - exponent);
+  if (mantissa >= 9.9999999995L) {
+    mantissa = 1;
+    exponent++;
+  }
+  snprintf(buffer, size, "%s%.9Lfe+%.0Lf", b->sign < 0 ? "-" : "", mantissa, exponent);
+}
+
+/* Convert a big integer object to a double */
+double bigint_object_to_double(struct object *o) {
+  return bigint_to_double(o->data);
+}
+
+/* Base 2 logarithm of the magnitude of a big integer, 0 for 0 */
+double bigint_log2(struct bigint *b) {
+  if (b->length == 0) return 0;
+  double top = b->limbs[b->length - 1];
+  if (b->length > 1) top += b->limbs[b->length - 2] / 4294967296.0;
+  return log2(top) + 32.0 * (b->length - 1);
+}
+
+/* Tell if a result of that many bits is too big to be computed */
+int bigint_too_big(double bits) {
+  if (bits <= 32.0 * MAX_BIGINT_LIMBS) return 0;
+  sprintf(error_buffer, "ERROR: The result would have more than %d digits", (int) (MAX_BIGINT_LIMBS * 32 * M_LN2 / M_LN10));
+  return 1;
+}
+
+/* Single operand operations on big integers: only the factorial
+   stays exact, anything else is done on the double value */
+int bigint_operation_1o(operation_1o f, double x, double *result) {
+  if (f != factorial) return 0;
+
+  int converted;
+  struct bigint *b = get_bigint(x, &converted);
+  if (b == NULL) return 0;
+  if (b->sign < 0 || b->length > 2) {
+    if (converted) bigint_free(b);
+    return 0;
+  }
+
+  unsigned long long n = b->length == 0 ? 0 : b->limbs[0];
+  if (b->length == 2) n |= (unsigned long long) b->limbs[1] << 32;
+  if (converted) bigint_free(b);
+
+  // log2(n!) from the log gamma function
+  if (bigint_too_big(lgamma((double) n + 1) / M_LN2)) return -1;
+  *result = make_bigint(bigint_factorial(n));
+  return 1;
+}
+
+/* Two operands operations on big integers */
+int bigint_operation_2o(operation_2o f, double x, double y, double *result) {
+  int x_converted, y_converted;
+  struct bigint *bx = get_bigint(x, &x_converted);
+  struct bigint *by = get_bigint(y, &y_converted);
+  struct bigint *r = NULL;
+  int handled = 1;
+
+  // A non integral operand turns the operation into a double one
+  if (bx == NULL || by == NULL) handled = 0;
+  else if (f == sum) r = bigint_add(by, bx);
+  else if (f == subtraction) r = bigint_sub(by, bx);
+  else if (f == multiplication) r = bigint_mul(by, bx);
+  else if (f == division || f == modulo) {
+    if (bx->length == 0) {
+      sprintf(error_buffer, "ERROR: Division by zero");
+      handled = -1;
+    } else if (f == division) bigint_divmod(by, bx, &r, NULL);
+    else bigint_divmod(by, bx, NULL, &r);
+  }
+  else if (f == to_power && bx->sign > 0 && bx->length <= 2) {
+    unsigned long long exponent = bx->length == 0 ? 0 : bx->limbs[0];
+    if (bx->length == 2) exponent |= (unsigned long long) bx->limbs[1] << 32;
+    if (bigint_too_big(bigint_log2(by) * (double) exponent)) handled = -1;
+    else r = bigint_pow(by, exponent);
+  }
+  else handled = 0;
+
+  if (x_converted) bigint_free(bx);
+  if (y_converted) bigint_free(by);
+  if (r != NULL) *result = make_bigint(r);
+  return handled;
+}
+
+/* Free a big integer object */
+void bigint_release(struct object *o) {
+  bigint_free(o->data);
+}
+
+struct object_class bigint_class = {
+  "bigint", 1, 1,
+  bigint_format, bigint_object_to_double,
+  bigint_operation_1o, bigint_operation_2o,
+  NULL, bigint_release
+};
+
+/* Set the big integer arithmetic mode */
+void set_big_arithmetic_mode(void) {
+  arithmetic_mode = 'b';
+}
+
+/* Set the double arithmetic mode */
+void set_double_arithmetic_mode(void) {
+  arithmetic_mode = 'd';
+}
@@ -0,0 +1,435 @@
+// SPDX-License-Identifier: GPL-2.0
+/* luka_dd.c
+ *
+ * A simple RPN calculator for terminal
+ * made with love in Italy.
+ *
+ * Copyright 2025 Davide Mastromatteo
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/* -------------------------
+   DOUBLE-DOUBLE FUNCTIONS
+   ------------------------- */
+
+/* A double-double is the unevaluated sum of two doubles hi + lo,
+   with |lo| <= ulp(hi) / 2: about 106 bits of mantissa, or 32 decimal
+   digits. Everything is built on the error free transformations
+   two_sum and two_prod, which give the exact rounding error of a sum
+   and of a product, the latter with Dekker's splitting. */
+
+struct dd {
+  double hi;
+  double lo;
+};
+
+struct object_class dd_class;
+int decimal_to_dd(double, struct dd*);
+
+/* s + e = a + b exactly */
+static inline struct dd two_sum(double a, double b) {
+  double s = a + b;
+  double bb = s - a;
+  struct dd r = { s, (a - (s - bb)) + (b - bb) };
+  return r;
+}
+
+/* s + e = a + b exactly, when |a| >= |b| */
+static inline struct dd quick_two_sum(double a, double b) {
+  double s = a + b;
+  struct dd r = { s, b - (s - a) };
+  return r;
+}
+
+/* p + e = a * b exactly */
+static inline struct dd two_prod(double a, double b) {
+  double p = a * b;
+  const double split = 134217729.0; // 2^27 + 1
+  double t = split * a, a_hi = t - (t - a), a_lo = a - a_hi;
+  t = split * b;
+  double b_hi = t - (t - b), b_lo = b - b_hi;
+  struct dd r = { p, ((a_hi * b_hi - p) + a_hi * b_lo + a_lo * b_hi) + a_lo * b_lo };
+  return r;
+}
+
+/* Build a double-double from a double */
+static inline struct dd dd_from(double a) {
+  struct dd r = { a, 0 };
+  return r;
+}
+
+/* a + b */
+static inline struct dd dd_add(struct dd a, struct dd b) {
+  struct dd s = two_sum(a.hi, b.hi);
+  struct dd t = two_sum(a.lo, b.lo);
+  s.lo += t.hi;
+  s = quick_two_sum(s.hi, s.lo);
+  s.lo += t.lo;
+  return quick_two_sum(s.hi, s.lo);
+}
+
+/* -a */
+static inline struct dd dd_neg(struct dd a) {
+  struct dd r = { -a.hi, -a.lo };
+  return r;
+}
+
+/* a - b */
+static inline struct dd dd_sub(struct dd a, struct dd b) {
+  return dd_add(a, dd_neg(b));
+}
+
+/* a + b, with b a double */
+static inline struct dd dd_add_d(struct dd a, double b) {
+  struct dd s = two_sum(a.hi, b);
+  s.lo += a.lo;
+  return quick_two_sum(s.hi, s.lo);
+}
+
+/* a * b */
+static inline struct dd dd_mul(struct dd a, struct dd b) {
+  struct dd p = two_prod(a.hi, b.hi);
+  p.lo += a.hi * b.lo + a.lo * b.hi;
+  return quick_two_sum(p.hi, p.lo);
+}
+
+/* a * b, with b a double */
+static inline struct dd dd_mul_d(struct dd a, double b) {
+  struct dd p = two_prod(a.hi, b);
+  p.lo += a.lo * b;
+  return quick_two_sum(p.hi, p.lo);
+}
+
+/* a / b, refining the quotient twice */
+static inline struct dd dd_div(struct dd a, struct dd b) {
+  double q1 = a.hi / b.hi;
+  struct dd r = dd_sub(a, dd_mul_d(b, q1));
+  double q2 = r.hi / b.hi;
+  r = dd_sub(r, dd_mul_d(b, q2));
+  double q3 = r.hi / b.hi;
+  return dd_add_d(quick_two_sum(q1, q2), q3);
+}
+
+/* Round toward zero */
+struct dd dd_trunc(struct dd a) {
+  double hi = trunc(a.hi);
+
+  // |lo| is below half an ulp of hi: it matters only if hi is integral
+  if (hi != a.hi) return dd_from(hi);
+  return quick_two_sum(hi, a.hi > 0 ? floor(a.lo) : ceil(a.lo));
+}
+
+/* a^n, with n an integer, by repeated squaring */
+struct dd dd_npow(struct dd a, long long n) {
+  struct dd r = dd_from(1), square = a;
+  unsigned long long m = n < 0 ? -(unsigned long long) n : (unsigned long long) n;
+  while (m > 0) {
+    if (m & 1) r = dd_mul(r, square);
+    m >>= 1;
+    if (m > 0) square = dd_mul(square, square);
+  }
+  return n < 0 ? dd_div(dd_from(1), r) : r;
+}
+
+/* Square root: one Newton step on the double square root */
+struct dd dd_sqrt(struct dd a) {
+  if (a.hi <= 0) return dd_from(sqrt(a.hi));
+  double x = sqrt(a.hi);
+  struct dd residual = dd_sub(a, two_prod(x, x));
+  return quick_two_sum(x, residual.hi * (0.5 / x));
+}
+
+/* Exponential: reduce the argument to |r| <= ln(2) / 2 and
+   scale it down by 2^10, sum the Taylor series and square back */
+struct dd dd_exp(struct dd a) {
+  const struct dd ln2 = { 6.931471805599452862e-01, 2.319046813846299558e-17 };
+
+  if (a.hi > 709.8) return dd_from(INFINITY);
+  if (a.hi < -745.2) return dd_from(0);
+
+  double k = floor(a.hi / ln2.hi + 0.5);
+  struct dd r = dd_sub(a, dd_mul_d(ln2, k));
+  r.hi = ldexp(r.hi, -10);
+  r.lo = ldexp(r.lo, -10);
+
+  // e^r - 1 = r + r^2/2! + r^3/3! + ...
+  struct dd term = r, sum = r;
+  for (int i = 2; i < 20; i++) {
+    term = dd_mul(term, r);
+    term = dd_div(term, dd_from(i));
+    sum = dd_add(sum, term);
+    if (fabs(term.hi) < 1e-33 * fabs(sum.hi)) break;
+  }
+
+  // (e^r - 1) is squared as s = 2s + s^2, to keep the small digits
+  for (int i = 0; i < 10; i++) sum = dd_add(dd_mul_d(sum, 2), dd_mul(sum, sum));
+
+  sum = dd_add_d(sum, 1);
+  sum.hi = ldexp(sum.hi, (int) k);
+  sum.lo = ldexp(sum.lo, (int) k);
+  return sum;
+}
+
+/* Natural logarithm: one Newton step x = x + a e^-x - 1
+   on the double logarithm */
+struct dd dd_log(struct dd a) {
+  if (a.hi <= 0) return dd_from(log(a.hi));
+  struct dd x = dd_from(log(a.hi));
+  return dd_add_d(dd_add(x, dd_mul(a, dd_exp(dd_neg(x)))), -1);
+}
+
+/* Parse a decimal number straight into a double-double,
+   so that 0.1 is 0.1 to 32 digits and not the double 0.1 */
+int dd_parse(char *input, struct dd *result) {
+  struct dd m = dd_from(0);
+  int sign = 1, exponent = 0, significant = 0, seen_point = 0, seen_digit = 0;
+  char *p = input;
+
+  if (*p == '-' || *p == '+') {
+    if (*p == '-') sign = -1;
+    p++;
+  }
+
+  for (; *p; p++) {
+    if (*p == '.' && !seen_point) {
+      seen_point = 1;
+      continue;
+    }
+    if (!isdigit((unsigned char) *p)) break;
+    seen_digit = 1;
+
+    // digits beyond what a double-double can hold only move the point
+    if (significant < 32) {
+      if (significant > 0 || *p != '0') significant++;
+      m = dd_add_d(dd_mul_d(m, 10), *p - '0');
+      if (seen_point) exponent--;
+    } else if (!seen_point) exponent++;
+  }
+
+  if (!seen_digit) return 0;
+  if (*p == 'e' || *p == 'E') {
+    char *end;
+    exponent += (int) strtol(p + 1, &end, 10);
+    p = end;
+  }
+  if (*p != '\0') return 0;
+
+  if (exponent > 0) m = dd_mul(m, dd_npow(dd_from(10), exponent));
+  if (exponent < 0) m = dd_div(m, dd_npow(dd_from(10), -exponent));
+  m.hi *= sign;
+  m.lo *= sign;
+  *result = m;
+  return 1;
+}
+
+/* Get n decimal digits of |a| (rounded) and its decimal exponent */
+void dd_to_digits(struct dd a, int n, char *digits, int *exponent) {
+  int d[40] = {0};
+  if (a.hi < 0) a = dd_neg(a);
+  if (a.hi == 0) {
+    memset(digits, '0', n);
+    digits[n] = '\0';
+    *exponent = 0;
+    return;
+  }
+
+  int e = (int) floor(log10(a.hi));
+  struct dd r = e >= 0 ? dd_div(a, dd_npow(dd_from(10), e)) : dd_mul(a, dd_npow(dd_from(10), -e));
+  if (r.hi >= 10) { r = dd_div(r, dd_from(10)); e++; }
+  if (r.hi < 1) { r = dd_mul_d(r, 10); e--; }
+
+  // one digit more than needed, for the rounding
+  for (int i = 0; i <= n; i++) {
+    d[i] = (int) r.hi;
+    r = dd_mul_d(dd_add_d(r, -d[i]), 10);
+  }
+
+  // the digits may be slightly out of range: fix them
+  for (int i = n; i > 0; i--) {
+    if (d[i] < 0) { d[i] += 10; d[i - 1]--; }
+    if (d[i] > 9) { d[i] -= 10; d[i - 1]++; }
+  }
+
+  if (d[n] >= 5) {
+    d[n - 1]++;
+    for (int i = n - 1; i > 0 && d[i] > 9; i--) {
+      d[i] -= 10;
+      d[i - 1]++;
+    }
+  }
+
+  if (d[0] > 9) {
+    d[0] = 1;
+    for (int i = 1; i < n; i++) d[i] = 0;
+    e++;
+  }
+
+  for (int i = 0; i < n; i++) digits[i] = '0' + d[i];
+  digits[n] = '\0';
+  *exponent = e;
+}
+
+/* Format a double-double in a given width, showing as many digits
+   as fit: positional like the doubles if the magnitude allows it,
+   scientific otherwise */
+void dd_to_string(struct dd a, char *buffer, int size, char format) {
+  char digits[40];
+  int e, width = size - 1, negative = a.hi < 0;
+  double magnitude = fabs(a.hi);
+  char *p = buffer;
+
+  if (!isfinite(a.hi)) {
+    snprintf(buffer, size, "%lg", a.hi);
+    return;
+  }
+
+  if (negative) *p++ = '-';
+  width -= negative;
+
+  if (magnitude >= 1e10 || (magnitude > 0 && magnitude < 1e-6)) {
+    // d.ddddde+NNN
+    int n = width - 6;
+    if (n > 32) n = 32;
+    dd_to_digits(a, n, digits, &e);
+    sprintf(p, "%c.%se%+03d", digits[0], digits + 1, e);
+    return;
+  }
+
+  // leading digits before the point, the rest after
+  int e0 = magnitude > 0 ? (int) floor(log10(magnitude)) : 0;
+  int decimals = e0 >= 0 ? width - 2 - e0 : width - 2;
+  if (format == 'f' && decimals > 6) decimals = 6;
+  int n = e0 + 1 + decimals;
+  if (n > 32) n = 32;
+
+  if (n < 1) {
+    sprintf(p, "0.%0*d", decimals, 0);
+  } else {
+    dd_to_digits(a, n, digits, &e);
+    if (magnitude == 0) e = e0;
+
+    if (e > e0) {
+      // rounded up to the next power of ten: 9.99 became 10.0
+      digits[n++] = '0';
+      digits[n] = '\0';
+    }
+
+    if (e >= 0) {
+      memcpy(p, digits, e + 1);
+      p += e + 1;
+      *p++ = '.';
+      strcpy(p, digits + e + 1);
+    } else {
+      // 0.000ddd
+      *p++ = '0';
+      *p++ = '.';
+      memset(p, '0', -e - 1);
+      strcpy(p + (-e - 1), digits);
+    }
+  }
+
+  // drop the trailing zeros, like %g does
+  if (format != 'f') {
+    char *end = buffer + strlen(buffer) - 1;
+    while (*end == '0') *end-- = '\0';
+    if (*end == '.') *end = '\0';
+  }
+}
+
+/* Wrap a double-double in a stack value */
+double make_dd(struct dd a) {
+  double value = make_object(&dd_class, NULL);
+  struct object *o = get_object(value);
+  o->pair[0] = a.hi;
+  o->pair[1] = a.lo;
+  return value;
+}
+
+/* Wrap the pair hi + lo in a stack value */
+double make_dd_pair(double hi, double lo) {
+  struct dd a = { hi, lo };
+  return make_dd(a);
+}
+
+/* Get the double-double value of anything on the stack */
+struct dd get_dd(double value) {
+  struct object *o = get_object(value);
+  if (o != NULL && o->class == &dd_class) {
+    struct dd r = { o->pair[0], o->pair[1] };
+    return r;
+  }
+  struct dd r;
+  if (decimal_to_dd(value, &r)) return r;
+  return dd_from(to_number(value));
+}
+
+/* Format a double-double object */
+void dd_format(struct object *o, char *buffer, int size) {
+  struct dd a = { o->pair[0], o->pair[1] };
+  dd_to_string(a, buffer, size, numeric_format);
+}
+
+/* Convert a double-double object to a double */
+double dd_to_double(struct object *o) {
+  return o->pair[0] + o->pair[1];
+}
+
+/* Single operand operations on double-doubles */
+int dd_operation_1o(operation_1o f, double x, double *result) {
+  struct dd a = get_dd(x);
+
+  if (f == sqrt) *result = make_dd(dd_sqrt(a));
+  else if (f == exp) *result = make_dd(dd_exp(a));
+  else if (f == log) *result = make_dd(dd_log(a));
+  else if (f == log10) {
+    const struct dd ln10 = { 2.302585092994045901e+00, -2.170756223382249351e-16 };
+    *result = make_dd(dd_div(dd_log(a), ln10));
+  }
+  else if (f == reciprocal) *result = make_dd(dd_div(dd_from(1), a));
+  else return 0;
+  return 1;
+}
+
+/* Two operands operations on double-doubles */
+int dd_operation_2o(operation_2o f, double x, double y, double *result) {
+  struct dd a = get_dd(y), b = get_dd(x);
+
+  if (f == sum) *result = make_dd(dd_add(a, b));
+  else if (f == subtraction) *result = make_dd(dd_sub(a, b));
+  else if (f == multiplication) *result = make_dd(dd_mul(a, b));
+  else if (f == division) *result = make_dd(dd_div(a, b));
+  else if (f == modulo) {
+    struct dd q = dd_trunc(dd_div(a, b));
+    *result = make_dd(dd_sub(a, dd_mul(b, q)));
+  }
+  else if (f == to_power) {
+    if (b.lo == 0 && b.hi == floor(b.hi) && fabs(b.hi) < 1e9) *result = make_dd(dd_npow(a, (long long) b.hi));
+    else *result = make_dd(dd_exp(dd_mul(b, dd_log(a))));
+  }
+  else return 0;
+  return 1;
+}
+
+struct object_class dd_class = {
+  "dd", 3, 1,
+  dd_format, dd_to_double,
+  dd_operation_1o, dd_operation_2o,
+  NULL, NULL
+};
+
+/* Set the double-double arithmetic mode */
+void set_dd_arithmetic_mode(void) {
+  arithmetic_mode = 'q';
+}
@@ -0,0 +1,277 @@
+// SPDX-License-Identifier: GPL-2.0
+/* luka_decimal.c
+ *
+ * A simple RPN calculator for terminal
+ * made with love in Italy.
+ *
+ * Copyright 2025 Davide Mastromatteo
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+/* -----------------
+   DECIMAL FUNCTIONS
+   ----------------- */
+
+/* A decimal is an integer number of units of 10^-places, so 0.10 is
+   10 units with 2 places: sums and differences are exact integer
+   operations, and so are products and quotients, computed on 128 bits
+   and rounded half to even to the places of the result. A number
+   takes the places of the decimal mode, or more if it was typed with
+   more digits, and a result takes the most places of its operands.
+
+   When a result of + - * / mod doesn't fit 64 bits the operation fails
+   with an error rather than quietly losing cents to a double; the
+   operations with no exact decimal result (sqrt, exp, sin...) are done
+   on doubles. */
+
+__extension__ typedef __int128 decimal_wide;
+
+struct decimal {
+  long long units;
+  int places;
+};
+
+struct object_class decimal_class;
+
+const long long decimal_powers[MAX_DECIMAL_PLACES + 1] = {
+  1LL, 10LL, 100LL, 1000LL, 10000LL, 100000LL, 1000000LL, 10000000LL,
+  100000000LL, 1000000000LL, 10000000000LL, 100000000000LL, 1000000000000LL,
+  10000000000000LL, 100000000000000LL, 1000000000000000LL,
+  10000000000000000LL, 100000000000000000LL, 1000000000000000000LL
+};
+
+/* 10^n on 128 bits, for n up to 2 * MAX_DECIMAL_PLACES */
+decimal_wide decimal_wide_power(int n) {
+  decimal_wide p = 1;
+  while (n-- > 0) p *= 10;
+  return p;
+}
+
+/* n / d rounded half to even. The division is done on 64 bits
+   when n fits them, which is several times faster */
+decimal_wide decimal_divide_even(decimal_wide n, decimal_wide d) {
+  decimal_wide q, r;
+  if (n >= -LLONG_MAX && n <= LLONG_MAX && d >= -LLONG_MAX && d <= LLONG_MAX) {
+    q = (long long) n / (long long) d;
+    r = (long long) n % (long long) d;
+  } else {
+    q = n / d;
+    r = n % d;
+  }
+  if (r == 0) return q;
+
+  decimal_wide twice = r < 0 ? -2 * r : 2 * r, magnitude = d < 0 ? -d : d;
+  if (twice > magnitude || (twice == magnitude && (q & 1))) q += (n < 0) != (d < 0) ? -1 : 1;
+  return q;
+}
+
+/* Shrink a 128 bits result to a decimal, 0 if it doesn't fit */
+int decimal_narrow(decimal_wide units, int places, struct decimal *result) {
+  if (units > LLONG_MAX || units < -LLONG_MAX) return 0;
+  result->units = (long long) units;
+  result->places = places;
+  return 1;
+}
+
+/* Parse a decimal number straight from its digits: no exponent,
+   at most MAX_DECIMAL_PLACES decimals and 18 digits in all */
+int decimal_parse(char *input, int places, struct decimal *result) {
+  unsigned long long units = 0;
+  int negative = 0, decimals = 0, digits = 0, seen_point = 0, seen_digit = 0;
+  char *p = input;
+
+  if (*p == '-' || *p == '+') negative = *p++ == '-';
+  for (; *p; p++) {
+    if (*p == '.' && !seen_point) {
+      seen_point = 1;
+      continue;
+    }
+    if (!isdigit((unsigned char) *p)) return 0;
+    seen_digit = 1;
+    if (units > 0 || *p != '0') digits++;
+    if (digits > 18) return 0;
+    units = units * 10 + (*p - '0');
+    decimals += seen_point;
+  }
+  if (!seen_digit || decimals > MAX_DECIMAL_PLACES) return 0;
+
+  if (decimals < places) {
+    if (!decimal_narrow((decimal_wide) units * decimal_powers[places - decimals], places, result)) return 0;
+  } else {
+    result->units = (long long) units;
+    result->places = decimals;
+  }
+  if (negative) result->units = -result->units;
+  return 1;
+}
+
+/* Convert a double to a decimal with the given places, 0 if it doesn't fit */
+int decimal_from_double(double x, int places, struct decimal *result) {
+  double units = nearbyint(x * decimal_powers[places]);
+  if (!(fabs(units) < 9.2e18)) return 0;
+  result->units = (long long) units;
+  result->places = places;
+  return 1;
+}
+
+/* Get the decimal value of anything on the stack, using the given
+   places for what isn't a decimal already. 0 if it doesn't fit */
+int get_decimal(double value, int places, struct decimal *result) {
+  struct object *o = get_object(value);
+  if (o != NULL && o->class == &decimal_class) {
+    result->units = o->decimal.units;
+    result->places = o->decimal.places;
+    return 1;
+  }
+  return decimal_from_double(to_number(value), places, result);
+}
+
+/* Wrap a decimal in a stack value */
+double make_decimal(struct decimal a) {
+  double value = make_object(&decimal_class, NULL);
+  struct object *o = get_object(value);
+  o->decimal.units = a.units;
+  o->decimal.places = a.places;
+  return value;
+}
+
+/* The units of a decimal with more places */
+decimal_wide decimal_widen(struct decimal a, int places) {
+  return (decimal_wide) a.units * decimal_powers[places - a.places];
+}
+
+/* a * b, rounded to the places of the result */
+int decimal_multiply(struct decimal a, struct decimal b, struct decimal *result) {
+  int places = a.places > b.places ? a.places : b.places;
+  decimal_wide p = (decimal_wide) a.units * b.units;
+  return decimal_narrow(decimal_divide_even(p, decimal_powers[a.places + b.places - places]), places, result);
+}
+
+/* a / b, rounded to the places of the result */
+int decimal_divide(struct decimal a, struct decimal b, struct decimal *result) {
+  int places = a.places > b.places ? a.places : b.places;
+  int shift = places - a.places + b.places;
+  decimal_wide scale = decimal_wide_power(shift);
+  decimal_wide limit = ((decimal_wide) 1 << 126) / scale;
+
+  // a * 10^shift must fit 128 bits
+  if (b.units == 0 || a.units > limit || a.units < -limit) return 0;
+  return decimal_narrow(decimal_divide_even((decimal_wide) a.units * scale, b.units), places, result);
+}
+
+/* Format a decimal with all its places */
+void decimal_format(struct object *o, char *buffer, int size) {
+  long long units = o->decimal.units;
+  int places = o->decimal.places;
+  unsigned long long magnitude = units < 0 ? -(unsigned long long) units : (unsigned long long) units;
+  unsigned long long power = decimal_powers[places];
+
+  if (places == 0) snprintf(buffer, size, "%s%llu", units < 0 ? "-" : "", magnitude);
+  else snprintf(buffer, size, "%s%llu.%0*llu", units < 0 ? "-" : "", magnitude / power, places, magnitude % power);
+}
+
+/* Convert a decimal object to the nearest double */
+double decimal_to_double(struct object *o) {
+  return (double) o->decimal.units / decimal_powers[o->decimal.places];
+}
+
+/* The exact double-double value of a decimal, 0 if the value isn't one */
+int decimal_to_dd(double value, struct dd *result) {
+  struct object *o = get_object(value);
+  if (o == NULL || o->class != &decimal_class) return 0;
+
+  // Both halves fit a double exactly
+  long long high = o->decimal.units / 4294967296LL, low = o->decimal.units % 4294967296LL;
+  struct dd units = dd_add_d(dd_mul_d(dd_from((double) high), 4294967296.0), (double) low);
+  *result = dd_div(units, dd_from((double) decimal_powers[o->decimal.places]));
+  return 1;
+}
+
+/* Single operand operations on decimals: only the reciprocal is
+   exact, the others are done on doubles */
+int decimal_operation_1o(operation_1o f, double x, double *result) {
+  struct decimal a, one = { 1, 0 }, r;
+  if (f != reciprocal || !get_decimal(x, decimal_places, &a) || !decimal_divide(one, a, &r)) return 0;
+  *result = make_decimal(r);
+  return 1;
+}
+
+/* Report a result too big for a decimal */
+int decimal_overflow(void) {
+  sprintf(error_buffer, "ERROR: The result doesn't fit a decimal");
+  return -1;
+}
+
+/* Two operands operations on decimals */
+int decimal_operation_2o(operation_2o f, double x, double y, double *result) {
+  struct object *ox = get_object(x), *oy = get_object(y);
+  int hint = ox != NULL && ox->class == &decimal_class ? ox->decimal.places : oy->decimal.places;
+  struct decimal a, b, r;
+
+  if (!get_decimal(y, hint, &a) || !get_decimal(x, hint, &b)) return 0;
+
+  int places = a.places > b.places ? a.places : b.places;
+  decimal_wide wa = decimal_widen(a, places), wb = decimal_widen(b, places);
+
+  if (f == sum) {
+    if (!decimal_narrow(wa + wb, places, &r)) return decimal_overflow();
+  }
+  else if (f == subtraction) {
+    if (!decimal_narrow(wa - wb, places, &r)) return decimal_overflow();
+  }
+  else if (f == multiplication) {
+    if (!decimal_multiply(a, b, &r)) return decimal_overflow();
+  }
+  else if (f == division || f == modulo) {
+    if (b.units == 0) {
+      sprintf(error_buffer, "ERROR: Division by zero");
+      return -1;
+    }
+    if (f == division ? !decimal_divide(a, b, &r) : !decimal_narrow(wa % wb, places, &r)) return decimal_overflow();
+  }
+  else if (f == less_than) { *result = wa < wb; return 1; }
+  else if (f == greater_than) { *result = wa > wb; return 1; }
+  else if (f == less_or_equal) { *result = wa <= wb; return 1; }
+  else if (f == greater_or_equal) { *result = wa >= wb; return 1; }
+  else if (f == equal_to) { *result = wa == wb; return 1; }
+  else if (f == not_equal_to) { *result = wa != wb; return 1; }
+  else return 0;
+
+  *result = make_decimal(r);
+  return 1;
+}
+
+struct object_class decimal_class = {
+  "decimal", 2, 1,
+  decimal_format, decimal_to_double,
+  decimal_operation_1o, decimal_operation_2o,
+  NULL, NULL
+};
+
+/* dec k: set the decimal arithmetic mode, with k places
+   (or the places set last time when k is missing) */
+void set_decimal_arithmetic_mode(char *parameter) {
+  if (parameter[0] != '\0') {
+    char *end;
+    long places = strtol(parameter, &end, 10);
+    if (*end != '\0' || places < 0 || places > MAX_DECIMAL_PLACES) {
+      sprintf(error_buffer, "ERROR: The decimal places must be between 0 and %d", MAX_DECIMAL_PLACES);
+      return;
+    }
+    decimal_places = (int) places;
+  }
+  arithmetic_mode = 'k';
+}
@@ -0,0 +1,444 @@
+// SPDX-License-Identifier: GPL-2.0
+/* luka_fft.c
+ *
+ * A simple RPN calculator for terminal
+ * made with love in Italy.
+ *
+ * Copyright 2025 Davide Mastromatteo
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/* -------------
+   FFT FUNCTIONS
+   ------------- */
+
+/* Signals are arrays, spectra are n x 2 matrices (real and imaginary
+   parts), so they can be looked at and worked on like any matrix.
+
+   Power of two lengths use an iterative decimation in time FFT: after
+   the bit reversal the stages are done two at a time as radix-4
+   butterflies (3 complex products every 4 points instead of 4), with
+   a last radix-2 stage for odd powers. Other lengths go through
+   Bluestein's algorithm, a convolution computed with power of two
+   FFTs. A real signal of even length is transformed as a complex one
+   of half the length, then split. Twiddle factors (and Bluestein's
+   chirps) are computed once per length and kept in a small cache. */
+
+struct fft_plan {
+  long n;
+  unsigned long last_used;
+  double complex *twiddles;
+  long m;
+  double complex *chirp;
+  double complex *chirp_spectrum;
+};
+
+void fft(double complex *x, long n, int inverse);
+
+/* Allocate an array of complex numbers */
+double complex *complex_new(long n) {
+  double complex *x = calloc(n > 0 ? n : 1, sizeof(double complex));
+  if (x == NULL) {
+    printf("ERROR: You run out of memory. Exiting.");
+    exit(1);
+  }
+  return x;
+}
+
+/* Tell if n is a power of two */
+int is_power_of_two(long n) {
+  return n > 0 && (n & (n - 1)) == 0;
+}
+
+/* Allocate a table of a plan, kept for the session */
+double complex *fft_plan_table(long n) {
+  return memset(arena_alloc(ARENA_ARRAYS, n * sizeof(double complex)), 0, n * sizeof(double complex));
+}
+
+/* Free the tables of a plan */
+void fft_plan_release(struct fft_plan *plan) {
+  arena_free(plan->twiddles);
+  arena_free(plan->chirp);
+  arena_free(plan->chirp_spectrum);
+  memset(plan, 0, sizeof(struct fft_plan));
+}
+
+/* Get the plan of a length from the cache, computing it if needed */
+struct fft_plan *get_fft_plan(long n) {
+  if (fft_plans == NULL) {
+    fft_plans = arena_alloc(ARENA_ARRAYS, FFT_PLAN_CACHE_LENGTH * sizeof(struct fft_plan));
+    memset(fft_plans, 0, FFT_PLAN_CACHE_LENGTH * sizeof(struct fft_plan));
+  }
+
+  fft_clock++;
+  struct fft_plan *lru = &fft_plans[0];
+  for (int i = 0; i < FFT_PLAN_CACHE_LENGTH; i++) {
+    if (fft_plans[i].n == n) {
+      fft_plans[i].last_used = fft_clock;
+      return &fft_plans[i];
+    }
+    if (fft_plans[i].last_used < lru->last_used) lru = &fft_plans[i];
+  }
+
+  fft_plan_release(lru);
+  lru->n = n;
+  lru->last_used = fft_clock;
+
+  if (is_power_of_two(n)) {
+    lru->twiddles = fft_plan_table(n);
+    for (long k = 0; k < n; k++) lru->twiddles[k] = cexp(-2 * M_PI * I * k / n);
+    return lru;
+  }
+
+  // Bluestein: x[k] · c[k] convolved with conj(c), c[k] = e^(-iπk²/n)
+  long m = 1;
+  while (m < 2 * n - 1) m *= 2;
+  lru->m = m;
+  lru->chirp = fft_plan_table(n);
+  lru->chirp_spectrum = fft_plan_table(m);
+  for (long k = 0; k < n; k++) {
+    long k2 = (long) ((unsigned long long) k * k % (2 * n));
+    lru->chirp[k] = cexp(-M_PI * I * k2 / n);
+  }
+  lru->chirp_spectrum[0] = conj(lru->chirp[0]);
+  for (long k = 1; k < n; k++) {
+    lru->chirp_spectrum[k] = lru->chirp_spectrum[m - k] = conj(lru->chirp[k]);
+  }
+  fft(lru->chirp_spectrum, m, 0);
+  return lru;
+}
+
+/* Product of two complex numbers, without the checks for infinities
+   that the compiler adds to the * operator */
+double complex complex_multiply(double complex a, double complex b) {
+  return CMPLX(creal(a) * creal(b) - cimag(a) * cimag(b), creal(a) * cimag(b) + cimag(a) * creal(b));
+}
+
+/* In place FFT of a power of two length */
+void fft_radix4(double complex *x, long n, double complex *w) {
+  for (long i = 1, j = 0; i < n; i++) {
+    long bit = n >> 1;
+    for (; j & bit; bit >>= 1) j ^= bit;
+    j ^= bit;
+    if (i < j) {
+      double complex t = x[i];
+      x[i] = x[j];
+      x[j] = t;
+    }
+  }
+
+  long length = 1;
+  int log2n = 0;
+  while ((1L << log2n) < n) log2n++;
+  if (log2n & 1) {
+    for (long k = 0; k < n; k += 2) {
+      double complex a = x[k], b = x[k + 1];
+      x[k] = a + b;
+      x[k + 1] = a - b;
+    }
+    length = 2;
+  }
+
+  // Two radix-2 stages at once: four transforms of length L become one of 4L
+  for (; length < n; length *= 4) {
+    long stride = n / (4 * length);
+    for (long k = 0; k < n; k += 4 * length) {
+      double complex *x0 = x + k, *x1 = x0 + length, *x2 = x1 + length, *x3 = x2 + length;
+      if (job_cancelled()) return;
+      for (long j = 0; j < length; j++) {
+        double complex w1 = w[j * stride], w2 = w[2 * j * stride];
+        double complex b = complex_multiply(w2, x1[j]), d = complex_multiply(w2, x3[j]);
+        double complex e0 = x0[j] + b, e1 = x0[j] - b;
+        double complex f0 = complex_multiply(w1, x2[j] + d), f1 = complex_multiply(w1, x2[j] - d);
+        x0[j] = e0 + f0;
+        x2[j] = e0 - f0;
+        double complex g1 = CMPLX(cimag(f1), -creal(f1));
+        x1[j] = e1 + g1;
+        x3[j] = e1 - g1;
+      }
+    }
+  }
+}
+
+/* In place FFT of any length, the inverse one scaled by 1/n */
+void fft(double complex *x, long n, int inverse) {
+  if (n <= 1) return;
+  if (inverse) for (long k = 0; k < n; k++) x[k] = conj(x[k]);
+
+  struct fft_plan *plan = get_fft_plan(n);
+  if (plan->twiddles != NULL) fft_radix4(x, n, plan->twiddles);
+  else {
+    long m = plan->m;
+    double complex *y = complex_new(m);
+    for (long k = 0; k < n; k++) y[k] = complex_multiply(x[k], plan->chirp[k]);
+    fft(y, m, 0);
+    plan = get_fft_plan(n);
+    for (long k = 0; k < m; k++) y[k] = conj(complex_multiply(y[k], plan->chirp_spectrum[k]));
+    fft(y, m, 0);
+    plan = get_fft_plan(n);
+    for (long k = 0; k < n; k++) x[k] = complex_multiply(conj(y[k]), plan->chirp[k]) / m;
+    free(y);
+  }
+
+  if (inverse) for (long k = 0; k < n; k++) x[k] = conj(x[k]) / n;
+}
+
+/* Spectrum of a real signal: for an even length, transform the pairs
+   of samples as complex numbers of half the length and split them */
+double complex *fft_real(double *x, long n) {
+  double complex *X = complex_new(n);
+  if (n % 2 != 0 || n < 4) {
+    for (long k = 0; k < n; k++) X[k] = x[k];
+    fft(X, n, 0);
+    return X;
+  }
+
+  long h = n / 2;
+  double complex *w = is_power_of_two(n) ? get_fft_plan(n)->twiddles : NULL;
+  double complex *z = complex_new(h);
+  for (long k = 0; k < h; k++) z[k] = x[2 * k] + I * x[2 * k + 1];
+  fft(z, h, 0);
+  if (w != NULL) w = get_fft_plan(n)->twiddles;
+
+  for (long k = 0; k < h; k++) {
+    double complex a = z[k], b = conj(z[k == 0 ? 0 : h - k]);
+    double complex even = (a + b) / 2, odd = CMPLX(cimag(a - b) / 2, -creal(a - b) / 2);
+    double complex t = complex_multiply(w != NULL ? w[k] : cexp(-2 * M_PI * I * k / n), odd);
+    X[k] = even + t;
+    X[k + h] = even - t;
+  }
+  free(z);
+  return X;
+}
+
+/* Get a signal from the stack: an array, or a n x 2 matrix for a complex one.
+   Returns the length, -1 (with an error) if the value isn't a signal */
+long get_signal(double value, double complex **x, int *complex_signal) {
+  struct matrix *m = get_matrix(value);
+  if (m != NULL) {
+    if (m->cols != 2) {
+      sprintf(error_buffer, "ERROR: A complex signal is a n x 2 matrix");
+      return -1;
+    }
+    *x = complex_new(m->rows);
+    for (long k = 0; k < m->rows; k++) (*x)[k] = matrix_row(m, k)[0] + I * matrix_row(m, k)[1];
+    *complex_signal = 1;
+    return m->rows;
+  }
+
+  struct sequence *s = get_sequence(value);
+  if (s == NULL) {
+    sprintf(error_buffer, "ERROR: The signal has to be an array or a n x 2 matrix");
+    return -1;
+  }
+  struct buffer *b = sequence_collect(s);
+  if (b == NULL) return -1;
+  long n = b->length;
+  *x = complex_new(n);
+  for (long k = 0; k < n; k++) (*x)[k] = b->data[k];
+  buffer_release(b);
+  *complex_signal = 0;
+  return n;
+}
+
+/* Get the values of a real signal from the stack, NULL on error */
+struct buffer *get_real_signal(double value) {
+  struct sequence *s = get_sequence(value);
+  if (s == NULL) {
+    sprintf(error_buffer, "ERROR: The signal has to be an array");
+    return NULL;
+  }
+  return sequence_collect(s);
+}
+
+/* Make a n x 2 matrix from complex values */
+double make_complex_matrix(double complex *x, long n) {
+  struct matrix *m = matrix_new(n, 2);
+  if (m == NULL) return NAN;
+  for (long k = 0; k < n; k++) {
+    matrix_row(m, k)[0] = creal(x[k]);
+    matrix_row(m, k)[1] = cimag(x[k]);
+  }
+  return make_matrix(m);
+}
+
+/* Replace the signal at the top of the stack with a result */
+void replace_signal(double r, char *name) {
+  if (!is_object(r) || job_cancelled()) return;
+  double x = pop();
+  push(r);
+  log_operation_1o(x, name, r);
+}
+
+/* fft: spectrum of a signal */
+void compute_fft(void) {
+  if (sp < 1) return;
+  double complex *x;
+  int complex_signal;
+  double r;
+
+  struct sequence *s = get_sequence(pick(sp));
+  if (s != NULL) {
+    struct buffer *b = get_real_signal(pick(sp));
+    if (b == NULL) return;
+    x = fft_real(b->data, b->length);
+    r = make_complex_matrix(x, b->length);
+    buffer_release(b);
+    free(x);
+    replace_signal(r, "fft");
+    return;
+  }
+
+  long n = get_signal(pick(sp), &x, &complex_signal);
+  if (n < 0) return;
+  fft(x, n, 0);
+  r = make_complex_matrix(x, n);
+  free(x);
+  replace_signal(r, "fft");
+}
+
+/* ifft: signal of a spectrum. When the spectrum is the one of a
+   real signal the result is an array, otherwise a n x 2 matrix */
+void compute_ifft(void) {
+  if (sp < 1) return;
+  double complex *x;
+  int complex_signal;
+
+  long n = get_signal(pick(sp), &x, &complex_signal);
+  if (n < 0) return;
+
+  double magnitude = 0, asymmetry = 0;
+  for (long k = 0; k < n; k++) {
+    magnitude = fmax(magnitude, cabs(x[k]));
+    asymmetry = fmax(asymmetry, cabs(x[k] - conj(x[(n - k) % n])));
+  }
+  fft(x, n, 1);
+
+  double r;
+  if (asymmetry <= 1e-9 * magnitude) {
+    struct buffer *b = buffer_new(n);
+    if (b == NULL) {
+      sprintf(error_buffer, "ERROR: The signal doesn't fit in memory");
+      free(x);
+      return;
+    }
+    for (long k = 0; k < n; k++) b->data[k] = creal(x[k]);
+    r = make_array(b);
+  }
+  else r = make_complex_matrix(x, n);
+
+  free(x);
+  replace_signal(r, "ifft");
+}
+
+/* Linear convolution of a and b in c (na + nb - 1 values), directly
+   when they are short, through the FFT when they are long */
+void convolve(double *a, long na, double *b, long nb, double *c) {
+  long n = na + nb - 1;
+
+  if ((double) na * nb <= DIRECT_CONVOLUTION_SIZE) {
+    memset(c, 0, n * sizeof(double));
+    for (long i = 0; i < na; i++) {
+      for (long j = 0; j < nb; j++) c[i + j] += a[i] * b[j];
+    }
+    return;
+  }
+
+  // One FFT of a + ib gives both spectra
+  long m = 1;
+  while (m < n) m *= 2;
+  double complex *z = complex_new(m);
+  for (long k = 0; k < na; k++) z[k] = a[k];
+  for (long k = 0; k < nb; k++) z[k] += I * b[k];
+  fft(z, m, 0);
+
+  double complex *p = complex_new(m);
+  for (long k = 0; k < m; k++) {
+    double complex u = z[k], v = conj(z[(m - k) % m]);
+    p[k] = complex_multiply((u + v) / 2, CMPLX(cimag(u - v) / 2, -creal(u - v) / 2));
+  }
+  fft(p, m, 1);
+  for (long k = 0; k < n; k++) c[k] = creal(p[k]);
+  free(z);
+  free(p);
+}
+
+/* conv: linear convolution of two arrays */
+void compute_convolution(void) {
+  if (sp < 2) return;
+  struct buffer *a = get_real_signal(pick(sp - 1));
+  if (a == NULL) return;
+  struct buffer *b = get_real_signal(pick(sp));
+  if (b == NULL) {
+    buffer_release(a);
+    return;
+  }
+
+  struct buffer *c = a->length > 0 && b->length > 0 ? buffer_new(a->length + b->length - 1) : NULL;
+  if (c == NULL) {
+    sprintf(error_buffer, "ERROR: Invalid convolution");
+    buffer_release(a);
+    buffer_release(b);
+    return;
+  }
+  convolve(a->data, a->length, b->data, b->length, c->data);
+
+  buffer_release(a);
+  buffer_release(b);
+  if (job_cancelled()) {
+    buffer_release(c);
+    return;
+  }
+
+  double r = make_array(c);
+  double x = pop();
+  double y = pop();
+  push(r);
+  log_operation_2o(y, x, "conv", r);
+}
+
+/* psd: one-sided power spectrum of an array, scaled
+   so that its sum is the mean square of the signal */
+void compute_power_spectrum(void) {
+  if (sp < 1) return;
+  struct buffer *b = get_real_signal(pick(sp));
+  if (b == NULL) return;
+
+  long n = b->length;
+  struct buffer *p = n > 0 ? buffer_new(n / 2 + 1) : NULL;
+  if (p == NULL) {
+    sprintf(error_buffer, "ERROR: Invalid signal");
+    buffer_release(b);
+    return;
+  }
+
+  double complex *X = fft_real(b->data, n);
+  for (long k = 0; k <= n / 2; k++) {
+    double power = creal(X[k]) * creal(X[k]) + cimag(X[k]) * cimag(X[k]);
+    int mirrored = k > 0 && 2 * k != n;
+    p->data[k] = power / ((double) n * n) * (mirrored ? 2 : 1);
+  }
+  free(X);
+  buffer_release(b);
+  replace_signal(make_array(p), "psd");
+}
+
+/* Free the cached plans */
+void free_fft_plans(void) {
+  if (fft_plans == NULL) return;
+  for (int i = 0; i < FFT_PLAN_CACHE_LENGTH; i++) fft_plan_release(&fft_plans[i]);
+  arena_free(fft_plans);
+  fft_plans = NULL;
+}
@@ -34,6 +34,95 @@ typedef void (*operation_0o_with_parameter)(char*);
 typedef double (*operation_1o)(double);
 typedef double (*operation_2o)(double, double);
 
+int compute_object_operation_1o(operation_1o, double, double*);
+int compute_object_operation_2o(operation_2o, double, double, double*);
+void format_value(char*, int, double);
+double to_number(double);
+double make_dd_pair(double, double);
+int compute_sequence_trigonometric_operation(operation_1o, double, double*);
+double random_uniform(unsigned long long*);
+int is_shared_name(char*);
+void shared_store(char*, double);
+int shared_load(char*, double*);
+void shared_delete(char*);
+double factorial(double);
+double to_power(double, double);
+
+/* Costly pure operations remember their last results, so scripts and
+   words calling them again with the same operands don't compute them
+   again. Each one has its own direct mapped cache, keyed on the bits
+   of the operands and on the angle mode; a new result simply takes the
+   place of the old one. Only the operations listed here are cached:
+   the cheap ones would pay more for the lookup than for the result, and
+   the impure ones, like the random numbers, must never be. The caches
+   aren't locked, so map, filter and mc don't use them on the workers. */
+struct memo_entry {
+  unsigned long long x;
+  unsigned long long y;
+  double r;
+  char mode;
+  char used;
+};
+
+struct memo_cache {
+  char *name;
+  operation_1o f1;
+  operation_2o f2;
+  long hits;
+  long misses;
+  struct memo_entry entries[MEMO_CACHE_LENGTH];
+};
+
+struct memo_cache memo_caches[] = {
+  { .name = "!", .f1 = factorial },
+  { .name = "^", .f2 = to_power },
+};
+
+#define MEMO_CACHES ((int) (sizeof(memo_caches) / sizeof(memo_caches[0])))
+
+/* The cache of an operation, NULL if it isn't memoized */
+struct memo_cache *get_memo_cache(operation_1o f1, operation_2o f2) {
+  for (int i = 0; i < MEMO_CACHES; i++) {
+    if ((f1 != NULL && memo_caches[i].f1 == f1) || (f2 != NULL && memo_caches[i].f2 == f2)) return &memo_caches[i];
+  }
+  return NULL;
+}
+
+/* Result of a memoized operation, computed only on a miss */
+double memo_compute(struct memo_cache *c, double x, double y) {
+  unsigned long long bx, by;
+  memcpy(&bx, &x, sizeof(bx));
+  memcpy(&by, &y, sizeof(by));
+
+  // The top bits of a double tell the most, fold them down before mixing
+  unsigned long long h = ((bx ^ (bx >> 32)) * 0x9E3779B97F4A7C15ULL) ^ ((by ^ (by >> 32)) * 0xC2B2AE3D27D4EB4FULL);
+  struct memo_entry *e = &c->entries[((h >> 32) ^ (unsigned char) mode) % MEMO_CACHE_LENGTH];
+  if (e->used && e->x == bx && e->y == by && e->mode == mode) {
+    c->hits++;
+    return e->r;
+  }
+
+  c->misses++;
+  e->r = c->f1 != NULL ? c->f1(x) : c->f2(x, y);
+  e->x = bx;
+  e->y = by;
+  e->mode = mode;
+  e->used = 1;
+  return e->r;
+}
+
+/* Apply a single operand operation to a number, through its cache if it has one */
+double apply_operation_1o(operation_1o f, double x) {
+  struct memo_cache *c = get_memo_cache(f, NULL);
+  return c != NULL ? memo_compute(c, x, 0) : f(x);
+}
+
+/* Apply a two-operands operation to numbers, through its cache if it has one */
+double apply_operation_2o(operation_2o f, double x, double y) {
+  struct memo_cache *c = get_memo_cache(NULL, f);
+  return c != NULL ? memo_compute(c, x, y) : f(x, y);
+}
+
 /* Compute an operation that doesn't take any operands */
 void compute_operation_0o(operation_0o f) {
   f();
@@ -43,7 +132,12 @@ void compute_operation_0o(operation_0o f) {
 void compute_operation_1o(operation_1o f, char *name) {
   if (sp < 1) return;
   double x = pop();
-  double r = f(x);
+  double r = 0;
+
+  switch (compute_object_operation_1o(f, x, &r)) {
+    case -1: push(x); return;
+    case 0: r = apply_operation_1o(f, x); break;
+  }
   push(r);
   log_operation_1o(x, name, r);
 }
@@ -54,8 +148,18 @@ void compute_operation_1o(operation_1o f, char *name) {
 void compute_trigonometric_operation_1o(operation_1o f, char *name) {
   if (sp < 1) return;
   double x = pop();
+  double r = 0;
+
+  // On a sequence the operation is just recorded, with the current mode
+  if (compute_sequence_trigonometric_operation(f, x, &r)) {
+    push(r);
+    log_operation_1o(x, name, r);
+    return;
+  }
+
+  x = to_number(x);
   if (mode == 'd') x = x * M_PI / 180;
-  double r = f(x);
+  r = f(x);
   push(r);
   log_operation_1o(x, name, r);
 }
@@ -71,7 +175,12 @@ void compute_operation_2o(operation_2o f, char *name) {
   if (sp < 2) return;
   double x = pop();
   double y = pop();
-  double r = f(x, y);
+  double r = 0;
+
+  switch (compute_object_operation_2o(f, x, y, &r)) {
+    case -1: push(y); push(x); return;
+    case 0: r = apply_operation_2o(f, x, y); break;
+  }
   push(r);
   log_operation_2o(y, x, name, r);
 }
@@ -81,31 +190,62 @@ void log_operation(char* entry) {
   if (n_operation_log >= current_history_length) {
     
       // The shistory array need to be resized
-      int new_history_length = current_history_length + INCREMENT_HISTORY_STEP;
+      int new_history_length = current_history_length * 2;
 
-      operation_log = realloc(operation_log, (new_history_length) * sizeof(char*));
-      if (operation_log == NULL) {
-        printf("ERROR: You run out of memory. Exiting.");
-        exit(1);
-      }
+      operation_log = arena_realloc(ARENA_HISTORY, operation_log, (new_history_length) * sizeof(char*));
 //      sprintf(error_buffer, "Your history log has been resized to %d", new_history_length);
       current_history_length = new_history_length;
   }
-  operation_log[n_operation_log] = strdup(entry);
+  operation_log[n_operation_log] = arena_strdup(ARENA_HISTORY, entry);
+}
+
+/* Forget the oldest history entries when there are more than
+   MAX_HISTORY_LENGTH, keeping the newest three quarters */
+void trim_history(void) {
+  if (n_operation_log <= MAX_HISTORY_LENGTH) return;
+  int drop = n_operation_log - MAX_HISTORY_LENGTH * 3 / 4;
+  for (int i = 0; i < drop; i++) arena_free(operation_log[i]);
+  memmove(operation_log, operation_log + drop, (n_operation_log - drop) * sizeof(char*));
+  n_operation_log -= drop;
+}
+
+/* Free the history and its entries */
+void free_history(void) {
+  while (n_operation_log > 0) arena_free(operation_log[--n_operation_log]);
+  arena_free(operation_log);
+  operation_log = NULL;
 }
 
 /* Log operations involving two operands*/
 void log_operation_2o(double y, double x, char *name, double r) {
-  char entry[50] = "";
-  sprintf(entry, "%lg %s %lg = %lg", y, name, x, r);
+  if (history_suspended) return;
+  char entry[100] = "", sy[26], sx[26], sr[26];
+  format_value(sy, sizeof(sy), y);
+  format_value(sx, sizeof(sx), x);
+  format_value(sr, sizeof(sr), r);
+  sprintf(entry, "%s %s %s = %s", sy, name, sx, sr);
   log_operation(entry);
   n_operation_log ++;
 }
 
 /* Log operations involving just a single operand*/
 void log_operation_1o(double x, char *name, double r) {
-  char entry[50] = "";
-  sprintf(entry, "%lg %s = %lg", x, name, r);
+  if (history_suspended) return;
+  char entry[100] = "", sx[26], sr[26];
+  format_value(sx, sizeof(sx), x);
+  format_value(sr, sizeof(sr), r);
+  sprintf(entry, "%s %s = %s", sx, name, sr);
+  log_operation(entry);
+  n_operation_log ++;
+}
+
+/* Log a command by its result, like words and expressions
+   running many operations in a single history entry */
+void log_operation_result(char *name) {
+  if (history_suspended || sp < 1) return;
+  char entry[100] = "", sr[26];
+  format_value(sr, sizeof(sr), pick(sp));
+  snprintf(entry, sizeof(entry), "%.60s = %s", name, sr);
   log_operation(entry);
   n_operation_log ++;
 }
@@ -139,6 +279,36 @@ double division(double x, double y) {
   return y / x;
 }
 
+/* Compute the remainder of the division between two numbers */
+double modulo(double x, double y) {
+  return fmod(y, x);
+}
+
+/* Comparisons: 1 if y compares to x as asked, 0 otherwise */
+double less_than(double x, double y) {
+  return y < x;
+}
+
+double greater_than(double x, double y) {
+  return y > x;
+}
+
+double less_or_equal(double x, double y) {
+  return y <= x;
+}
+
+double greater_or_equal(double x, double y) {
+  return y >= x;
+}
+
+double equal_to(double x, double y) {
+  return y == x;
+}
+
+double not_equal_to(double x, double y) {
+  return y != x;
+}
+
 /* Compute the factorial of a number*/
 double factorial(double x) {
   return tgamma(x+1);
@@ -155,17 +325,26 @@ double reciprocal(double x) {
 
 /* Push the PI value to the stack */
 void push_pi(void) {
+  if (arithmetic_mode == 'q') {
+    push(make_dd_pair(3.141592653589793116e+00, 1.224646799147353207e-16));
+    return;
+  }
   push(M_PI);
 }
 
 /* Push the eulero's number to the stack */
 void push_e(void) {
+  if (arithmetic_mode == 'q') {
+    push(make_dd_pair(2.718281828459045091e+00, 1.445646891729250158e-16));
+    return;
+  }
   push(M_E);
 }
 
 /* Push a random value between 0 and 1 to the stack */
 void push_random(void) {
-  push(drand48());
+  unrepeatable = 1;
+  push(random_uniform(random_state));
 }
 
 /* *****************************
@@ -190,13 +369,17 @@ int search_memory(char *parameter) {
 /* Store a value in the calculator memory */
 void store(char *parameter) {
   int i = -1;
-  char buffer[10];
 
   if (strlen(parameter) > MAX_MEMORY_NAME_LENGTH) {
     sprintf(error_buffer, "ERROR: Memory names can be at maximum %d bytes length", MAX_MEMORY_NAME_LENGTH);
     return;
   }
 
+  if (is_shared_name(parameter)) {
+    if (sp > 0) shared_store(parameter, pick(sp));
+    return;
+  }
+
   if ((i = search_memory(parameter)) == -1) {
 
     if (n_memories >= current_memories_length) {
@@ -208,31 +391,45 @@ void store(char *parameter) {
       }
 
       // Memories need to be resized
-      int new_memories_length = current_memories_length + INCREMENT_MEMORIES_STEP;
+      int new_memories_length = current_memories_length * 2;
       if (new_memories_length > MAX_MEMORIES_LENGTH) new_memories_length = MAX_MEMORIES_LENGTH;
 
-      memories = (char**)realloc(memories, (new_memories_length * sizeof(char*)));
-      values = (double*)realloc(values, (new_memories_length * sizeof(double)));
-
-      if ((memories == NULL) || (values == NULL)) {
-        printf("ERROR: You run out of memory. Exiting.");
-        exit(1);
-      }
+      memories = arena_realloc(ARENA_MEMORIES, memories, (new_memories_length * sizeof(char*)));
+      values = arena_realloc(ARENA_MEMORIES, values, (new_memories_length * sizeof(double)));
 
       current_memories_length = new_memories_length;
     }
 
     i = n_memories;
     n_memories++;
+    memories[i] = arena_strdup(ARENA_MEMORIES, parameter);
+    ((double*)values)[i] = pick(sp);
+    journal_record('m', i, 0, pick(sp), memories[i]);
+    return;
   }
 
+  journal_record('m', i, ((double*)values)[i], pick(sp), NULL);
   ((double*)values)[i] = pick(sp);
-  strcpy(buffer, parameter);
-  memories[i] = strdup(buffer);
+}
+
+/* Free the memories and their names */
+void free_memories(void) {
+  for (int i = 0; i < n_memories; i++) arena_free(memories[i]);
+  arena_free(memories);
+  arena_free(values);
+  memories = NULL;
+  values = NULL;
+  n_memories = 0;
 }
 
 /* Load a value from the calculator memory and push it into the stack */
 void load(char *parameter) {
+  double value;
+  if (is_shared_name(parameter)) {
+    if (shared_load(parameter, &value)) push(value);
+    return;
+  }
+
   for (int i=0; i < n_memories; i++) {
     if (strcmp(memories[i], parameter) == 0) {
       push(((double*)values)[i]);
@@ -241,16 +438,22 @@ void load(char *parameter) {
   }
 }
 
-/* Remove a value from the calculator memory */
+/* Remove a value from the calculator memory.
+   The name is handed over to the journal, 
+   so the deletion can be undone */
 void del(char *parameter) {
-  int k=0;
-  for (int i=0; i < n_memories; i++) {
-    if (k == 1) {
-      memories[i - 1] = memories[i];
-      ((double*)values)[i - 1] = ((double*)values)[i];
-    }
+  if (is_shared_name(parameter)) {
+    shared_delete(parameter);
+    return;
+  }
+
+  int i = search_memory(parameter);
+  if (i == -1) return;
 
-    if (strcmp(memories[i], parameter) == 0) k = 1;
-  }  
-  n_memories -= k;
+  journal_record('x', i, ((double*)values)[i], 0, memories[i]);
+  for (int k = i + 1; k < n_memories; k++) {
+    memories[k - 1] = memories[k];
+    ((double*)values)[k - 1] = ((double*)values)[k];
+  }
+  n_memories--;
 }
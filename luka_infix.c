@@ -0,0 +1,345 @@
+// SPDX-License-Identifier: GPL-2.0
+/* luka_infix.c
+ *
+ * A simple RPN calculator for terminal
+ * made with love in Italy.
+ *
+ * Copyright 2025 Davide Mastromatteo
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/* ---------------
+   INFIX FUNCTIONS
+   --------------- */
+
+/* Lines like "(3+4)*sin(x)" are parsed by a Pratt parser and lowered
+   to the same programs used by the words: operators and functions
+   become the usual operations, and any other name loads a memory.
+   The programs are kept in a small LRU cache keyed by the expression,
+   so an expression seen again is run without being parsed again. */
+
+#define INFIX_OPERATORS "()+-*/^%!"
+
+struct infix_entry {
+  char *key;
+  struct program *program;
+  unsigned long last_used;
+};
+
+struct infix_parser {
+  char *s;
+  struct program *program;
+  char *names;
+  int error;
+};
+
+void parse_infix_expression(struct infix_parser *parser, int min_power);
+int check_input_if_numeric(char*, double*);
+
+/* Skip the spaces and return the next character */
+char infix_peek(struct infix_parser *parser) {
+  while (*parser->s == ' ') parser->s++;
+  return *parser->s;
+}
+
+/* Report a syntax error, keeping the first one */
+void infix_error(struct infix_parser *parser, char *message) {
+  if (parser->error) return;
+  sprintf(error_buffer, "ERROR: %s", message);
+  parser->error = 1;
+}
+
+/* Copy a name in the strings of the program being compiled */
+char *infix_name(struct infix_parser *parser, char *start, int length) {
+  char *name = parser->names;
+  memcpy(name, start, length);
+  name[length] = '\0';
+  parser->names += length + 1;
+  return name;
+}
+
+/* Emit an instruction */
+void infix_emit(struct infix_parser *parser, struct instruction instruction) {
+  program_append(parser->program, instruction);
+}
+
+/* Emit the push of a number */
+void infix_emit_number(struct infix_parser *parser, double value) {
+  struct instruction instruction = { .kind = 'n', .value = value };
+  infix_emit(parser, instruction);
+}
+
+/* Emit a binary operator, using the same operation the RPN command uses */
+void infix_emit_operator(struct infix_parser *parser, char op) {
+  char *name = infix_name(parser, &op, 1);
+  struct instruction instruction = { .kind = '2', .f2 = get_operation_2o(name), .name = name };
+  infix_emit(parser, instruction);
+}
+
+/* Parse a number, in the current arithmetic mode */
+void parse_infix_number(struct infix_parser *parser) {
+  char literal[MAX_INPUT_BUFFER];
+  char *end;
+  double value;
+
+  strtod(parser->s, &end);
+  int length = end - parser->s;
+  if (length == 0 || length >= MAX_INPUT_BUFFER) {
+    infix_error(parser, "Invalid number in the expression");
+    return;
+  }
+  memcpy(literal, parser->s, length);
+  literal[length] = '\0';
+  parser->s = end;
+
+  if (!parse_numeric_input(literal, &value)) {
+    infix_error(parser, "Invalid number in the expression");
+    return;
+  }
+  infix_emit_number(parser, value);
+}
+
+/* Parse a function call, "name(a, b)", once the name has been read */
+void parse_infix_call(struct infix_parser *parser, char *name) {
+  int arguments = 0;
+
+  parser->s++;
+  if (infix_peek(parser) != ')') {
+    do {
+      if (arguments > 0) parser->s++;
+      parse_infix_expression(parser, 0);
+      arguments++;
+    } while (!parser->error && infix_peek(parser) == ',');
+  }
+  if (parser->error) return;
+  if (infix_peek(parser) != ')') {
+    infix_error(parser, "Missing ) in the expression");
+    return;
+  }
+  parser->s++;
+
+  struct instruction instruction = { .name = name };
+  if (arguments == 1 && (instruction.f1 = get_trigonometric_operation_1o(name))) instruction.kind = 't';
+  else if (arguments == 1 && (instruction.f1 = get_operation_1o(name))) instruction.kind = '1';
+  else if (arguments == 2 && (instruction.f2 = get_operation_2o(name))) instruction.kind = '2';
+  else {
+    snprintf(error_buffer, sizeof(error_buffer), "ERROR: Unknown function %s with %d arguments", name, arguments);
+    parser->error = 1;
+    return;
+  }
+  infix_emit(parser, instruction);
+}
+
+/* Parse a name: a function call, a constant or a memory */
+void parse_infix_name(struct infix_parser *parser) {
+  char *start = parser->s;
+  while (isalnum((unsigned char) *parser->s) || *parser->s == '_') parser->s++;
+  char *name = infix_name(parser, start, parser->s - start);
+
+  if (infix_peek(parser) == '(') {
+    parse_infix_call(parser, name);
+    return;
+  }
+
+  operation_0o f = get_operation_0o(name);
+  if (f == push_pi || f == push_e || f == push_random || f == push_normal) {
+    struct instruction instruction = { .kind = '0', .f0 = f, .name = name };
+    infix_emit(parser, instruction);
+    return;
+  }
+
+  struct instruction instruction = { .kind = 'p', .fp = load, .name = "load", .parameter = name };
+  infix_emit(parser, instruction);
+}
+
+/* Parse an operand: a number, a name, a parenthesized
+   expression or a unary minus */
+void parse_infix_operand(struct infix_parser *parser) {
+  char c = infix_peek(parser);
+
+  if (c == '(') {
+    parser->s++;
+    parse_infix_expression(parser, 0);
+    if (infix_peek(parser) != ')') {
+      infix_error(parser, "Missing ) in the expression");
+      return;
+    }
+    parser->s++;
+  }
+  else if (c == '-') {
+    // -x is computed as 0 - x, binding less than ^ so -2^2 = -4
+    parser->s++;
+    infix_emit_number(parser, 0);
+    parse_infix_expression(parser, 30);
+    infix_emit_operator(parser, '-');
+  }
+  else if (c == '+') {
+    parser->s++;
+    parse_infix_expression(parser, 30);
+  }
+  else if (isdigit((unsigned char) c) || c == '.') parse_infix_number(parser);
+  else if (isalpha((unsigned char) c) || c == '_') parse_infix_name(parser);
+  else infix_error(parser, "Syntax error in the expression");
+}
+
+/* Parse an expression whose operators bind more than min_power:
+   + - bind 10, * / % 20, ^ 40 (right associative), ! 50 */
+void parse_infix_expression(struct infix_parser *parser, int min_power) {
+  parse_infix_operand(parser);
+
+  while (!parser->error) {
+    char op = infix_peek(parser);
+    int left_power, right_power;
+
+    switch (op) {
+      case '+': case '-': left_power = 10; right_power = 11; break;
+      case '*': case '/': case '%': left_power = 20; right_power = 21; break;
+      case '^': left_power = 40; right_power = 39; break;
+      case '!': left_power = 50; right_power = 0; break;
+      default: return;
+    }
+    if (left_power < min_power) return;
+    parser->s++;
+
+    if (op == '!') {
+      struct instruction instruction = { .kind = '1', .f1 = get_operation_1o("!"), .name = "!" };
+      infix_emit(parser, instruction);
+      continue;
+    }
+    parse_infix_expression(parser, right_power);
+    infix_emit_operator(parser, op);
+  }
+}
+
+/* Compile an expression, NULL on error */
+struct program *compile_infix(char *expression) {
+  struct infix_parser parser;
+  struct program *p = program_new();
+
+  p->strings = arena_alloc(ARENA_WORDS, 2 * strlen(expression) + 2);
+
+  parser.s = expression;
+  parser.program = p;
+  parser.names = p->strings;
+  parser.error = 0;
+
+  parse_infix_expression(&parser, 0);
+  if (!parser.error && infix_peek(&parser) != '\0') infix_error(&parser, "Syntax error in the expression");
+  if (parser.error) {
+    program_free(p);
+    return NULL;
+  }
+
+  optimize_program(p);
+  return p;
+}
+
+/* Tell if a line is an infix expression rather than a command:
+   it isn't a number, a word or a command, and it has operators */
+int is_infix_expression(char *input) {
+  char first[MAX_INPUT_BUFFER];
+  double value;
+
+  if (strpbrk(input, INFIX_OPERATORS) == NULL) return 0;
+
+  sscanf(input, "%99s", first);
+  if (check_input_if_numeric(input, &value)) return 0;
+  if (get_word(first) || get_operation_2o(first) || get_operation_1o(first) ||
+      get_trigonometric_operation_1o(first) || get_operation_0o_with_parameter(first) ||
+      get_operation_0o(first)) return 0;
+
+  return 1;
+}
+
+/* Get the program of an expression from the cache, NULL if it isn't
+   there. The key is the expression as typed, after the arithmetic mode
+   and the decimal places, which the numbers of the expression depend on */
+struct program *find_infix_program(char *expression, char *key, int size) {
+  snprintf(key, size, "%c%c%s", arithmetic_mode, 'a' + decimal_places, expression);
+
+  if (infix_cache == NULL) {
+    infix_cache = arena_alloc(ARENA_WORDS, INFIX_CACHE_LENGTH * sizeof(struct infix_entry));
+    memset(infix_cache, 0, INFIX_CACHE_LENGTH * sizeof(struct infix_entry));
+  }
+
+  infix_clock++;
+  for (int i = 0; i < INFIX_CACHE_LENGTH; i++) {
+    struct infix_entry *entry = &infix_cache[i];
+    if (entry->key != NULL && strcmp(entry->key, key) == 0) {
+      entry->last_used = infix_clock;
+      return entry->program;
+    }
+  }
+  return NULL;
+}
+
+/* Tell if an expression has already been compiled */
+int is_cached_infix_expression(char *expression) {
+  char key[MAX_INPUT_BUFFER + 3];
+  return find_infix_program(expression, key, sizeof(key)) != NULL;
+}
+
+/* Get the program of an expression from the cache, compiling it if needed */
+struct program *get_infix_program(char *expression) {
+  char key[MAX_INPUT_BUFFER + 3];
+  struct program *p = find_infix_program(expression, key, sizeof(key));
+  if (p != NULL) return p;
+
+  p = compile_infix(expression);
+  if (p == NULL) return NULL;
+
+  struct infix_entry *lru = &infix_cache[0];
+  for (int i = 1; i < INFIX_CACHE_LENGTH; i++) {
+    if (infix_cache[i].last_used < lru->last_used) lru = &infix_cache[i];
+  }
+  arena_free(lru->key);
+  program_free(lru->program);
+  lru->key = arena_strdup(ARENA_WORDS, key);
+  lru->program = p;
+  lru->last_used = infix_clock;
+  return p;
+}
+
+/* Evaluate an infix expression: a single entry in the history.
+   An expression always pushes one value: if it doesn't (e.g. a memory
+   is missing) or something fails, the stack is put back as it was */
+void evaluate_infix(char *expression) {
+  struct program *p = get_infix_program(expression);
+  if (p == NULL) return;
+
+  unsigned long mark = journal_cursor;
+  int expected_sp = sp + 1;
+  history_suspended++;
+  run_program(p);
+  history_suspended--;
+
+  if (sp != expected_sp && error_buffer[0] == '\0') {
+    sprintf(error_buffer, "ERROR: Unknown memory in the expression");
+  }
+  if (error_buffer[0] != '\0') {
+    journal_rollback(mark);
+    return;
+  }
+
+  log_operation_result(expression);
+}
+
+/* Free the cache of the expressions */
+void free_infix_cache(void) {
+  if (infix_cache == NULL) return;
+  for (int i = 0; i < INFIX_CACHE_LENGTH; i++) arena_free(infix_cache[i].key);
+  arena_free(infix_cache);
+  infix_cache = NULL;
+}
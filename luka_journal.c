@@ -0,0 +1,352 @@
+// SPDX-License-Identifier: GPL-2.0
+/* luka_journal.c
+ *
+ * A simple RPN calculator for terminal
+ * made with love in Italy.
+ *
+ * Copyright 2025 Davide Mastromatteo
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/* -----------------
+   JOURNAL FUNCTIONS
+   ----------------- */
+
+/* The journal records every mutation of the stack and of the
+   memories as a small delta, so undo and redo only replay what
+   actually changed. It's a ring buffer: when it's full the oldest
+   command is forgotten, so the memory used is bounded by journal_length.
+
+   The stack buffer is never wiped: pop and clear just move sp, and push
+   remembers the value it overwrites. Undoing a clear on a deep stack
+   is then just a matter of restoring sp, without copying anything.
+
+   Entry types:
+   'u' = push      index = slot, old_value = overwritten value, new_value = pushed value
+   'o' = pop       index = sp before the pop
+   's' = swap      index = sp
+   'l' = lroll     index = sp
+   'r' = rroll     index = sp
+   'c' = clear     index = sp before the clear
+   'm' = store     index = memory slot, name != NULL if the memory was created
+   'x' = del       index = memory slot, old_value and name of the deleted memory
+   'w' = write     index = slot, old_value and new_value, sp doesn't move
+   'p' = move sp   old_value and new_value = sp before and after
+   'S' = Σ         statistics = the other state of the statistics registers,
+                   swapped with the current one by undo and redo
+
+   While a word or a line of commands runs, the journal is collapsed:
+   the stack changes aren't recorded one by one, the stack is saved
+   before and only the slots that changed (and sp) are recorded at the
+   end, as 'w' and 'p' entries; stores to a memory already stored in
+   the same step just update their entry. So a loop costs a handful of
+   entries, however many times it goes round. */
+
+struct journal_entry {
+  char type;
+  int step;
+  int index;
+  double old_value;
+  double new_value;
+  char *name;
+  struct statistics *statistics;
+};
+
+/* Get the entry at an absolute position of the journal */
+struct journal_entry *journal_entry_at(unsigned long position) {
+  return &journal[position % journal_length];
+}
+
+/* Start a new undoable step: every entry recorded from now on
+   is undone together with the others of the same step */
+void journal_begin_step(void) {
+  journal_step++;
+}
+
+/* Forget all the entries that could be redone */
+void journal_discard_redo(void) {
+  while (journal_end > journal_cursor) {
+    journal_end--;
+    struct journal_entry *e = journal_entry_at(journal_end);
+
+    // a memory creation that has been undone owns its name
+    if (e->type == 'm') arena_free(e->name);
+    if (e->type == 'S') arena_free(e->statistics);
+  }
+}
+
+/* Forget the oldest step recorded in the journal */
+int journal_evict_oldest_step(void) {
+  int step = journal_entry_at(journal_head)->step;
+
+  while (journal_head < journal_cursor && journal_entry_at(journal_head)->step == step) {
+    struct journal_entry *e = journal_entry_at(journal_head);
+
+    // a deleted memory is owned by the entry that deleted it
+    if (e->type == 'x') arena_free(e->name);
+    if (e->type == 'S') arena_free(e->statistics);
+    journal_head++;
+  }
+  return step;
+}
+
+/* While collapsed, update the entry of a memory already stored in
+   this step instead of adding another one. Returns 1 if it did */
+int journal_merge_store(int index, double new_value) {
+  for (unsigned long p = journal_end; p > journal_head; p--) {
+    struct journal_entry *e = journal_entry_at(p - 1);
+    if (e->step != journal_step || e->type == 'x') return 0;
+    if (e->type == 'm' && e->index == index) {
+      e->new_value = new_value;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/* Forget a mutation that isn't recorded: a deleted memory
+   handed over to the journal has no owner left */
+void journal_drop(char type, char *name) {
+  if (type == 'x') arena_free(name);
+}
+
+/* Record a mutation in the journal */
+void journal_record(char type, int index, double old_value, double new_value, char *name) {
+  if (journal == NULL || journal_step == journal_broken_step) {
+    journal_drop(type, name);
+    return;
+  }
+
+  if (journal_collapsed) {
+    if (type != 'm' && type != 'x' && type != 'w' && type != 'p' && type != 'S') return;
+    if (type == 'm' && name == NULL && journal_cursor == journal_end && journal_merge_store(index, new_value)) return;
+  }
+
+  journal_discard_redo();
+
+  if (journal_end - journal_head == (unsigned long) journal_length) {
+
+    /* The current step alone doesn't fit in the journal,
+       so it can't be undone anymore */
+    if (journal_evict_oldest_step() == journal_step) {
+      journal_broken_step = journal_step;
+      sprintf(error_buffer, "ERROR: The command is too big for the undo journal");
+      journal_drop(type, name);
+      return;
+    }
+  }
+
+  struct journal_entry *e = journal_entry_at(journal_end);
+  e->type = type;
+  e->step = journal_step;
+  e->index = index;
+  e->old_value = old_value;
+  e->new_value = new_value;
+  e->name = name;
+  e->statistics = NULL;
+
+  journal_end++;
+  journal_cursor = journal_end;
+}
+
+/* Record the statistics registers before Σ+, Σ- or Σ clear change
+   them. While collapsed only the first change of a step is recorded */
+void journal_record_statistics(void) {
+  if (journal_collapsed && journal_cursor == journal_end) {
+    for (unsigned long p = journal_end; p > journal_head && journal_entry_at(p - 1)->step == journal_step; p--) {
+      if (journal_entry_at(p - 1)->type == 'S') return;
+    }
+  }
+
+  unsigned long end = journal_end;
+  journal_record('S', 0, 0, 0, NULL);
+  if (journal_end == end) return;
+
+  struct journal_entry *e = journal_entry_at(journal_end - 1);
+  e->statistics = arena_alloc(ARENA_JOURNAL, sizeof(struct statistics));
+  *e->statistics = statistics;
+}
+
+/* Exchange the statistics registers with the state kept by an entry */
+void swap_statistics(struct journal_entry *e) {
+  struct statistics current = statistics;
+  statistics = *e->statistics;
+  *e->statistics = current;
+}
+
+/* Rotate the first n values of the stack to the left */
+void rotate_stack_left(int n) {
+  double first_value = stack[0];
+  for (int i=0; i<(n - 1); i++) stack[i] = stack[i+1];
+  stack[n - 1] = first_value;
+}
+
+/* Rotate the first n values of the stack to the right */
+void rotate_stack_right(int n) {
+  double last_value = stack[n - 1];
+  for (int i=(n - 1); i>0; i--) stack[i] = stack[i-1];
+  stack[0] = last_value;
+}
+
+/* Swap the two values on top of the first n values of the stack */
+void swap_stack(int n) {
+  double x = stack[n - 1];
+  stack[n - 1] = stack[n - 2];
+  stack[n - 2] = x;
+}
+
+/* Insert a memory in a given slot, shifting the following ones */
+void insert_memory(int i, char *name, double value) {
+  for (int k = n_memories; k > i; k--) {
+    memories[k] = memories[k - 1];
+    values[k] = values[k - 1];
+  }
+  memories[i] = name;
+  values[i] = value;
+  n_memories++;
+}
+
+/* Remove the memory in a given slot, shifting the following ones */
+void remove_memory(int i) {
+  for (int k = i + 1; k < n_memories; k++) {
+    memories[k - 1] = memories[k];
+    values[k - 1] = values[k];
+  }
+  n_memories--;
+}
+
+/* Revert the effect of a journal entry */
+void journal_revert(struct journal_entry *e) {
+  switch (e->type) {
+    case 'u': stack[e->index] = e->old_value; sp = e->index; break;
+    case 'o': sp = e->index; break;
+    case 's': swap_stack(e->index); break;
+    case 'l': rotate_stack_right(e->index); break;
+    case 'r': rotate_stack_left(e->index); break;
+    case 'c': sp = e->index; break;
+    case 'm':
+      if (e->name != NULL) n_memories--;
+      else values[e->index] = e->old_value;
+      break;
+    case 'x': insert_memory(e->index, e->name, e->old_value); break;
+    case 'w': stack[e->index] = e->old_value; break;
+    case 'p': sp = (int) e->old_value; break;
+    case 'S': swap_statistics(e); break;
+  }
+}
+
+/* Apply again the effect of a journal entry */
+void journal_apply(struct journal_entry *e) {
+  switch (e->type) {
+    case 'u': stack[e->index] = e->new_value; sp = e->index + 1; break;
+    case 'o': sp = e->index - 1; break;
+    case 's': swap_stack(e->index); break;
+    case 'l': rotate_stack_left(e->index); break;
+    case 'r': rotate_stack_right(e->index); break;
+    case 'c': sp = 0; break;
+    case 'm':
+      if (e->name != NULL) insert_memory(e->index, e->name, e->new_value);
+      else values[e->index] = e->new_value;
+      break;
+    case 'x': remove_memory(e->index); break;
+    case 'w': stack[e->index] = e->new_value; break;
+    case 'p': sp = (int) e->new_value; break;
+    case 'S': swap_statistics(e); break;
+  }
+}
+
+/* Undo the last step recorded in the journal */
+void undo(void) {
+  if (journal_cursor == journal_head) {
+    sprintf(error_buffer, "ERROR: Nothing to undo");
+    return;
+  }
+
+  int step = journal_entry_at(journal_cursor - 1)->step;
+  while (journal_cursor > journal_head && journal_entry_at(journal_cursor - 1)->step == step) {
+    journal_cursor--;
+    journal_revert(journal_entry_at(journal_cursor));
+  }
+}
+
+/* Redo the last step undone */
+void redo(void) {
+  if (journal_cursor == journal_end) {
+    sprintf(error_buffer, "ERROR: Nothing to redo");
+    return;
+  }
+
+  int step = journal_entry_at(journal_cursor)->step;
+  while (journal_cursor < journal_end && journal_entry_at(journal_cursor)->step == step) {
+    journal_apply(journal_entry_at(journal_cursor));
+    journal_cursor++;
+  }
+}
+
+/* Revert everything recorded after a given position
+   of the journal and forget it, so it can't be redone */
+void journal_rollback(unsigned long mark) {
+  if (mark < journal_head) {
+    sprintf(error_buffer, "ERROR: The journal is too small to roll back the whole command");
+    mark = journal_head;
+  }
+
+  while (journal_cursor > mark) {
+    journal_cursor--;
+    journal_revert(journal_entry_at(journal_cursor));
+  }
+  journal_discard_redo();
+}
+
+/* How deep in the stack buffer an undo or a redo may look:
+   clears and pops bring back the values left above sp */
+int journal_stack_depth(void) {
+  int depth = 0;
+  for (unsigned long p = journal_head; p < journal_end; p++) {
+    struct journal_entry *e = journal_entry_at(p);
+    if ((e->type == 'c' || e->type == 'o') && e->index > depth) depth = e->index;
+    if (e->type == 'p' && e->old_value > depth) depth = (int) e->old_value;
+  }
+  return depth;
+}
+
+/* Start collapsing the journal, saving the stack as it is now */
+void journal_collapse_begin(void) {
+  if (journal_collapsed++ > 0) return;
+  journal_saved_sp = sp;
+  journal_saved_length = current_stack_length;
+  memcpy(journal_saved_stack, stack, current_stack_length * sizeof(double));
+}
+
+/* Stop collapsing the journal, recording how the stack changed */
+void journal_collapse_end(void) {
+  if (--journal_collapsed > 0) return;
+
+  int length = journal_saved_length > sp ? journal_saved_length : sp;
+  for (int i = 0; i < length; i++) {
+    double old_value = i < journal_saved_length ? journal_saved_stack[i] : 0;
+    if (memcmp(&old_value, &stack[i], sizeof(double)) != 0) journal_record('w', i, old_value, stack[i], NULL);
+  }
+  if (sp != journal_saved_sp) journal_record('p', 0, journal_saved_sp, sp, NULL);
+}
+
+/* Free the journal and the memory names it owns */
+void free_journal(void) {
+  if (journal == NULL) return;
+  journal_discard_redo();
+  while (journal_head < journal_end) journal_evict_oldest_step();
+  arena_free(journal);
+  journal = NULL;
+}
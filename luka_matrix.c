@@ -0,0 +1,593 @@
+// SPDX-License-Identifier: GPL-2.0
+/* luka_matrix.c
+ *
+ * A simple RPN calculator for terminal
+ * made with love in Italy.
+ *
+ * Copyright 2025 Davide Mastromatteo
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/* ----------------
+   MATRIX FUNCTIONS
+   ---------------- */
+
+/* Matrices are objects holding their values row by row.
+   * multiplies them, y x / solves x · X = y through an LU
+   factorization with partial pivoting, the other operations work
+   element by element (with a number too).
+
+   The multiplication is blocked so that a panel of x stays in the
+   L2 cache while four rows of the result stay in L1, the inner loop
+   works on contiguous rows with vector registers, and above
+   MATRIX_PARALLEL_SIZE the rows of the result are split among the
+   workers. The factorization and the substitutions also work on whole
+   rows, so their inner loops are vectorized the same way. */
+
+typedef double vector_double __attribute__((vector_size(MATRIX_VECTOR_BYTES)));
+
+#define VECTOR_LENGTH ((int) (sizeof(vector_double) / sizeof(double)))
+
+struct matrix {
+  int rows;
+  int cols;
+  double data[];
+};
+
+struct matrix_product {
+  struct matrix *a;
+  struct matrix *b;
+  struct matrix *c;
+};
+
+struct object_class matrix_class;
+
+/* Allocate a matrix, NULL (with an error) if it doesn't fit in memory */
+struct matrix *matrix_new(int rows, int cols) {
+  struct matrix *m = arena_try_calloc(ARENA_ARRAYS, sizeof(struct matrix) + (size_t) rows * cols * sizeof(double));
+  if (m == NULL) {
+    sprintf(error_buffer, "ERROR: The matrix doesn't fit in memory");
+    return NULL;
+  }
+  m->rows = rows;
+  m->cols = cols;
+  return m;
+}
+
+/* Copy a matrix */
+struct matrix *matrix_copy(struct matrix *m) {
+  struct matrix *c = matrix_new(m->rows, m->cols);
+  if (c != NULL) memcpy(c->data, m->data, (size_t) m->rows * m->cols * sizeof(double));
+  return c;
+}
+
+/* Get a row of a matrix */
+double *matrix_row(struct matrix *m, int i) {
+  return m->data + (size_t) i * m->cols;
+}
+
+/* Create the value of a matrix */
+double make_matrix(struct matrix *m) {
+  return make_object(&matrix_class, m);
+}
+
+/* Get the matrix of a value, or NULL if it isn't a matrix */
+struct matrix *get_matrix(double value) {
+  return get_object_data(value, &matrix_class);
+}
+
+/* y[j] += a * x[j] for j < n, a vector at a time */
+void row_axpy(double *restrict y, double a, const double *restrict x, int n) {
+  vector_double va = (vector_double) { 0 } + a;
+  int j = 0;
+  for (; j + VECTOR_LENGTH <= n; j += VECTOR_LENGTH) {
+    vector_double vx, vy;
+    memcpy(&vx, x + j, sizeof(vx));
+    memcpy(&vy, y + j, sizeof(vy));
+    vy += va * vx;
+    memcpy(y + j, &vy, sizeof(vy));
+  }
+  for (; j < n; j++) y[j] += a * x[j];
+}
+
+/* Four rows of C += four rows of A · a block of B:
+   every vector of B is loaded once and used four times */
+void multiply_block_4(double *c[4], double *a[4], struct matrix *b, int k0, int k1, int j0, int j1) {
+  for (int k = k0; k < k1; k++) {
+    const double *restrict bk = matrix_row(b, k);
+    vector_double a0 = (vector_double) { 0 } + a[0][k];
+    vector_double a1 = (vector_double) { 0 } + a[1][k];
+    vector_double a2 = (vector_double) { 0 } + a[2][k];
+    vector_double a3 = (vector_double) { 0 } + a[3][k];
+    int j = j0;
+    for (; j + VECTOR_LENGTH <= j1; j += VECTOR_LENGTH) {
+      vector_double vb, c0, c1, c2, c3;
+      memcpy(&vb, bk + j, sizeof(vb));
+      memcpy(&c0, c[0] + j, sizeof(c0));
+      memcpy(&c1, c[1] + j, sizeof(c1));
+      memcpy(&c2, c[2] + j, sizeof(c2));
+      memcpy(&c3, c[3] + j, sizeof(c3));
+      c0 += a0 * vb;
+      c1 += a1 * vb;
+      c2 += a2 * vb;
+      c3 += a3 * vb;
+      memcpy(c[0] + j, &c0, sizeof(c0));
+      memcpy(c[1] + j, &c1, sizeof(c1));
+      memcpy(c[2] + j, &c2, sizeof(c2));
+      memcpy(c[3] + j, &c3, sizeof(c3));
+    }
+    for (; j < j1; j++) {
+      for (int r = 0; r < 4; r++) c[r][j] += a[r][k] * bk[j];
+    }
+  }
+}
+
+/* Compute the groups of four rows [from, to) of C = A · B */
+void multiply_rows(long from, long to, int worker, void *context) {
+  struct matrix_product *p = context;
+  struct matrix *a = p->a, *b = p->b, *c = p->c;
+  int last = to * 4 < c->rows ? to * 4 : c->rows;
+  (void) worker;
+
+  for (int j0 = 0; j0 < b->cols; j0 += MATRIX_BLOCK_COLS) {
+    int j1 = j0 + MATRIX_BLOCK_COLS < b->cols ? j0 + MATRIX_BLOCK_COLS : b->cols;
+    for (int k0 = 0; k0 < a->cols && !job_cancelled(); k0 += MATRIX_BLOCK_DEPTH) {
+      int k1 = k0 + MATRIX_BLOCK_DEPTH < a->cols ? k0 + MATRIX_BLOCK_DEPTH : a->cols;
+      for (int i = from * 4; i < last; i += 4) {
+        if (i + 4 <= last) {
+          double *rc[4], *ra[4];
+          for (int r = 0; r < 4; r++) {
+            rc[r] = matrix_row(c, i + r);
+            ra[r] = matrix_row(a, i + r);
+          }
+          multiply_block_4(rc, ra, b, k0, k1, j0, j1);
+          continue;
+        }
+        for (int r = i; r < last; r++) {
+          for (int k = k0; k < k1; k++) {
+            row_axpy(matrix_row(c, r) + j0, matrix_row(a, r)[k], matrix_row(b, k) + j0, j1 - j0);
+          }
+        }
+      }
+    }
+  }
+}
+
+/* C = A · B, NULL (with an error) if the sizes don't match */
+struct matrix *matrix_multiply(struct matrix *a, struct matrix *b) {
+  if (a->cols != b->rows) {
+    sprintf(error_buffer, "ERROR: Can't multiply %dx%d by %dx%d", a->rows, a->cols, b->rows, b->cols);
+    return NULL;
+  }
+
+  struct matrix_product p = { a, b, matrix_new(a->rows, b->cols) };
+  if (p.c == NULL) return NULL;
+
+  long groups = (a->rows + 3) / 4;
+  double size = (double) a->rows * a->cols * b->cols;
+  long min_groups = size >= MATRIX_PARALLEL_SIZE ? 1 : groups;
+  parallel_for(groups, min_groups, multiply_rows, &p);
+  return p.c;
+}
+
+/* Transpose a matrix, a tile at a time */
+struct matrix *matrix_transpose(struct matrix *m) {
+  struct matrix *t = matrix_new(m->cols, m->rows);
+  if (t == NULL) return NULL;
+
+  for (int i0 = 0; i0 < m->rows; i0 += MATRIX_TILE) {
+    for (int j0 = 0; j0 < m->cols; j0 += MATRIX_TILE) {
+      for (int i = i0; i < i0 + MATRIX_TILE && i < m->rows; i++) {
+        for (int j = j0; j < j0 + MATRIX_TILE && j < m->cols; j++) {
+          matrix_row(t, j)[i] = matrix_row(m, i)[j];
+        }
+      }
+    }
+  }
+  return t;
+}
+
+/* Factor a square matrix in place as P · A = L · U, with partial
+   pivoting. Returns the sign of the permutation, 0 if A is singular */
+int matrix_lu(struct matrix *a, int *pivot) {
+  int n = a->rows, sign = 1;
+
+  for (int k = 0; k < n; k++) {
+    int p = k;
+    for (int i = k + 1; i < n; i++) {
+      if (fabs(matrix_row(a, i)[k]) > fabs(matrix_row(a, p)[k])) p = i;
+    }
+    pivot[k] = p;
+    if (matrix_row(a, p)[k] == 0) return 0;
+
+    if (p != k) {
+      double *rk = matrix_row(a, k), *rp = matrix_row(a, p);
+      for (int j = 0; j < n; j++) {
+        double t = rk[j];
+        rk[j] = rp[j];
+        rp[j] = t;
+      }
+      sign = -sign;
+    }
+
+    double *rk = matrix_row(a, k);
+    for (int i = k + 1; i < n; i++) {
+      double *ri = matrix_row(a, i);
+      ri[k] /= rk[k];
+      row_axpy(ri + k + 1, -ri[k], rk + k + 1, n - k - 1);
+    }
+    if ((k & 63) == 0 && job_cancelled()) return 0;
+  }
+  return sign;
+}
+
+/* Solve A · X = B, NULL (with an error) if A is singular */
+struct matrix *matrix_solve(struct matrix *a, struct matrix *b) {
+  if (a->rows != a->cols) {
+    sprintf(error_buffer, "ERROR: The matrix isn't square");
+    return NULL;
+  }
+  if (b->rows != a->rows) {
+    sprintf(error_buffer, "ERROR: Can't solve %dx%d with %dx%d", a->rows, a->cols, b->rows, b->cols);
+    return NULL;
+  }
+
+  int n = a->rows, m = b->cols;
+  struct matrix *lu = matrix_copy(a);
+  struct matrix *x = matrix_copy(b);
+  int *pivot = malloc(n * sizeof(int));
+  if (lu == NULL || x == NULL || pivot == NULL) {
+    arena_free(lu);
+    arena_free(x);
+    free(pivot);
+    sprintf(error_buffer, "ERROR: The matrix doesn't fit in memory");
+    return NULL;
+  }
+
+  if (matrix_lu(lu, pivot) == 0) {
+    if (!job_cancelled()) sprintf(error_buffer, "ERROR: The matrix is singular");
+    arena_free(lu);
+    arena_free(x);
+    free(pivot);
+    return NULL;
+  }
+
+  // Apply the row exchanges, then L and U, a row at a time
+  for (int k = 0; k < n; k++) {
+    if (pivot[k] == k) continue;
+    double *rk = matrix_row(x, k), *rp = matrix_row(x, pivot[k]);
+    for (int j = 0; j < m; j++) {
+      double t = rk[j];
+      rk[j] = rp[j];
+      rp[j] = t;
+    }
+  }
+  for (int i = 0; i < n; i++) {
+    for (int k = 0; k < i; k++) row_axpy(matrix_row(x, i), -matrix_row(lu, i)[k], matrix_row(x, k), m);
+  }
+  for (int i = n - 1; i >= 0; i--) {
+    double *xi = matrix_row(x, i);
+    for (int k = i + 1; k < n; k++) row_axpy(xi, -matrix_row(lu, i)[k], matrix_row(x, k), m);
+    double d = matrix_row(lu, i)[i];
+    for (int j = 0; j < m; j++) xi[j] /= d;
+  }
+
+  arena_free(lu);
+  free(pivot);
+  return x;
+}
+
+/* Create an identity matrix */
+struct matrix *matrix_identity(int n) {
+  struct matrix *m = matrix_new(n, n);
+  if (m != NULL) for (int i = 0; i < n; i++) matrix_row(m, i)[i] = 1;
+  return m;
+}
+
+/* Invert a matrix, solving A · X = I */
+struct matrix *matrix_inverse(struct matrix *a) {
+  struct matrix *i = matrix_identity(a->rows);
+  if (i == NULL) return NULL;
+  struct matrix *x = matrix_solve(a, i);
+  arena_free(i);
+  return x;
+}
+
+/* Determinant of a matrix, from its LU factorization */
+int matrix_determinant(struct matrix *a, double *result) {
+  if (a->rows != a->cols) {
+    sprintf(error_buffer, "ERROR: The matrix isn't square");
+    return 0;
+  }
+
+  struct matrix *lu = matrix_copy(a);
+  int *pivot = malloc(a->rows * sizeof(int));
+  if (lu == NULL || pivot == NULL) {
+    arena_free(lu);
+    free(pivot);
+    sprintf(error_buffer, "ERROR: The matrix doesn't fit in memory");
+    return 0;
+  }
+
+  int sign = matrix_lu(lu, pivot);
+  *result = sign;
+  for (int i = 0; sign != 0 && i < a->rows; i++) *result *= matrix_row(lu, i)[i];
+
+  arena_free(lu);
+  free(pivot);
+  return 1;
+}
+
+/* Format a matrix as its size followed by as many
+   of its first values as fit */
+void matrix_format(struct object *o, char *buffer, int size) {
+  struct matrix *m = o->data;
+  char value[26];
+  long n = (long) m->rows * m->cols;
+
+  snprintf(buffer, size, "[%dx%d]", m->rows, m->cols);
+  int used = strlen(buffer);
+  int more = n > SEQUENCE_PREVIEW_LENGTH;
+  for (long j = 0; j < n && j < SEQUENCE_PREVIEW_LENGTH; j++) {
+    int length = snprintf(value, sizeof(value), " %.6lg", m->data[j]);
+    if (used + length + 4 >= size) {
+      more = 1;
+      break;
+    }
+    strcpy(buffer + used, value);
+    used += length;
+  }
+  if (more && used + 4 < size) strcpy(buffer + used, " ...");
+}
+
+/* A matrix isn't a number */
+double matrix_to_double(struct object *o) {
+  (void) o;
+  return NAN;
+}
+
+/* Store a new matrix in r, or report the error set by who computed it */
+int matrix_result(struct matrix *m, double *r) {
+  if (m == NULL) return -1;
+  *r = make_matrix(m);
+  return 1;
+}
+
+/* 1/A is the inverse, the other operations work element by element */
+int matrix_operation_1o(operation_1o f, double x, double *r) {
+  struct matrix *a = get_matrix(x);
+  if (f == reciprocal) return matrix_result(matrix_inverse(a), r);
+
+  struct matrix *m = matrix_new(a->rows, a->cols);
+  if (m == NULL) return -1;
+  for (long i = 0; i < (long) a->rows * a->cols; i++) m->data[i] = f(a->data[i]);
+  return matrix_result(m, r);
+}
+
+/* y x * is the product, y x / solves x · X = y,
+   the other operations work element by element */
+int matrix_operation_2o(operation_2o f, double x, double y, double *r) {
+  struct matrix *mx = get_matrix(x);
+  struct matrix *my = get_matrix(y);
+
+  if (get_sequence(x) != NULL || get_sequence(y) != NULL) {
+    sprintf(error_buffer, "ERROR: A matrix only works with numbers and matrices");
+    return -1;
+  }
+  if (mx == NULL) x = to_number(x);
+  if (my == NULL) y = to_number(y);
+
+  if (mx != NULL && my != NULL && f == multiplication) return matrix_result(matrix_multiply(my, mx), r);
+  if (mx != NULL && f == division) {
+    if (my != NULL) return matrix_result(matrix_solve(mx, my), r);
+    struct matrix *inverse = matrix_inverse(mx);
+    if (inverse == NULL) return -1;
+    for (long i = 0; i < (long) inverse->rows * inverse->cols; i++) inverse->data[i] *= y;
+    return matrix_result(inverse, r);
+  }
+
+  struct matrix *shape = mx != NULL ? mx : my;
+  if (mx != NULL && my != NULL && (mx->rows != my->rows || mx->cols != my->cols)) {
+    sprintf(error_buffer, "ERROR: The matrices have different sizes");
+    return -1;
+  }
+
+  struct matrix *m = matrix_new(shape->rows, shape->cols);
+  if (m == NULL) return -1;
+  for (long i = 0; i < (long) m->rows * m->cols; i++) {
+    m->data[i] = f(mx != NULL ? mx->data[i] : x, my != NULL ? my->data[i] : y);
+  }
+  return matrix_result(m, r);
+}
+
+/* Free a matrix */
+void matrix_release(struct object *o) {
+  arena_free(o->data);
+}
+
+struct object_class matrix_class = {
+  "matrix", 5, 0,
+  matrix_format,
+  matrix_to_double,
+  matrix_operation_1o,
+  matrix_operation_2o,
+  NULL,
+  matrix_release
+};
+
+/* Take the matrix at the top of the stack, without popping it */
+struct matrix *matrix_operand(char *name) {
+  struct matrix *m = sp > 0 ? get_matrix(pick(sp)) : NULL;
+  if (m == NULL) sprintf(error_buffer, "ERROR: %s needs a matrix", name);
+  return m;
+}
+
+/* Replace the matrix at the top of the stack with a result */
+void replace_matrix(struct matrix *m, char *name) {
+  if (m == NULL) return;
+  double x = pop();
+  double r = make_matrix(m);
+  push(r);
+  log_operation_1o(x, name, r);
+}
+
+/* Check that a value can be the size of a matrix */
+int is_matrix_size(double value) {
+  return value >= 1 && value <= MAX_MATRIX_SIZE && value == floor(value);
+}
+
+/* matrix: with rows in y and columns in x, build a matrix
+   from the values below them, or from an array below them */
+void push_matrix(void) {
+  if (sp < 3) return;
+  double cols = to_number(pick(sp));
+  double rows = to_number(pick(sp - 1));
+  if (!is_matrix_size(rows) || !is_matrix_size(cols)) {
+    sprintf(error_buffer, "ERROR: Invalid matrix size");
+    return;
+  }
+
+  long n = (long) rows * (long) cols;
+  struct sequence *s = get_sequence(pick(sp - 2));
+  struct buffer *b = NULL;
+  if (s != NULL) {
+    if ((b = sequence_collect(s)) == NULL) return;
+    if (b->length != n) {
+      sprintf(error_buffer, "ERROR: The array has %ld values, not %ld", b->length, n);
+      buffer_release(b);
+      return;
+    }
+  }
+  else if (n > sp - 2) {
+    sprintf(error_buffer, "ERROR: There aren't %ld values for the matrix", n);
+    return;
+  }
+
+  struct matrix *m = matrix_new(rows, cols);
+  if (m == NULL) {
+    buffer_release(b);
+    return;
+  }
+
+  pop();
+  pop();
+  if (b != NULL) {
+    memcpy(m->data, b->data, n * sizeof(double));
+    buffer_release(b);
+    pop();
+  }
+  else for (long i = n - 1; i >= 0; i--) m->data[i] = to_number(pop());
+  push(make_matrix(m));
+}
+
+/* eye: push the identity matrix of size x */
+void push_identity(void) {
+  if (sp < 1) return;
+  double n = to_number(pick(sp));
+  if (!is_matrix_size(n)) {
+    sprintf(error_buffer, "ERROR: Invalid matrix size");
+    return;
+  }
+  struct matrix *m = matrix_identity(n);
+  if (m == NULL) return;
+  pop();
+  push(make_matrix(m));
+}
+
+/* inv: invert a matrix */
+void invert_matrix(void) {
+  struct matrix *m = matrix_operand("inv");
+  if (m != NULL) replace_matrix(matrix_inverse(m), "inv");
+}
+
+/* trn: transpose a matrix */
+void transpose_matrix(void) {
+  struct matrix *m = matrix_operand("trn");
+  if (m != NULL) replace_matrix(matrix_transpose(m), "trn");
+}
+
+/* det: determinant of a matrix */
+void push_determinant(void) {
+  struct matrix *m = matrix_operand("det");
+  double r;
+  if (m == NULL || !matrix_determinant(m, &r) || job_cancelled()) return;
+  double x = pop();
+  push(r);
+  log_operation_1o(x, "det", r);
+}
+
+/* mload: load a matrix from a text file, a row per line,
+   the values separated by spaces, tabs or commas */
+void load_matrix(char *parameter) {
+  FILE *file = fopen(parameter, "r");
+  if (file == NULL) {
+    snprintf(error_buffer, sizeof(error_buffer), "ERROR: Can't open %s", parameter);
+    return;
+  }
+
+  struct matrix *m = NULL;
+  double *values = NULL;
+  long n = 0, capacity = 0;
+  int rows = 0, cols = 0, ok = 1;
+  char *line = NULL;
+  size_t line_capacity = 0;
+
+  while (ok && getline(&line, &line_capacity, file) != -1) {
+    int count = 0;
+    char *p = line, *end;
+    for (;;) {
+      while (*p == ' ' || *p == '\t' || *p == ',' || *p == '\r' || *p == '\n') p++;
+      if (*p == '\0') break;
+      double value = strtod(p, &end);
+      if (end == p) {
+        snprintf(error_buffer, sizeof(error_buffer), "ERROR: Invalid number in row %d", rows + 1);
+        ok = 0;
+        break;
+      }
+      p = end;
+      if (n >= capacity) {
+        capacity = capacity * 2 + 64;
+        double *grown = realloc(values, capacity * sizeof(double));
+        if (grown == NULL) {
+          sprintf(error_buffer, "ERROR: The matrix doesn't fit in memory");
+          ok = 0;
+          break;
+        }
+        values = grown;
+      }
+      values[n++] = value;
+      count++;
+    }
+    if (!ok || count == 0) continue;
+    if (rows > 0 && count != cols) {
+      snprintf(error_buffer, sizeof(error_buffer), "ERROR: Row %d has %d values, not %d", rows + 1, count, cols);
+      ok = 0;
+    }
+    cols = count;
+    rows++;
+  }
+  fclose(file);
+  free(line);
+
+  if (ok && rows == 0) {
+    sprintf(error_buffer, "ERROR: The file is empty");
+    ok = 0;
+  }
+  if (ok && (m = matrix_new(rows, cols)) != NULL) {
+    memcpy(m->data, values, n * sizeof(double));
+    push(make_matrix(m));
+  }
+  free(values);
+}
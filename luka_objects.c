@@ -0,0 +1,243 @@
+// SPDX-License-Identifier: GPL-2.0
+/* luka_objects.c
+ *
+ * A simple RPN calculator for terminal
+ * made with love in Italy.
+ *
+ * Copyright 2025 Davide Mastromatteo
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/* ----------------
+   OBJECT FUNCTIONS
+   ---------------- */
+
+/* The stack, the memories and the journal only know about doubles.
+   Values that don't fit in a double (big integers, arrays...) are
+   kept in the object table and travel around as a NaN carrying the
+   index of the object: arithmetic never produces that bit pattern,
+   so a plain number can't be mistaken for an object.
+
+   Objects are immutable, so the same handle can sit in the stack and
+   in a memory at the same time. They are freed by a simple mark and
+   sweep collector, which runs between two commands when enough of
+   them have been created. */
+
+#define OBJECT_TAG 0x7FFD4C4B00000000ULL
+#define OBJECT_TAG_MASK 0xFFFFFFFF00000000ULL
+
+struct object;
+void mark_programs(void);
+
+/* Every kind of object has a class telling how to use it.
+   operation_1o and operation_2o return 1 when they computed
+   the result, 0 when the operation should be done on the
+   double value of the object and -1 on error. numeric tells
+   if the object holds a single number */
+struct object_class {
+  char *name;
+  int rank;
+  int numeric;
+  void (*format)(struct object *o, char *buffer, int size);
+  double (*to_double)(struct object *o);
+  int (*operation_1o)(operation_1o f, double x, double *result);
+  int (*operation_2o)(operation_2o f, double x, double y, double *result);
+  void (*mark)(struct object *o);
+  void (*release)(struct object *o);
+};
+
+/* Small objects keep their value inline,
+   the others point to their data */
+struct object {
+  struct object_class *class;
+  char marked;
+  int next_free;
+  union {
+    void *data;
+    double pair[2];
+    struct {
+      long long units;
+      int places;
+    } decimal;
+  };
+};
+
+/* Get the bit pattern of a double */
+unsigned long long double_bits(double value) {
+  unsigned long long bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+/* Tell if a value of the stack is an object */
+int is_object(double value) {
+  return (double_bits(value) & OBJECT_TAG_MASK) == OBJECT_TAG;
+}
+
+/* Get the object referred by a value, or NULL if it's a plain number */
+struct object *get_object(double value) {
+  if (!is_object(value)) return NULL;
+
+  unsigned long long index = double_bits(value) & ~OBJECT_TAG_MASK;
+  if (index >= (unsigned long long) objects_length || objects[index].class == NULL) return NULL;
+  return &objects[index];
+}
+
+/* Get the class of a value, or NULL if it's a plain number */
+struct object_class *get_object_class(double value) {
+  struct object *o = get_object(value);
+  return o == NULL ? NULL : o->class;
+}
+
+/* Is the value a plain number or a number object? */
+int is_number(double value) {
+  struct object *o = get_object(value);
+  return o == NULL || o->class->numeric;
+}
+
+/* Get the data of a value if it's an object of the given class */
+void *get_object_data(double value, struct object_class *class) {
+  struct object *o = get_object(value);
+  return (o != NULL && o->class == class) ? o->data : NULL;
+}
+
+/* Create a new object and return the value referring to it */
+double make_object(struct object_class *class, void *data) {
+  if (objects_free == -1) {
+    int new_objects_length = objects_length + INCREMENT_OBJECTS_STEP;
+
+    objects = arena_realloc(ARENA_OBJECTS, objects, new_objects_length * sizeof(struct object));
+
+    for (int i = new_objects_length - 1; i >= objects_length; i--) {
+      objects[i].class = NULL;
+      objects[i].next_free = objects_free;
+      objects_free = i;
+    }
+    objects_length = new_objects_length;
+  }
+
+  int i = objects_free;
+  objects_free = objects[i].next_free;
+  objects[i].class = class;
+  objects[i].marked = 0;
+  objects[i].data = data;
+  objects_created++;
+
+  unsigned long long bits = OBJECT_TAG | (unsigned long long) i;
+  double value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+/* Get the numeric value of a stack value, converting objects */
+double to_number(double value) {
+  struct object *o = get_object(value);
+  if (o == NULL) return value;
+  return o->class->to_double(o);
+}
+
+/* Format a value for the stack, the history and the memories */
+void format_value(char *buffer, int size, double value) {
+  struct object *o = get_object(value);
+  if (o == NULL) {
+    snprintf(buffer, size, "%lg", value);
+    return;
+  }
+  o->class->format(o, buffer, size);
+}
+
+/* Mark an object (and what it refers to) as reachable */
+void mark_value(double value) {
+  struct object *o = get_object(value);
+  if (o == NULL || o->marked) return;
+  o->marked = 1;
+  if (o->class->mark != NULL) o->class->mark(o);
+}
+
+/* Free the objects that can't be reached anymore from the stack,
+   the memories, the journal or the words. The values left above sp
+   are kept only as long as the journal may bring them back */
+void collect_objects(void) {
+  int depth = journal_stack_depth();
+  if (depth < sp) depth = sp;
+  for (int i = 0; i < depth; i++) mark_value(stack[i]);
+  for (int i = 0; i < n_memories; i++) mark_value(values[i]);
+  for (unsigned long p = journal_head; p < journal_end; p++) {
+    mark_value(journal_entry_at(p)->old_value);
+    mark_value(journal_entry_at(p)->new_value);
+  }
+  mark_programs();
+
+  for (int i = 0; i < objects_length; i++) {
+    if (objects[i].class == NULL) continue;
+    if (objects[i].marked) {
+      objects[i].marked = 0;
+      continue;
+    }
+    if (objects[i].class->release != NULL) objects[i].class->release(&objects[i]);
+    objects[i].class = NULL;
+    objects[i].next_free = objects_free;
+    objects_free = i;
+  }
+  objects_created = 0;
+}
+
+/* Run the collector if enough objects have been created since the last run */
+void maybe_collect_objects(void) {
+  if (objects_created >= COLLECT_OBJECTS_THRESHOLD) collect_objects();
+}
+
+/* Choose the class that will compute an operation:
+   the one with the highest rank among the operands */
+struct object_class *get_operation_class(double x, double y) {
+  struct object_class *cx = get_object_class(x);
+  struct object_class *cy = get_object_class(y);
+  if (cx == NULL) return cy;
+  if (cy == NULL) return cx;
+  return cx->rank >= cy->rank ? cx : cy;
+}
+
+/* Compute a single operand operation on an object.
+   Returns 1 with the result in r, 0 if x isn't an object
+   and -1 if the operation failed */
+int compute_object_operation_1o(operation_1o f, double x, double *r) {
+  struct object *o = get_object(x);
+  if (o == NULL) return 0;
+
+  int handled = o->class->operation_1o != NULL ? o->class->operation_1o(f, x, r) : 0;
+  if (handled == 0) *r = f(o->class->to_double(o));
+  return handled == -1 ? -1 : 1;
+}
+
+/* Compute a two-operands operation when at least one of them is an object.
+   Returns 1 with the result in r, 0 if none of them is an object
+   and -1 if the operation failed */
+int compute_object_operation_2o(operation_2o f, double x, double y, double *r) {
+  struct object_class *class = get_operation_class(x, y);
+  if (class == NULL) return 0;
+
+  int handled = class->operation_2o != NULL ? class->operation_2o(f, x, y, r) : 0;
+  if (handled == 0) *r = f(to_number(x), to_number(y));
+  return handled == -1 ? -1 : 1;
+}
+
+/* Free all the objects */
+void free_objects(void) {
+  for (int i = 0; i < objects_length; i++) {
+    if (objects[i].class != NULL && objects[i].class->release != NULL) objects[i].class->release(&objects[i]);
+  }
+  arena_free(objects);
+  objects = NULL;
+}
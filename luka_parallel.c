@@ -0,0 +1,95 @@
+// SPDX-License-Identifier: GPL-2.0
+/* luka_parallel.c
+ *
+ * A simple RPN calculator for terminal
+ * made with love in Italy.
+ *
+ * Copyright 2025 Davide Mastromatteo
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/* ------------------
+   PARALLEL FUNCTIONS
+   ------------------ */
+
+/* Long loops over big arrays are split among a few threads, one per
+   processor. parallel_for cuts the range [0, length) in contiguous
+   slices, runs the first one on the calling thread and the others on
+   new threads, then waits for all of them. The body gets the number
+   of its worker, so it can keep partial results without locking. */
+
+typedef void (*parallel_body)(long from, long to, int worker, void *context);
+
+struct parallel_task {
+  long from;
+  long to;
+  int worker;
+  parallel_body body;
+  void *context;
+};
+
+/* Get how many workers to use: one per processor */
+int parallel_workers(void) {
+  if (n_workers == 0) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    n_workers = n < 1 ? 1 : n > MAX_WORKERS ? MAX_WORKERS : (int) n;
+  }
+  return n_workers;
+}
+
+/* Thread entry point of a slice */
+void *parallel_thread(void *argument) {
+  struct parallel_task *task = argument;
+  task->body(task->from, task->to, task->worker, task->context);
+  return NULL;
+}
+
+/* Get how many slices parallel_for cuts [0, length) in */
+int parallel_slices(long length, long min_length) {
+  long workers = parallel_workers();
+  if (min_length < 1) min_length = 1;
+  if (length / min_length < workers) workers = length / min_length;
+  return workers < 1 ? 1 : (int) workers;
+}
+
+/* Run body over [0, length), giving every worker at least min_length
+   elements. Returns the number of workers used */
+int parallel_for(long length, long min_length, parallel_body body, void *context) {
+  struct parallel_task tasks[MAX_WORKERS];
+  pthread_t threads[MAX_WORKERS];
+  char started[MAX_WORKERS] = { 0 };
+
+  int workers = parallel_slices(length, min_length);
+
+  for (int w = 0; w < workers; w++) {
+    tasks[w].from = length * w / workers;
+    tasks[w].to = length * (w + 1) / workers;
+    tasks[w].worker = w;
+    tasks[w].body = body;
+    tasks[w].context = context;
+  }
+
+  // If a thread can't be started its slice runs here
+  for (int w = 1; w < workers; w++) {
+    started[w] = pthread_create(&threads[w], NULL, parallel_thread, &tasks[w]) == 0;
+  }
+  parallel_thread(&tasks[0]);
+  for (int w = 1; w < workers; w++) {
+    if (started[w]) pthread_join(threads[w], NULL);
+    else parallel_thread(&tasks[w]);
+  }
+
+  return workers;
+}
@@ -0,0 +1,172 @@
+// SPDX-License-Identifier: GPL-2.0
+/* luka_plot.c
+ *
+ * A simple RPN calculator for terminal
+ * made with love in Italy.
+ *
+ * Copyright 2025 Davide Mastromatteo
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+/* --------------
+   PLOT FUNCTIONS
+   -------------- */
+
+/* tabulate and plot sample a word used as a function of x, like solve
+   and integrate: the word runs compiled on a private stack, and the
+   samples are split among the workers.
+
+   A plot samples the word at center + k * step, for k from
+   -PLOT_SAMPLES / 2 to PLOT_SAMPLES / 2, and is drawn in the lateral
+   panel. ↑ and ↓ zoom in and out by 2 around the center. As the step
+   changes by a power of two, half of the new points are exactly old
+   ones (k * step / 2 is (k / 2) * step for an even k, and zooming out
+   k * 2 step is 2k * step), so their samples are kept and only the
+   points in between, or the newly exposed ends, are computed. */
+
+#define PLOT_SAMPLES (PLOT_WIDTH * 2 * PLOT_OVERSAMPLING)
+
+struct plot {
+  struct program *program;
+  char name[MAX_INPUT_BUFFER];
+  double center;
+  double step;
+  long computed;
+  double samples[PLOT_SAMPLES + 1];
+};
+
+/* Samples output[i] = f(origin + (i - offset) * step) for the indexes
+   in pending, or for all of them when pending is NULL */
+struct sampling {
+  struct program *program;
+  double origin;
+  double step;
+  long offset;
+  long *pending;
+  double *output;
+};
+
+struct plot plot_view;
+
+/* Compute the samples [from, to) of a sampling */
+void sampling_slice(long from, long to, int worker, void *context) {
+  struct sampling *job = context;
+  (void) worker;
+  for (long i = from; i < to; i++) {
+    if (i % 1024 == 0 && job_cancelled()) return;
+    long index = job->pending != NULL ? job->pending[i] : i;
+    job->output[index] = run_scratch_function(job->program, job->origin + (index - job->offset) * job->step);
+  }
+}
+
+/* tabulate name: array of the word sampled at x points from z to y */
+void tabulate(char *parameter) {
+  if (sp < 3) return;
+  struct program *f = get_function(parameter, "tabulate");
+  if (f == NULL) return;
+
+  double a = to_number(pick(sp - 2)), b = to_number(pick(sp - 1)), n = to_number(pick(sp));
+  if (!isfinite(a) || !isfinite(b)) {
+    sprintf(error_buffer, "ERROR: Invalid interval");
+    return;
+  }
+  if (!(n >= 2) || n != floor(n) || n > (double) LONG_MAX / sizeof(double)) {
+    sprintf(error_buffer, "ERROR: The number of points has to be an integer above 1");
+    return;
+  }
+
+  struct buffer *values = buffer_new((long) n);
+  if (values == NULL) {
+    sprintf(error_buffer, "ERROR: The array doesn't fit in memory");
+    return;
+  }
+
+  struct sampling job = { f, a, (b - a) / (n - 1), 0, NULL, values->data };
+  parallel_for(values->length, TABULATE_PARALLEL_SAMPLES, sampling_slice, &job);
+  if (job_cancelled()) {
+    buffer_release(values);
+    return;
+  }
+  // The last point is exactly b, whatever the rounding of the step
+  values->data[values->length - 1] = run_scratch_function(f, b);
+
+  char name[MAX_INPUT_BUFFER];
+  snprintf(name, sizeof(name), "tabulate %s", parameter);
+  pop();
+  pop();
+  pop();
+  push(make_array(values));
+  log_operation_result(name);
+}
+
+/* Compute the pending samples of the plot */
+void plot_sample(struct plot *p, long *pending, long n) {
+  struct sampling job = { p->program, p->center, p->step, PLOT_SAMPLES / 2, pending, p->samples };
+  parallel_for(n, PLOT_PARALLEL_SAMPLES, sampling_slice, &job);
+  p->computed = n;
+}
+
+/* plot name: plot the word from y to x in the lateral panel,
+   leaving the stack as it is */
+void plot_word(char *parameter) {
+  if (sp < 2) return;
+  struct program *f = get_function(parameter, "plot");
+  if (f == NULL) return;
+
+  double a = to_number(pick(sp - 1)), b = to_number(pick(sp));
+  if (!isfinite(a) || !isfinite(b) || a == b || !isfinite(b - a)) {
+    sprintf(error_buffer, "ERROR: Invalid interval");
+    return;
+  }
+
+  struct plot p = { .program = f, .center = a / 2 + b / 2, .step = fabs(b - a) / PLOT_SAMPLES };
+  long pending[PLOT_SAMPLES + 1];
+  for (long i = 0; i <= PLOT_SAMPLES; i++) pending[i] = i;
+  snprintf(p.name, sizeof(p.name), "%s", parameter);
+  plot_sample(&p, pending, PLOT_SAMPLES + 1);
+  if (job_cancelled()) return;
+
+  plot_view = p;
+  history_mode = 'p';
+}
+
+/* Zoom the plot around its center: in for a factor of 1/2, out for 2.
+   The points in common with the current plot keep their samples */
+void plot_zoom(double factor) {
+  struct plot *p = &plot_view;
+  double step = p->step * factor;
+  if (p->program == NULL || !(step > 0) || !isfinite(step * PLOT_SAMPLES) || p->center + step == p->center) return;
+
+  double old[PLOT_SAMPLES + 1];
+  long pending[PLOT_SAMPLES + 1], n = 0;
+  memcpy(old, p->samples, sizeof(old));
+  for (long i = 0; i <= PLOT_SAMPLES; i++) {
+    long k = i - PLOT_SAMPLES / 2;
+    long j = factor < 1 ? (k % 2 == 0 ? k / 2 : LONG_MAX) : 2 * k;
+    if (j >= -PLOT_SAMPLES / 2 && j <= PLOT_SAMPLES / 2) p->samples[i] = old[j + PLOT_SAMPLES / 2];
+    else pending[n++] = i;
+  }
+
+  double old_step = p->step;
+  p->step = step;
+  plot_sample(p, pending, n);
+
+  // A cancelled zoom leaves the plot as it was
+  if (job_cancelled()) {
+    p->step = old_step;
+    memcpy(p->samples, old, sizeof(old));
+  }
+}
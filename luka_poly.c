@@ -0,0 +1,571 @@
+// SPDX-License-Identifier: GPL-2.0
+/* luka_poly.c
+ *
+ * A simple RPN calculator for terminal
+ * made with love in Italy.
+ *
+ * Copyright 2025 Davide Mastromatteo
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/* --------------------
+   POLYNOMIAL FUNCTIONS
+   -------------------- */
+
+/* Polynomials are objects holding their coefficients, from the
+   constant one up. + - * / mod and ^ (to a whole power) work between
+   polynomials, a number being a polynomial of degree 0: / is the
+   quotient and mod the remainder. The products go through convolve,
+   so long ones use the FFT; long divisions multiply by the inverse
+   of the reversed divisor, computed as a power series by Newton's
+   iteration, so they use the FFT too.
+
+   peval evaluates a polynomial by Horner's rule. On an array the
+   values are taken a vector at a time, with several vectors in flight
+   to hide the latency of the multiplications, and the array is split
+   among the workers. proots finds all the roots at once by the
+   Aberth-Ehrlich iteration. */
+
+struct polynomial {
+  long degree;
+  double c[];
+};
+
+struct polynomial_job {
+  struct polynomial *p;
+  vector_double *c;
+  double *x;
+  double *y;
+};
+
+struct object_class polynomial_class;
+
+/* Allocate a polynomial, NULL (with an error) if it doesn't fit in memory */
+struct polynomial *polynomial_new(long degree) {
+  struct polynomial *p = NULL;
+  if (degree >= 0 && degree <= MAX_POLYNOMIAL_DEGREE) {
+    p = arena_try_calloc(ARENA_ARRAYS, sizeof(struct polynomial) + (degree + 1) * sizeof(double));
+  }
+  if (p == NULL) {
+    sprintf(error_buffer, "ERROR: The polynomial doesn't fit in memory");
+    return NULL;
+  }
+  p->degree = degree;
+  return p;
+}
+
+/* Create the value of a polynomial, dropping its leading zeros */
+double make_polynomial(struct polynomial *p) {
+  while (p->degree > 0 && p->c[p->degree] == 0) p->degree--;
+  return make_object(&polynomial_class, p);
+}
+
+/* Get the polynomial of a value, or NULL if it isn't a polynomial */
+struct polynomial *get_polynomial(double value) {
+  return get_object_data(value, &polynomial_class);
+}
+
+/* Format a polynomial as its degree followed by as many
+   of its coefficients as fit, from the highest one */
+void polynomial_format(struct object *o, char *buffer, int size) {
+  struct polynomial *p = o->data;
+  char value[32];
+
+  snprintf(buffer, size, "[x^%ld]", p->degree);
+  int used = strlen(buffer);
+  int more = p->degree + 1 > SEQUENCE_PREVIEW_LENGTH;
+  for (long j = p->degree; j >= 0 && j > p->degree - SEQUENCE_PREVIEW_LENGTH; j--) {
+    int length = snprintf(value, sizeof(value), " %.6lg", p->c[j]);
+    if (used + length + 4 >= size) {
+      more = 1;
+      break;
+    }
+    strcpy(buffer + used, value);
+    used += length;
+  }
+  if (more && used + 4 < size) strcpy(buffer + used, " ...");
+}
+
+/* A polynomial isn't a number */
+double polynomial_to_double(struct object *o) {
+  (void) o;
+  return NAN;
+}
+
+/* Only the arithmetic works on polynomials */
+int polynomial_operation_1o(operation_1o f, double x, double *r) {
+  (void) f;
+  (void) x;
+  (void) r;
+  sprintf(error_buffer, "ERROR: A polynomial only works with + - * / mod ^");
+  return -1;
+}
+
+/* Get an operand as a polynomial, a copy if it's a number */
+struct polynomial *polynomial_operand(double value, int *copied) {
+  struct polynomial *p = get_polynomial(value);
+  *copied = p == NULL;
+  if (p != NULL) return p;
+  if ((p = polynomial_new(0)) != NULL) p->c[0] = to_number(value);
+  return p;
+}
+
+/* Sum (sign 1) or difference (sign -1) of two polynomials */
+struct polynomial *polynomial_add(struct polynomial *a, struct polynomial *b, double sign) {
+  struct polynomial *p = polynomial_new(a->degree > b->degree ? a->degree : b->degree);
+  if (p == NULL) return NULL;
+  for (long i = 0; i <= a->degree; i++) p->c[i] = a->c[i];
+  for (long i = 0; i <= b->degree; i++) p->c[i] += sign * b->c[i];
+  return p;
+}
+
+/* Product of two polynomials */
+struct polynomial *polynomial_multiply(struct polynomial *a, struct polynomial *b) {
+  struct polynomial *p = polynomial_new(a->degree + b->degree);
+  if (p == NULL) return NULL;
+  convolve(a->c, a->degree + 1, b->c, b->degree + 1, p->c);
+  return p;
+}
+
+/* Inverse of the power series f, up to x^(k-1), by Newton's iteration
+   g = g (2 - f g), doubling the number of right terms each time */
+double *series_inverse(double *f, long nf, long k) {
+  double *g = calloc(k, sizeof(double));
+  double *e = malloc(2 * k * sizeof(double));
+  double *t = malloc(2 * k * sizeof(double));
+  if (g == NULL || e == NULL || t == NULL) {
+    printf("ERROR: You run out of memory. Exiting.");
+    exit(1);
+  }
+
+  g[0] = 1 / f[0];
+  for (long length = 1; length < k;) {
+    long next = 2 * length < k ? 2 * length : k;
+    long n = nf < next ? nf : next;
+    convolve(f, n, g, length, e);
+    for (long i = 0; i < next; i++) e[i] = (i < n + length - 1 ? -e[i] : 0) + (i == 0 ? 2 : 0);
+    convolve(g, length, e, next, t);
+    memcpy(g, t, next * sizeof(double));
+    length = next;
+  }
+
+  free(e);
+  free(t);
+  return g;
+}
+
+/* Quotient and remainder of the division of a by b */
+int polynomial_divide(struct polynomial *a, struct polynomial *b, struct polynomial **q, struct polynomial **r) {
+  long n = a->degree, m = b->degree;
+  if (b->c[m] == 0) {
+    sprintf(error_buffer, "ERROR: Division by the zero polynomial");
+    return 0;
+  }
+
+  *q = polynomial_new(n >= m ? n - m : 0);
+  *r = polynomial_new(m > 0 ? m - 1 : 0);
+  if (*q == NULL || *r == NULL) {
+    arena_free(*q);
+    arena_free(*r);
+    return 0;
+  }
+  if (m > n) {
+    arena_free(*r);
+    *r = polynomial_add(a, *q, 0);
+    return *r != NULL;
+  }
+
+  long k = n - m + 1;
+  if ((double) k * (m + 1) <= DIRECT_CONVOLUTION_SIZE) {
+    // Schoolbook long division
+    double *rest = malloc((n + 1) * sizeof(double));
+    if (rest == NULL) {
+      printf("ERROR: You run out of memory. Exiting.");
+      exit(1);
+    }
+    memcpy(rest, a->c, (n + 1) * sizeof(double));
+    for (long i = k - 1; i >= 0; i--) {
+      double t = (*q)->c[i] = rest[m + i] / b->c[m];
+      for (long j = 0; j <= m; j++) rest[i + j] -= t * b->c[j];
+    }
+    for (long i = 0; i < m; i++) (*r)->c[i] = rest[i];
+    free(rest);
+    return 1;
+  }
+
+  // The reversed quotient is the reversed a divided by the reversed b, as series
+  double *ra = malloc(k * sizeof(double));
+  double *rb = malloc((m + 1) * sizeof(double));
+  double *rq = malloc((2 * k - 1) * sizeof(double));
+  double *bq = malloc((n + 1) * sizeof(double));
+  if (ra == NULL || rb == NULL || rq == NULL || bq == NULL) {
+    printf("ERROR: You run out of memory. Exiting.");
+    exit(1);
+  }
+  for (long i = 0; i < k; i++) ra[i] = a->c[n - i];
+  for (long i = 0; i <= m; i++) rb[i] = b->c[m - i];
+  double *inverse = series_inverse(rb, m + 1, k);
+  convolve(ra, k, inverse, k, rq);
+  for (long i = 0; i < k; i++) (*q)->c[i] = rq[k - 1 - i];
+
+  convolve(b->c, m + 1, (*q)->c, k, bq);
+  for (long i = 0; i < m; i++) (*r)->c[i] = a->c[i] - bq[i];
+
+  free(ra);
+  free(rb);
+  free(rq);
+  free(bq);
+  free(inverse);
+  return 1;
+}
+
+/* Raise a polynomial to a whole power, squaring */
+struct polynomial *polynomial_power(struct polynomial *a, double e) {
+  if (e < 0 || e != floor(e) || a->degree * e > MAX_POLYNOMIAL_DEGREE) {
+    sprintf(error_buffer, "ERROR: A polynomial can only be raised to a whole power");
+    return NULL;
+  }
+
+  struct polynomial *r = polynomial_new(0);
+  struct polynomial *base = r != NULL ? polynomial_add(a, r, 0) : NULL;
+  if (base == NULL) {
+    arena_free(r);
+    arena_free(base);
+    return NULL;
+  }
+  r->c[0] = 1;
+
+  for (unsigned long n = (unsigned long) e; n > 0 && r != NULL && base != NULL; n >>= 1) {
+    struct polynomial *t;
+    if (n & 1) {
+      t = polynomial_multiply(r, base);
+      arena_free(r);
+      r = t;
+    }
+    if (n > 1) {
+      t = polynomial_multiply(base, base);
+      arena_free(base);
+      base = t;
+    }
+  }
+  arena_free(base);
+  return r;
+}
+
+/* Arithmetic between polynomials and numbers */
+int polynomial_operation_2o(operation_2o f, double x, double y, double *r) {
+  if (get_sequence(x) != NULL || get_sequence(y) != NULL || get_matrix(x) != NULL || get_matrix(y) != NULL) {
+    sprintf(error_buffer, "ERROR: A polynomial only works with numbers and polynomials");
+    return -1;
+  }
+
+  if (f == to_power) {
+    struct polynomial *p = get_polynomial(x) == NULL ? polynomial_power(get_polynomial(y), to_number(x)) : NULL;
+    if (p == NULL) {
+      if (error_buffer[0] == '\0') sprintf(error_buffer, "ERROR: A polynomial can only be raised to a whole power");
+      return -1;
+    }
+    *r = make_polynomial(p);
+    return 1;
+  }
+
+  int copied_x, copied_y;
+  struct polynomial *px = polynomial_operand(x, &copied_x);
+  struct polynomial *py = polynomial_operand(y, &copied_y);
+  struct polynomial *p = NULL, *q = NULL, *rest = NULL;
+
+  if (px == NULL || py == NULL);
+  else if (f == sum) p = polynomial_add(py, px, 1);
+  else if (f == subtraction) p = polynomial_add(py, px, -1);
+  else if (f == multiplication) p = polynomial_multiply(py, px);
+  else if ((f == division || f == modulo) && polynomial_divide(py, px, &q, &rest)) {
+    p = f == division ? q : rest;
+    arena_free(f == division ? rest : q);
+  }
+  else if (f != division && f != modulo) sprintf(error_buffer, "ERROR: A polynomial only works with + - * / mod ^");
+
+  if (copied_x) arena_free(px);
+  if (copied_y) arena_free(py);
+  if (p == NULL) return -1;
+  *r = make_polynomial(p);
+  return 1;
+}
+
+/* Free a polynomial */
+void polynomial_release(struct object *o) {
+  arena_free(o->data);
+}
+
+struct object_class polynomial_class = {
+  "polynomial", 6, 0,
+  polynomial_format,
+  polynomial_to_double,
+  polynomial_operation_1o,
+  polynomial_operation_2o,
+  NULL,
+  polynomial_release
+};
+
+/* poly: build a polynomial from the x values below x, or from an
+   array, the coefficient of the highest power first */
+void push_polynomial(void) {
+  if (sp < 1) return;
+  struct sequence *s = get_sequence(pick(sp));
+  struct polynomial *p;
+
+  if (s != NULL) {
+    struct buffer *b = sequence_collect(s);
+    if (b == NULL) return;
+    if (b->length == 0 || (p = polynomial_new(b->length - 1)) == NULL) {
+      if (b->length == 0) sprintf(error_buffer, "ERROR: A polynomial needs a coefficient");
+      buffer_release(b);
+      return;
+    }
+    for (long i = 0; i <= p->degree; i++) p->c[i] = b->data[p->degree - i];
+    buffer_release(b);
+    double x = pop();
+    double r = make_polynomial(p);
+    push(r);
+    log_operation_1o(x, "poly", r);
+    return;
+  }
+
+  double n = to_number(pick(sp));
+  if (n < 1 || n != floor(n) || n > sp - 1) {
+    sprintf(error_buffer, "ERROR: There aren't %lg coefficients", n);
+    return;
+  }
+  if ((p = polynomial_new((long) n - 1)) == NULL) return;
+  pop();
+  for (long i = 0; i <= p->degree; i++) p->c[i] = to_number(pop());
+  push(make_polynomial(p));
+}
+
+/* Value of a polynomial at x by Horner's rule */
+double horner(struct polynomial *p, double x) {
+  double r = p->c[p->degree];
+  for (long k = p->degree - 1; k >= 0; k--) r = r * x + p->c[k];
+  return r;
+}
+
+/* Evaluate a polynomial on a slice of values, four vectors at a
+   time: the four Horner's chains are independent, so the processor
+   overlaps their multiplications. The coefficients are read already
+   broadcast to whole vectors */
+void polynomial_slice(long from, long to, int worker, void *context) {
+  struct polynomial_job *job = context;
+  const vector_double *restrict c = job->c;
+  long degree = job->p->degree;
+  (void) worker;
+
+  long i = from;
+  for (; i + 4 * VECTOR_LENGTH <= to; i += 4 * VECTOR_LENGTH) {
+    vector_double x0, x1, x2, x3;
+    memcpy(&x0, job->x + i, sizeof(x0));
+    memcpy(&x1, job->x + i + VECTOR_LENGTH, sizeof(x1));
+    memcpy(&x2, job->x + i + 2 * VECTOR_LENGTH, sizeof(x2));
+    memcpy(&x3, job->x + i + 3 * VECTOR_LENGTH, sizeof(x3));
+    vector_double r0 = c[degree];
+    vector_double r1 = r0, r2 = r0, r3 = r0;
+    for (long k = degree - 1; k >= 0; k--) {
+      r0 = r0 * x0 + c[k];
+      r1 = r1 * x1 + c[k];
+      r2 = r2 * x2 + c[k];
+      r3 = r3 * x3 + c[k];
+    }
+    memcpy(job->y + i, &r0, sizeof(r0));
+    memcpy(job->y + i + VECTOR_LENGTH, &r1, sizeof(r1));
+    memcpy(job->y + i + 2 * VECTOR_LENGTH, &r2, sizeof(r2));
+    memcpy(job->y + i + 3 * VECTOR_LENGTH, &r3, sizeof(r3));
+  }
+  for (; i < to; i++) job->y[i] = horner(job->p, job->x[i]);
+}
+
+/* peval: value of the polynomial in y at x, or at every value of an array */
+void evaluate_polynomial(void) {
+  if (sp < 2) return;
+  struct polynomial *p = get_polynomial(pick(sp - 1));
+  if (p == NULL) {
+    sprintf(error_buffer, "ERROR: peval needs a polynomial in y");
+    return;
+  }
+
+  double r;
+  struct sequence *s = get_sequence(pick(sp));
+  if (s != NULL) {
+    struct buffer *b = sequence_collect(s);
+    if (b == NULL) return;
+    struct buffer *values = buffer_new(b->length);
+    if (values == NULL) {
+      sprintf(error_buffer, "ERROR: The array doesn't fit in memory");
+      buffer_release(b);
+      return;
+    }
+    vector_double *c = aligned_alloc(sizeof(vector_double), (p->degree + 1) * sizeof(vector_double));
+    if (c == NULL) {
+      printf("ERROR: You run out of memory. Exiting.");
+      exit(1);
+    }
+    for (long k = 0; k <= p->degree; k++) c[k] = (vector_double) { 0 } + p->c[k];
+    struct polynomial_job job = { p, c, b->data, values->data };
+    parallel_for(b->length, PARALLEL_MIN_LENGTH, polynomial_slice, &job);
+    buffer_release(b);
+    free(c);
+    r = make_array(values);
+  }
+  else if (is_number(pick(sp))) {
+    r = horner(p, to_number(pick(sp)));
+  }
+  else {
+    sprintf(error_buffer, "ERROR: peval works on numbers and arrays");
+    return;
+  }
+
+  double x = pop();
+  double y = pop();
+  push(r);
+  log_operation_2o(y, x, "peval", r);
+}
+
+/* Sort complex values by real part, then by imaginary part */
+int compare_roots(const void *a, const void *b) {
+  double complex x = *(const double complex *) a, y = *(const double complex *) b;
+  if (creal(x) != creal(y)) return creal(x) < creal(y) ? -1 : 1;
+  return (cimag(x) > cimag(y)) - (cimag(x) < cimag(y));
+}
+
+/* Newton's correction p(z)/p'(z) by Horner's rule. Out of the unit
+   circle the reversed polynomial is evaluated at 1/z, so the powers
+   of z never overflow. Returns 1 when p(z) is as small as the rounding
+   errors of its evaluation, i.e. z is a root as far as doubles tell */
+int newton_correction(struct polynomial *p, double complex z, double complex *w) {
+  long n = p->degree;
+  int reversed = cabs(z) > 1;
+  double complex y = reversed ? 1 / z : z;
+  double complex v = 0, d = 0;
+  double bound = 0, ay = cabs(y);
+
+  for (long i = 0; i <= n; i++) {
+    double c = p->c[reversed ? i : n - i];
+    d = complex_multiply(d, y) + v;
+    v = complex_multiply(v, y) + c;
+    bound = bound * ay + fabs(c);
+  }
+  // p(z) = z^n rp(1/z), so p/p' = z / (n - rp'(y) y / rp(y))
+  if (v == 0) *w = 0;
+  else *w = reversed ? z / (n - complex_multiply(d, y) / v) : v / d;
+  return cabs(v) <= 4 * DBL_EPSILON * bound;
+}
+
+/* Find all the roots of a polynomial by the Aberth-Ehrlich iteration,
+   starting from a circle as large as Fujiwara's bound. A root is left
+   alone when its step is lost in its last digits, or when p(z) is lost
+   in the rounding errors and the small steps stop shrinking */
+double complex *polynomial_roots(struct polynomial *p) {
+  long n = p->degree;
+  double complex *z = complex_new(n);
+  double *last = malloc(n * sizeof(double));
+  if (last == NULL) {
+    printf("ERROR: You run out of memory. Exiting.");
+    exit(1);
+  }
+
+  double radius = 0;
+  for (long i = 0; i < n; i++) {
+    double bound = pow(fabs(p->c[i] / p->c[n]) / (i == 0 ? 2 : 1), 1.0 / (n - i));
+    if (bound > radius) radius = bound;
+  }
+  radius = radius > 0 ? radius : 1;
+  for (long k = 0; k < n; k++) z[k] = radius * cexp(I * (2 * M_PI * k / n + 0.4));
+
+  for (long k = 0; k < n; k++) last[k] = INFINITY;
+  long left = n;
+  for (int iteration = 0; iteration < PROOTS_MAX_ITERATIONS && left > 0 && !job_cancelled(); iteration++) {
+    for (long k = 0; k < n; k++) {
+      double complex w, s = 0;
+      if (last[k] == 0) continue;
+      int root = newton_correction(p, z[k], &w);
+
+      // 1 / d as conj(d) / |d|^2, avoiding the library's careful division
+      for (long j = 0; j < n; j++) {
+        double complex d = z[k] - z[j];
+        if (j != k) s += conj(d) / (creal(d) * creal(d) + cimag(d) * cimag(d));
+      }
+      double complex step = w / (1 - complex_multiply(w, s));
+      z[k] -= step;
+      if (cabs(step) <= DBL_EPSILON * cabs(z[k]) || (root && cabs(step) > last[k] / 2 && cabs(step) < sqrt(DBL_EPSILON) * cabs(z[k]))) {
+        last[k] = 0;
+        left--;
+      }
+      else last[k] = cabs(step);
+    }
+  }
+
+  free(last);
+  for (long k = 0; k < n; k++) {
+    double scale = DBL_EPSILON * cabs(z[k]);
+    if (fabs(creal(z[k])) < scale) z[k] = CMPLX(0, cimag(z[k]));
+    if (fabs(cimag(z[k])) < scale) z[k] = CMPLX(creal(z[k]), 0);
+  }
+  qsort(z, n, sizeof(double complex), compare_roots);
+  return z;
+}
+
+/* proots: roots of a polynomial, an array when they are all real,
+   otherwise a n x 2 matrix of real and imaginary parts */
+void compute_polynomial_roots(void) {
+  if (sp < 1) return;
+  struct polynomial *p = get_polynomial(pick(sp));
+  if (p == NULL) {
+    sprintf(error_buffer, "ERROR: proots needs a polynomial");
+    return;
+  }
+  if (p->degree == 0) {
+    sprintf(error_buffer, "ERROR: A constant has no roots");
+    return;
+  }
+
+  long n = p->degree;
+  double complex *z = polynomial_roots(p);
+  if (job_cancelled()) {
+    free(z);
+    return;
+  }
+
+  // A root of multiplicity m is only found to about DBL_EPSILON^(1/m)
+  int real = 1;
+  for (long k = 0; k < n; k++) {
+    if (fabs(cimag(z[k])) > cbrt(DBL_EPSILON) * fmax(1, cabs(z[k]))) real = 0;
+  }
+
+  double r;
+  if (real) {
+    struct buffer *b = buffer_new(n);
+    if (b == NULL) {
+      sprintf(error_buffer, "ERROR: The array doesn't fit in memory");
+      free(z);
+      return;
+    }
+    for (long k = 0; k < n; k++) b->data[k] = creal(z[k]);
+    r = make_array(b);
+  }
+  else r = make_complex_matrix(z, n);
+  free(z);
+  if (!is_object(r)) return;
+
+  double x = pop();
+  push(r);
+  log_operation_1o(x, "proots", r);
+}
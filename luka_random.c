@@ -0,0 +1,418 @@
+// SPDX-License-Identifier: GPL-2.0
+/* luka_random.c
+ *
+ * A simple RPN calculator for terminal
+ * made with love in Italy.
+ *
+ * Copyright 2025 Davide Mastromatteo
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/* ----------------
+   RANDOM FUNCTIONS
+   ---------------- */
+
+/* Random numbers come from xoshiro256++, seeded through splitmix64
+   from the system entropy (or by seed). Its jump functions move a
+   state 2^128 or 2^192 values ahead, giving streams that never
+   overlap: the work of runif, rnorm and mc is cut in blocks, and block
+   b uses the stream b jumps ahead of the generator, so the values
+   don't depend on how many workers computed them. Inside a block
+   RANDOM_LANES streams, a long jump apart, run side by side in vector
+   registers. Afterwards the generator long jumps past all of them.
+
+   Normal values come from the ziggurat method (Doornik's variant):
+   most of the times a single draw and a comparison with a table are
+   enough, without any logarithm or sine. They are drawn one at a time,
+   as the number of draws a value takes varies. */
+
+#define RANDOM_LANES (RANDOM_VECTOR_BYTES / 8)
+#define ZIGGURAT_LAYERS 128
+#define ZIGGURAT_R 3.442619855899
+#define ZIGGURAT_V 9.91256303526217e-3
+
+typedef unsigned long long vector_u64 __attribute__((vector_size(RANDOM_VECTOR_BYTES)));
+typedef double vector_random __attribute__((vector_size(RANDOM_VECTOR_BYTES)));
+
+const unsigned long long random_jump_polynomial[4] = {
+  0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL, 0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL
+};
+
+const unsigned long long random_long_jump_polynomial[4] = {
+  0x76e15d3efefdcbbfULL, 0xc5004e441c522fb3ULL, 0x77710069854ee241ULL, 0x39109bb02acbe635ULL
+};
+
+double ziggurat_x[ZIGGURAT_LAYERS + 1];
+double ziggurat_ratio[ZIGGURAT_LAYERS];
+
+struct estimate {
+  long n;
+  double mean;
+  double m2;
+};
+
+struct random_job {
+  unsigned long long base[4];
+  double *output;
+  long length;
+  char kind;
+  struct program *program;
+  struct estimate partial[MAX_WORKERS];
+  int failed;
+};
+
+/* Rotate the bits of x to the left */
+unsigned long long rotate_left(unsigned long long x, int k) {
+  return (x << k) | (x >> (64 - k));
+}
+
+/* Next 64 random bits of a xoshiro256++ state */
+unsigned long long random_next(unsigned long long *s) {
+  unsigned long long r = rotate_left(s[0] + s[3], 23) + s[0];
+  unsigned long long t = s[1] << 17;
+  s[2] ^= s[0];
+  s[3] ^= s[1];
+  s[1] ^= s[2];
+  s[0] ^= s[3];
+  s[2] ^= t;
+  s[3] = rotate_left(s[3], 45);
+  return r;
+}
+
+/* Random value in [0, 1) */
+double random_uniform(unsigned long long *s) {
+  return (random_next(s) >> 11) * 0x1.0p-53;
+}
+
+/* Compute the edges of the layers of the ziggurat */
+void ziggurat_init(void) {
+  double f = exp(-0.5 * ZIGGURAT_R * ZIGGURAT_R);
+  ziggurat_x[0] = ZIGGURAT_V / f;
+  ziggurat_x[1] = ZIGGURAT_R;
+  ziggurat_x[ZIGGURAT_LAYERS] = 0;
+  for (int i = 2; i < ZIGGURAT_LAYERS; i++) {
+    ziggurat_x[i] = sqrt(-2 * log(ZIGGURAT_V / ziggurat_x[i - 1] + f));
+    f = exp(-0.5 * ziggurat_x[i] * ziggurat_x[i]);
+  }
+  for (int i = 0; i < ZIGGURAT_LAYERS; i++) ziggurat_ratio[i] = ziggurat_x[i + 1] / ziggurat_x[i];
+}
+
+/* Random value from the standard normal distribution. The high bits
+   of a draw give a value in (-1, 1), the low ones the layer */
+double random_normal(unsigned long long *s) {
+  for (;;) {
+    unsigned long long r = random_next(s);
+    double u = 2 * ((r >> 11) * 0x1.0p-53) - 1;
+    int i = r & (ZIGGURAT_LAYERS - 1);
+
+    if (fabs(u) < ziggurat_ratio[i]) return u * ziggurat_x[i];
+
+    if (i == 0) {
+      // The tail beyond R
+      double x, y;
+      do {
+        x = log(1 - random_uniform(s)) / ZIGGURAT_R;
+        y = log(1 - random_uniform(s));
+      } while (-2 * y < x * x);
+      return u < 0 ? x - ZIGGURAT_R : ZIGGURAT_R - x;
+    }
+
+    double x = u * ziggurat_x[i];
+    double f0 = exp(-0.5 * (ziggurat_x[i] * ziggurat_x[i] - x * x));
+    double f1 = exp(-0.5 * (ziggurat_x[i + 1] * ziggurat_x[i + 1] - x * x));
+    if (f1 + random_uniform(s) * (f0 - f1) < 1) return x;
+  }
+}
+
+/* Move a state ahead, by 2^128 or 2^192 values */
+void random_jump(unsigned long long *s, const unsigned long long *polynomial) {
+  unsigned long long t[4] = { 0 };
+  for (int i = 0; i < 4; i++) {
+    for (int b = 0; b < 64; b++) {
+      if (polynomial[i] & (1ULL << b)) {
+        for (int j = 0; j < 4; j++) t[j] ^= s[j];
+      }
+      random_next(s);
+    }
+  }
+  memcpy(s, t, sizeof(t));
+}
+
+/* Fill the state of the generator from a seed */
+void seed_random(unsigned long long seed) {
+  if (ziggurat_x[1] == 0) ziggurat_init();
+  for (int i = 0; i < 4; i++) {
+    unsigned long long z = (seed += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    random_state[i] = z ^ (z >> 31);
+  }
+}
+
+/* Seed the generator from the system entropy, or from
+   the time and the process when there isn't any */
+void randomize(void) {
+  unsigned long long seed = 0;
+  FILE *file = fopen("/dev/urandom", "rb");
+  if (file == NULL || fread(&seed, sizeof(seed), 1, file) != 1) {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    seed = (unsigned long long) now.tv_sec * 1000000000ULL + now.tv_nsec;
+    seed ^= (unsigned long long) getpid() << 32;
+  }
+  if (file != NULL) fclose(file);
+  seed_random(seed);
+}
+
+/* seed n: restart the generator from n, or from
+   the system entropy when n is missing */
+void set_seed(char *parameter) {
+  unrepeatable = 1;
+  if (parameter[0] == '\0') {
+    randomize();
+    return;
+  }
+  char *end;
+  unsigned long long seed = strtoull(parameter, &end, 10);
+  if (*end != '\0') {
+    sprintf(error_buffer, "ERROR: The seed has to be an integer");
+    return;
+  }
+  seed_random(seed);
+}
+
+/* Push a random value from the standard normal distribution */
+void push_normal(void) {
+  unrepeatable = 1;
+  push(random_normal(random_state));
+}
+
+/* Next values of the lanes, in [0, 1). The 52 bits become the
+   mantissa of a value in [1, 2), so the vector is never split */
+void random_next_lanes(vector_u64 *s, double *x) {
+  vector_u64 sum = s[0] + s[3];
+  vector_u64 r = ((sum << 23) | (sum >> 41)) + s[0];
+  vector_u64 t = s[1] << 17;
+  s[2] ^= s[0];
+  s[3] ^= s[1];
+  s[1] ^= s[2];
+  s[0] ^= s[3];
+  s[2] ^= t;
+  s[3] = (s[3] << 45) | (s[3] >> 19);
+
+  vector_u64 bits = (r >> 12) | 0x3ff0000000000000ULL;
+  vector_random v;
+  memcpy(&v, &bits, sizeof(v));
+  v -= 1;
+  memcpy(x, &v, sizeof(v));
+}
+
+/* Fill a block with the values of the stream in state */
+void random_block(unsigned long long *state, double *x, long n, char kind) {
+  vector_u64 s[4];
+  unsigned long long lane[4];
+  double v[RANDOM_LANES];
+
+  memcpy(lane, state, sizeof(lane));
+  if (kind == 'n') {
+    for (long i = 0; i < n; i++) x[i] = random_normal(lane);
+    return;
+  }
+
+  for (int j = 0; j < RANDOM_LANES; j++) {
+    if (j > 0) random_jump(lane, random_long_jump_polynomial);
+    for (int i = 0; i < 4; i++) s[i][j] = lane[i];
+  }
+
+  long i = 0;
+  for (; i + RANDOM_LANES <= n; i += RANDOM_LANES) random_next_lanes(s, x + i);
+  if (i < n) {
+    random_next_lanes(s, v);
+    memcpy(x + i, v, (n - i) * sizeof(double));
+  }
+}
+
+/* Fill the blocks [from, to) of an array */
+void random_fill_slice(long from, long to, int worker, void *context) {
+  struct random_job *job = context;
+  unsigned long long state[4];
+
+  memcpy(state, job->base, sizeof(state));
+  for (long b = 0; b < from; b++) random_jump(state, random_jump_polynomial);
+
+  for (long b = from; b < to && !job_cancelled(); b++) {
+    long start = b * RANDOM_BLOCK_LENGTH;
+    long n = job->length - start < RANDOM_BLOCK_LENGTH ? job->length - start : RANDOM_BLOCK_LENGTH;
+    random_block(state, job->output + start, n, job->kind);
+    random_jump(state, random_jump_polynomial);
+    if (worker == 0) set_job_progress((double) (b - from) / (to - from));
+  }
+}
+
+/* Start a job on blocks of the generator */
+struct random_job *random_job_new(void) {
+  struct random_job *job = calloc(1, sizeof(struct random_job));
+  if (job == NULL) {
+    printf("ERROR: You run out of memory. Exiting.");
+    exit(1);
+  }
+  memcpy(job->base, random_state, sizeof(job->base));
+  return job;
+}
+
+/* Move the generator past the streams used by a job */
+void random_job_free(struct random_job *job) {
+  for (int j = 0; j < RANDOM_LANES; j++) random_jump(random_state, random_long_jump_polynomial);
+  free(job);
+}
+
+/* Get the count at the top of the stack, -1 (with an error) if it isn't one */
+long random_count(void) {
+  double n = sp > 0 ? to_number(pick(sp)) : -1;
+  if (!(n >= 0) || n != floor(n) || n > (double) LONG_MAX / sizeof(double)) {
+    sprintf(error_buffer, "ERROR: The count has to be a positive integer");
+    return -1;
+  }
+  return (long) n;
+}
+
+/* Replace the count at the top of the stack with an array of random values */
+void push_random_array(char kind, char *name) {
+  unrepeatable = 1;
+  long n = random_count();
+  if (n < 0) return;
+
+  struct buffer *b = buffer_new(n);
+  if (b == NULL) {
+    sprintf(error_buffer, "ERROR: The array doesn't fit in memory");
+    return;
+  }
+
+  struct random_job *job = random_job_new();
+  job->output = b->data;
+  job->length = n;
+  job->kind = kind;
+  parallel_for((n + RANDOM_BLOCK_LENGTH - 1) / RANDOM_BLOCK_LENGTH, 1, random_fill_slice, job);
+  random_job_free(job);
+
+  if (job_cancelled()) {
+    buffer_release(b);
+    return;
+  }
+  double r = make_array(b);
+  double x = pop();
+  push(r);
+  log_operation_1o(x, name, r);
+}
+
+/* runif: array of x random values in [0, 1) */
+void push_uniform_array(void) {
+  push_random_array('u', "runif");
+}
+
+/* rnorm: array of x random values from the standard normal distribution */
+void push_normal_array(void) {
+  push_random_array('n', "rnorm");
+}
+
+/* Run the draws of the blocks [from, to) of a Monte Carlo estimate,
+   keeping their count, mean and squared deviations */
+void monte_carlo_slice(long from, long to, int worker, void *context) {
+  struct random_job *job = context;
+  struct estimate *r = &job->partial[worker];
+  unsigned long long state[4];
+  double s[SCRATCH_STACK_LENGTH];
+
+  memcpy(state, job->base, sizeof(state));
+  for (long b = 0; b < from; b++) random_jump(state, random_jump_polynomial);
+
+  unsigned long long block_state[4];
+  scratch_random = block_state;
+  for (long b = from; b < to && !job_cancelled() && !job->failed; b++) {
+    long start = b * RANDOM_BLOCK_LENGTH;
+    long n = job->length - start < RANDOM_BLOCK_LENGTH ? job->length - start : RANDOM_BLOCK_LENGTH;
+    memcpy(block_state, state, sizeof(block_state));
+
+    for (long i = 0; i < n; i++) {
+      int left = run_scratch_program(job->program, s, 0);
+      if (left < 1) {
+        job->failed = 1;
+        break;
+      }
+      double x = s[left - 1], delta = x - r->mean;
+      r->n++;
+      r->mean += delta / r->n;
+      r->m2 += delta * (x - r->mean);
+    }
+    random_jump(state, random_jump_polynomial);
+    if (worker == 0) set_job_progress((double) (b - from) / (to - from));
+  }
+  scratch_random = NULL;
+}
+
+/* mc word: mean of x draws of a word, run on a private stack with
+   rnd and rndn. Leaves the standard error in y and the mean in x */
+void monte_carlo(char *parameter) {
+  unrepeatable = 1;
+  long n = random_count();
+  if (n < 0) return;
+  if (n < 2) {
+    sprintf(error_buffer, "ERROR: mc needs at least 2 draws");
+    return;
+  }
+
+  struct word *w = get_word(parameter);
+  if (w == NULL) {
+    snprintf(error_buffer, sizeof(error_buffer), "ERROR: Unknown word %s", parameter);
+    return;
+  }
+  if (!is_scratch_program(w->program)) {
+    snprintf(error_buffer, sizeof(error_buffer), "ERROR: %s can't be used by mc", parameter);
+    return;
+  }
+
+  struct random_job *job = random_job_new();
+  job->length = n;
+  job->program = w->program;
+  int workers = parallel_for((n + RANDOM_BLOCK_LENGTH - 1) / RANDOM_BLOCK_LENGTH, 1, monte_carlo_slice, job);
+
+  // Chan's formula puts the partial results together
+  struct estimate total = job->partial[0];
+  for (int i = 1; i < workers; i++) {
+    struct estimate *p = &job->partial[i];
+    if (p->n == 0) continue;
+    double delta = p->mean - total.mean;
+    long count = total.n + p->n;
+    total.m2 += p->m2 + delta * delta * total.n * p->n / count;
+    total.mean += delta * p->n / count;
+    total.n = count;
+  }
+  int failed = job->failed;
+  random_job_free(job);
+
+  if (failed) {
+    snprintf(error_buffer, sizeof(error_buffer), "ERROR: %s has to leave a value", parameter);
+    return;
+  }
+  if (job_cancelled()) return;
+
+  double standard_error = sqrt(total.m2 / (total.n - 1) / total.n);
+  char name[MAX_INPUT_BUFFER];
+  snprintf(name, sizeof(name), "mc %s", parameter);
+  double x = pop();
+  push(standard_error);
+  push(total.mean);
+  log_operation_1o(x, name, total.mean);
+}
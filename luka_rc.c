@@ -0,0 +1,584 @@
+// SPDX-License-Identifier: GPL-2.0
+/* luka_rc.c
+ *
+ * A simple RPN calculator for terminal
+ * made with love in Italy.
+ *
+ * Copyright 2025 Davide Mastromatteo
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+int compute(char*);
+void lowercase_input(char*);
+
+/* -----------------
+   RC FILE FUNCTIONS
+   ----------------- */
+
+/* ~/.lukarc holds commands run at start, one per line, before the
+   options of the command line are applied: modes, memories, values
+   for the stack and word definitions. Empty lines and lines starting
+   with # are skipped.
+
+   The file isn't run at every start: what it leaves behind (modes,
+   memories, stack and words, already compiled) is saved in a snapshot,
+   ~/.lukarc.cache, that the next start maps with mmap and copies in
+   place. The snapshot is good while the rc file keeps its size and
+   mtime, or its hash when only the mtime changed.
+
+   Function addresses change at every run, so the instructions refer
+   to a table of the functions they call, each one looked up by name
+   once when the snapshot is loaded. The snapshot is only good for the
+   build that wrote it. An rc file failing, leaving objects around, or
+   running commands whose result changes at every run (random numbers,
+   seed, shared registers) isn't saved, and simply runs at every start:
+   those commands set unrepeatable when they run. */
+
+#define RC_MAGIC "LUKARC1"
+#define RC_HASH_SEED 0xcbf29ce484222325ULL
+
+struct rc_header {
+  char magic[8];
+  unsigned long long build;
+  unsigned long long rc_hash;
+  long long rc_size;
+  long long rc_mtime_sec;
+  long long rc_mtime_nsec;
+  long long size;
+  struct statistics statistics;
+  double tolerance;
+  int n_workers;
+  int n_memories;
+  int n_stack;
+  int n_functions;
+  int n_programs;
+  int n_instructions;
+  int n_words;
+  int decimal_places;
+  char mode, numeric_format, arithmetic_mode, history_mode;
+};
+
+/* After the header come the memories, the stack, the functions, the
+   programs, their instructions, the words and the strings of the
+   programs. A string is program << 32 | offset in its strings, -1 for
+   NULL. The payload of an instruction is its number, the index of
+   its function or the index of the program it calls */
+struct rc_memory {
+  char name[MAX_MEMORY_NAME_LENGTH + 1];
+  double value;
+};
+
+struct rc_function {
+  long long name;
+  int kind;
+};
+
+struct rc_program {
+  int length;
+  int strings_size;
+};
+
+struct rc_instruction {
+  unsigned long long payload;
+  long long name;
+  long long parameter;
+  int kind;
+  int target;
+};
+
+struct rc_word {
+  long long name;
+  int program;
+};
+
+/* FNV-1a hash of n bytes, going on from h */
+unsigned long long rc_hash(const unsigned char *s, size_t n, unsigned long long h) {
+  for (size_t i = 0; i < n; i++) h = (h ^ s[i]) * 0x100000001b3ULL;
+  return h;
+}
+
+/* Identity of the build: a snapshot is only good for its own binary */
+unsigned long long rc_build(void) {
+  const char *build = APP_VERSION " " __DATE__ " " __TIME__;
+  size_t sizes[] = { sizeof(struct rc_header), sizeof(struct instruction), sizeof(struct rc_instruction) };
+
+  unsigned long long h = rc_hash((const unsigned char *) build, strlen(build), RC_HASH_SEED);
+  return rc_hash((const unsigned char *) sizes, sizeof(sizes), h);
+}
+
+/* Look up the function of an instruction by its name, as compile_token does */
+struct instruction rc_function(int kind, char *name) {
+  struct instruction c = { .kind = kind, .name = name };
+  switch (kind) {
+    case '0': c.f0 = get_operation_0o(name); break;
+    case '1': c.f1 = get_operation_1o(name); break;
+    case 't': c.f1 = get_trigonometric_operation_1o(name); break;
+    case '2': c.f2 = get_operation_2o(name); break;
+    case 'p': c.fp = get_operation_0o_with_parameter(name); break;
+  }
+  return c;
+}
+
+/* Hash the content of a file */
+unsigned long long rc_hash_file(int fd, size_t size) {
+  if (size == 0) return RC_HASH_SEED;
+  void *text = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (text == MAP_FAILED) return 0;
+  unsigned long long h = rc_hash(text, size, RC_HASH_SEED);
+  munmap(text, size);
+  return h;
+}
+
+/* Encode a pointer in the strings of the programs, -2 if it's elsewhere */
+long long rc_encode_string(struct program **list, int n, char *s) {
+  if (s == NULL) return -1;
+  for (int i = 0; i < n; i++) {
+    char *base = list[i]->strings;
+    if (base != NULL && s >= base && s < base + arena_size(base)) return ((long long) i << 32) | (s - base);
+  }
+  return -2;
+}
+
+/* Tell if a program is one of the infix cache, not of a word */
+int rc_is_infix_program(struct program *p) {
+  for (int i = 0; infix_cache != NULL && i < INFIX_CACHE_LENGTH; i++) {
+    if (infix_cache[i].program == p) return 1;
+  }
+  return 0;
+}
+
+/* Save the state left by the rc file, returns 0 if it can't be saved */
+int rc_save(char *path, struct stat *st, unsigned long long hash) {
+  int n_programs = 0, n_instructions = 0, n_functions = 0;
+  long long strings_size = 0;
+
+  // Objects only live in this process
+  for (int i = 1; i <= sp; i++) if (is_object(pick(i))) return 0;
+  for (int i = 0; i < n_memories; i++) if (is_object(values[i])) return 0;
+
+  for (struct program *p = programs; p != NULL; p = p->next) {
+    if (rc_is_infix_program(p)) continue;
+    for (int i = 0; i < p->length; i++) if (p->code[i].kind == 'n' && is_object(p->code[i].value)) return 0;
+    n_programs++;
+    n_instructions += p->length;
+    strings_size += arena_size(p->strings);
+  }
+
+  struct program **list = malloc((n_programs + 1) * sizeof(struct program *));
+  struct instruction *functions = malloc((n_instructions + 1) * sizeof(struct instruction));
+  if (list == NULL || functions == NULL) {
+    printf("ERROR: You run out of memory. Exiting.");
+    exit(1);
+  }
+  n_programs = 0;
+  for (struct program *p = programs; p != NULL; p = p->next) {
+    if (rc_is_infix_program(p)) continue;
+    list[n_programs++] = p;
+
+    // One entry for every function, the first instruction using it gives its name
+    for (int i = 0; i < p->length; i++) {
+      struct instruction *c = &p->code[i];
+      if (c->kind == 'n' || c->kind == 'w') continue;
+      int f = 0;
+      while (f < n_functions && (functions[f].kind != c->kind || memcmp(&functions[f].f0, &c->f0, sizeof(c->f0)) != 0)) f++;
+      if (f == n_functions) functions[n_functions++] = *c;
+    }
+  }
+
+  long long size = sizeof(struct rc_header) + n_memories * sizeof(struct rc_memory) + sp * sizeof(double) +
+    n_functions * sizeof(struct rc_function) + n_programs * sizeof(struct rc_program) +
+    n_instructions * sizeof(struct rc_instruction) + n_words * sizeof(struct rc_word) + strings_size;
+  char *snapshot = calloc(1, size);
+  if (snapshot == NULL) {
+    printf("ERROR: You run out of memory. Exiting.");
+    exit(1);
+  }
+
+  struct rc_header *h = (struct rc_header *) snapshot;
+  memcpy(h->magic, RC_MAGIC, sizeof(h->magic));
+  h->build = rc_build();
+  h->rc_hash = hash;
+  h->rc_size = st->st_size;
+  h->rc_mtime_sec = st->st_mtim.tv_sec;
+  h->rc_mtime_nsec = st->st_mtim.tv_nsec;
+  h->size = size;
+  h->statistics = statistics;
+  h->tolerance = tolerance;
+  h->n_workers = n_workers;
+  h->n_memories = n_memories;
+  h->n_stack = sp;
+  h->n_functions = n_functions;
+  h->n_programs = n_programs;
+  h->n_instructions = n_instructions;
+  h->n_words = n_words;
+  h->mode = mode;
+  h->numeric_format = numeric_format;
+  h->arithmetic_mode = arithmetic_mode;
+  h->decimal_places = decimal_places;
+  h->history_mode = history_mode;
+
+  struct rc_memory *m = (struct rc_memory *) (h + 1);
+  for (int i = 0; i < n_memories; i++) {
+    strcpy(m[i].name, memories[i]);
+    m[i].value = values[i];
+  }
+
+  double *s = (double *) (m + n_memories);
+  for (int i = 0; i < sp; i++) s[i] = stack[i];
+
+  struct rc_function *rf = (struct rc_function *) (s + sp);
+  struct rc_program *rp = (struct rc_program *) (rf + n_functions);
+  struct rc_instruction *ri = (struct rc_instruction *) (rp + n_programs);
+  struct rc_word *rw = (struct rc_word *) (ri + n_instructions);
+  char *strings = (char *) (rw + n_words);
+  int ok = 1;
+
+  // A function must be found again by its name
+  for (int f = 0; f < n_functions; f++) {
+    rf[f].kind = functions[f].kind;
+    rf[f].name = rc_encode_string(list, n_programs, functions[f].name);
+    struct instruction c = rf[f].name < 0 ? (struct instruction) { 0 } : rc_function(rf[f].kind, functions[f].name);
+    if (rf[f].name < 0 || memcmp(&c.f0, &functions[f].f0, sizeof(c.f0)) != 0) ok = 0;
+  }
+
+  for (int j = 0; j < n_programs; j++) {
+    struct program *p = list[j];
+    rp[j].length = p->length;
+    rp[j].strings_size = arena_size(p->strings);
+    memcpy(strings, p->strings, rp[j].strings_size);
+    strings += rp[j].strings_size;
+
+    for (int i = 0; i < p->length; i++, ri++) {
+      struct instruction *c = &p->code[i];
+      ri->kind = c->kind;
+      ri->target = c->target;
+      ri->name = rc_encode_string(list, n_programs, c->name);
+      ri->parameter = rc_encode_string(list, n_programs, c->parameter);
+      if (ri->name == -2 || ri->parameter == -2) ok = 0;
+
+      ri->payload = 0;
+      if (c->kind == 'n') memcpy(&ri->payload, &c->value, sizeof(c->value));
+      else if (c->kind == 'w') {
+        while (ri->payload < (unsigned long long) n_programs && list[ri->payload] != c->callee) ri->payload++;
+        if (ri->payload == (unsigned long long) n_programs) ok = 0;
+      }
+      else {
+        while (functions[ri->payload].kind != c->kind || memcmp(&functions[ri->payload].f0, &c->f0, sizeof(c->f0)) != 0) ri->payload++;
+      }
+    }
+  }
+
+  for (int i = 0; i < n_words; i++) {
+    rw[i].name = rc_encode_string(list, n_programs, words[i].name);
+    rw[i].program = 0;
+    while (rw[i].program < n_programs && list[rw[i].program] != words[i].program) rw[i].program++;
+    if (rw[i].name < 0 || rw[i].program == n_programs) ok = 0;
+  }
+
+  // Write a new file and put it in place, so no one ever maps half a snapshot
+  if (ok) {
+    char temporary[PATH_MAX + 16];
+    snprintf(temporary, sizeof(temporary), "%s.%d", path, (int) getpid());
+    int fd = open(temporary, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    ok = fd != -1 && write(fd, snapshot, size) == size;
+    if (fd != -1) close(fd);
+    if (ok) ok = rename(temporary, path) == 0;
+    if (!ok) unlink(temporary);
+  }
+
+  free(snapshot);
+  free(functions);
+  free(list);
+  return ok;
+}
+
+/* Tell if an instruction kind calls a function of the table */
+int rc_function_kind(int kind) {
+  return kind == '0' || kind == '1' || kind == 't' || kind == '2' || kind == 'p';
+}
+
+/* Tell if a string of the snapshot points inside its program */
+int rc_valid_string(long long s, struct rc_program *rp, int n_programs, int nullable) {
+  if (s == -1) return nullable;
+  long long j = s >> 32, offset = s & 0xffffffffLL;
+  return s >= 0 && j < n_programs && offset < rp[j].strings_size;
+}
+
+/* Check a snapshot from top to bottom before using any of it */
+int rc_valid_snapshot(struct rc_header *h) {
+  if (h->n_memories < 0 || h->n_memories > MAX_MEMORIES_LENGTH ||
+      h->n_stack < 0 || h->n_stack > MAX_STACK_LENGTH || h->n_functions < 0 ||
+      h->n_programs < 0 || h->n_instructions < 0 || h->n_words < 0 || h->n_words > h->n_programs ||
+      h->decimal_places < 0 || h->decimal_places > MAX_DECIMAL_PLACES) return 0;
+
+  long long size = sizeof(struct rc_header) + h->n_memories * sizeof(struct rc_memory) + h->n_stack * sizeof(double) +
+    (long long) h->n_functions * sizeof(struct rc_function) + (long long) h->n_programs * sizeof(struct rc_program) +
+    (long long) h->n_instructions * sizeof(struct rc_instruction) + h->n_words * sizeof(struct rc_word);
+  if (size > h->size) return 0;
+
+  struct rc_memory *m = (struct rc_memory *) (h + 1);
+  for (int i = 0; i < h->n_memories; i++) if (m[i].name[MAX_MEMORY_NAME_LENGTH] != '\0') return 0;
+
+  struct rc_function *rf = (struct rc_function *) ((double *) (m + h->n_memories) + h->n_stack);
+  struct rc_program *rp = (struct rc_program *) (rf + h->n_functions);
+  struct rc_instruction *ri = (struct rc_instruction *) (rp + h->n_programs);
+  struct rc_word *rw = (struct rc_word *) (ri + h->n_instructions);
+  char *strings = (char *) (rw + h->n_words);
+  long long instructions = 0;
+
+  for (int j = 0; j < h->n_programs; j++) {
+    if (rp[j].length < 0 || rp[j].strings_size < 0) return 0;
+    instructions += rp[j].length;
+    size += rp[j].strings_size;
+    if (size > h->size) return 0;
+    // every string must end inside its program
+    if (rp[j].strings_size > 0 && strings[rp[j].strings_size - 1] != '\0') return 0;
+    strings += rp[j].strings_size;
+  }
+  if (size != h->size || instructions != h->n_instructions) return 0;
+
+  for (int f = 0; f < h->n_functions; f++) {
+    if (!rc_function_kind(rf[f].kind) || !rc_valid_string(rf[f].name, rp, h->n_programs, 0)) return 0;
+  }
+
+  for (int j = 0; j < h->n_programs; j++) {
+    for (int i = 0; i < rp[j].length; i++, ri++) {
+      if (rc_function_kind(ri->kind)) {
+        if (ri->payload >= (unsigned long long) h->n_functions || rf[ri->payload].kind != ri->kind) return 0;
+      }
+      else if (ri->kind == 'w') {
+        if (ri->payload >= (unsigned long long) h->n_programs) return 0;
+      }
+      else if (is_jump(ri->kind)) {
+        if (ri->target < 1 || ri->target > rp[j].length) return 0;
+      }
+      else if (ri->kind == 'i') {
+        if (ri->target < 0 || ri->target > 1) return 0;
+      }
+      else if (ri->kind != 'n') return 0;
+      if (!rc_valid_string(ri->name, rp, h->n_programs, 1) ||
+          !rc_valid_string(ri->parameter, rp, h->n_programs, 1)) return 0;
+    }
+  }
+
+  for (int i = 0; i < h->n_words; i++) {
+    if (rw[i].program < 0 || rw[i].program >= h->n_programs || !rc_valid_string(rw[i].name, rp, h->n_programs, 0)) return 0;
+  }
+  return 1;
+}
+
+/* Decode a string of the snapshot */
+char *rc_decode_string(long long s, struct program **list) {
+  return s == -1 ? NULL : list[s >> 32]->strings + (s & 0xffffffffLL);
+}
+
+/* Copy a valid snapshot in place, returns 0 if a function is gone */
+int rc_apply(struct rc_header *h) {
+  struct rc_memory *m = (struct rc_memory *) (h + 1);
+  double *s = (double *) (m + h->n_memories);
+  struct rc_function *rf = (struct rc_function *) (s + h->n_stack);
+  struct rc_program *rp = (struct rc_program *) (rf + h->n_functions);
+  struct rc_instruction *ri = (struct rc_instruction *) (rp + h->n_programs);
+  struct rc_word *rw = (struct rc_word *) (ri + h->n_instructions);
+  char *strings = (char *) (rw + h->n_words);
+  struct program **list = malloc((h->n_programs + 1) * sizeof(struct program *));
+  char **bases = malloc((h->n_programs + 1) * sizeof(char *));
+  struct instruction *functions = malloc((h->n_functions + 1) * sizeof(struct instruction));
+  if (list == NULL || bases == NULL || functions == NULL) {
+    printf("ERROR: You run out of memory. Exiting.");
+    exit(1);
+  }
+
+  // Look up the functions first, so nothing changes if one is missing
+  bases[0] = strings;
+  for (int j = 1; j < h->n_programs; j++) bases[j] = bases[j - 1] + rp[j - 1].strings_size;
+  for (int f = 0; f < h->n_functions; f++) {
+    functions[f] = rc_function(rf[f].kind, bases[rf[f].name >> 32] + (rf[f].name & 0xffffffffLL));
+    if (functions[f].f0 == NULL) break;
+  }
+  free(bases);
+  for (int f = 0; f < h->n_functions; f++) {
+    if (functions[f].f0 == NULL) {
+      free(functions);
+      free(list);
+      return 0;
+    }
+  }
+
+  mode = h->mode;
+  numeric_format = h->numeric_format;
+  arithmetic_mode = h->arithmetic_mode;
+  decimal_places = h->decimal_places;
+  history_mode = h->history_mode;
+  tolerance = h->tolerance;
+  n_workers = h->n_workers;
+  statistics = h->statistics;
+
+  while (current_memories_length < h->n_memories) {
+    current_memories_length = current_memories_length * 2 > MAX_MEMORIES_LENGTH ? MAX_MEMORIES_LENGTH : current_memories_length * 2;
+    memories = arena_realloc(ARENA_MEMORIES, memories, current_memories_length * sizeof(char*));
+    values = arena_realloc(ARENA_MEMORIES, values, current_memories_length * sizeof(double));
+  }
+  for (int i = 0; i < h->n_memories; i++) {
+    memories[n_memories] = arena_strdup(ARENA_MEMORIES, m[i].name);
+    values[n_memories++] = m[i].value;
+  }
+
+  for (int i = 0; i < h->n_stack; i++) push(s[i]);
+
+  // The program list ends up in the same order it was saved
+  for (int j = h->n_programs - 1; j >= 0; j--) list[j] = program_new();
+  for (int j = 0; j < h->n_programs; j++) {
+    struct program *p = list[j];
+    if (rp[j].strings_size > 0) p->strings = memcpy(arena_alloc(ARENA_WORDS, rp[j].strings_size), strings, rp[j].strings_size);
+    strings += rp[j].strings_size;
+    p->code = arena_alloc(ARENA_WORDS, rp[j].length * sizeof(struct instruction));
+    p->length = p->capacity = rp[j].length;
+  }
+
+  for (int j = 0; j < h->n_programs; j++) {
+    for (int i = 0; i < rp[j].length; i++, ri++) {
+      struct instruction *c = &list[j]->code[i];
+      if (ri->kind == 'n') memcpy(&c->value, &ri->payload, sizeof(c->value));
+      else if (ri->kind == 'w') c->callee = list[ri->payload];
+      else if (rc_function_kind(ri->kind)) *c = functions[ri->payload];
+      c->kind = ri->kind;
+      c->target = ri->target;
+      c->name = rc_decode_string(ri->name, list);
+      c->parameter = rc_decode_string(ri->parameter, list);
+    }
+  }
+
+  current_words_length = (h->n_words / INCREMENT_WORDS_STEP + 1) * INCREMENT_WORDS_STEP;
+  words = arena_realloc(ARENA_WORDS, words, current_words_length * sizeof(struct word));
+  for (int i = 0; i < h->n_words; i++) {
+    words[i].name = rc_decode_string(rw[i].name, list);
+    words[i].program = list[rw[i].program];
+  }
+  n_words = h->n_words;
+  free(functions);
+  free(list);
+  return 1;
+}
+
+/* Restore the snapshot of the rc file if it's still good for it.
+   Returns 0 if the rc file has to be run */
+int rc_restore(char *path, int rc, struct stat *st) {
+  int fd = open(path, O_RDWR);
+  if (fd == -1) return 0;
+
+  struct stat cache;
+  void *map = MAP_FAILED;
+  if (fstat(fd, &cache) == 0 && cache.st_size >= (off_t) sizeof(struct rc_header)) {
+    map = mmap(NULL, cache.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+  }
+  if (map == MAP_FAILED) {
+    close(fd);
+    return 0;
+  }
+
+  struct rc_header *h = map;
+  int good = memcmp(h->magic, RC_MAGIC, sizeof(h->magic)) == 0 && h->build == rc_build() &&
+    h->size == cache.st_size && h->rc_size == st->st_size;
+
+  // A new mtime with the same content (a touch, a copy) only updates the snapshot
+  if (good && (h->rc_mtime_sec != st->st_mtim.tv_sec || h->rc_mtime_nsec != st->st_mtim.tv_nsec)) {
+    good = rc_hash_file(rc, st->st_size) == h->rc_hash;
+    if (good) {
+      long long mtime[2] = { st->st_mtim.tv_sec, st->st_mtim.tv_nsec };
+      if (pwrite(fd, mtime, sizeof(mtime), offsetof(struct rc_header, rc_mtime_sec)) != sizeof(mtime)) good = 0;
+    }
+  }
+
+  good = good && rc_valid_snapshot(h) && rc_apply(h);
+  munmap(map, cache.st_size);
+  close(fd);
+  return good;
+}
+
+/* Run the lines of the rc file as commands, outside the history.
+   Returns 0 if one of them failed */
+int rc_run(const char *text, size_t size) {
+  char line[MAX_INPUT_BUFFER];
+  char failure[sizeof(error_buffer)] = "";
+  size_t start = 0;
+  int number = 0;
+
+  history_suspended++;
+  while (start < size) {
+    size_t end = start;
+    while (end < size && text[end] != '\n') end++;
+    size_t length = end - start;
+    number++;
+
+    // Skip the indentation and a carriage return at the end
+    while (length > 0 && (text[start] == ' ' || text[start] == '\t')) { start++; length--; }
+    while (length > 0 && (text[start + length - 1] == '\r' || text[start + length - 1] == ' ')) length--;
+
+    if (length > 0 && text[start] != '#') {
+      error_buffer[0] = '\0';
+      if (length >= MAX_INPUT_BUFFER - 1) sprintf(error_buffer, "ERROR: The line is too long");
+      else {
+        memcpy(line, text + start, length);
+        line[length] = '\0';
+        lowercase_input(line);
+        compute(line);
+      }
+      if (error_buffer[0] != '\0' && failure[0] == '\0') {
+        char *message = strncmp(error_buffer, "ERROR: ", 7) == 0 ? error_buffer + 7 : error_buffer;
+        snprintf(failure, sizeof(failure), "ERROR: %s:%d: %.40s", RC_FILE, number, message);
+      }
+    }
+    start = end + 1;
+  }
+  history_suspended--;
+
+  strcpy(error_buffer, failure);
+  return failure[0] == '\0';
+}
+
+/* Run ~/.lukarc, or restore the snapshot it left last time */
+void load_rc(void) {
+  char rc_path[PATH_MAX], cache_path[PATH_MAX];
+  char *home = getenv("HOME");
+  struct stat st;
+
+  if (home == NULL) return;
+  snprintf(rc_path, sizeof(rc_path), "%s/%s", home, RC_FILE);
+  snprintf(cache_path, sizeof(cache_path), "%s/%s", home, RC_CACHE_FILE);
+
+  int fd = open(rc_path, O_RDONLY);
+  if (fd == -1) return;
+  if (fstat(fd, &st) == -1 || rc_restore(cache_path, fd, &st)) {
+    close(fd);
+    return;
+  }
+
+  char *text = st.st_size > 0 ? mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0) : NULL;
+  if (text == MAP_FAILED) {
+    close(fd);
+    return;
+  }
+
+  unrepeatable = 0;
+  int done = rc_run(text, st.st_size);
+
+  if (!done || unrepeatable || !rc_save(cache_path, &st, rc_hash((unsigned char *) text, st.st_size, RC_HASH_SEED))) {
+    unlink(cache_path);
+  }
+
+  if (text != NULL) munmap(text, st.st_size);
+  close(fd);
+}
@@ -0,0 +1,255 @@
+// SPDX-License-Identifier: GPL-2.0
+/* luka_scan.c
+ *
+ * A simple RPN calculator for terminal
+ * made with love in Italy.
+ *
+ * Copyright 2025 Davide Mastromatteo
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+/* --------------
+   SCAN FUNCTIONS
+   -------------- */
+
+/* cumsum, cumprod, cummax and cummin replace a sequence with the array
+   of its running sums, products, maximums and minimums; diff with the
+   array of the differences between consecutive elements.
+
+   A scan is done in two passes over the slices of the workers: first
+   each worker reduces its slice, vectorized across SCAN_LANES lanes,
+   then the totals of the slices before each one give it the value to
+   start from, and in the second pass each worker scans its slice block
+   by block. The last slice is never reduced, so with a single worker
+   there's only one pass.
+
+   Sums are compensated, as sum: every addition keeps its rounding
+   error with two_sum, the same of the double-double numbers, which
+   needs no branches and vectorizes, and the running error is added
+   back to every partial sum. When the values of the sequence were
+   just computed the scan is done in place, otherwise in a new array. */
+
+#define SCAN_LANES (SCAN_VECTOR_BYTES / 8)
+
+typedef double vector_scan __attribute__((vector_size(SCAN_VECTOR_BYTES)));
+typedef long long vector_scan_mask __attribute__((vector_size(SCAN_VECTOR_BYTES)));
+
+struct scan_job {
+  double *x;
+  double *output;
+  char what;
+  int workers;
+  double total[MAX_WORKERS];
+  double total_error[MAX_WORKERS];
+  double start[MAX_WORKERS];
+  double start_error[MAX_WORKERS];
+};
+
+/* The value a scan starts from */
+double scan_identity(char what) {
+  switch (what) {
+    case '+': return 0;
+    case '*': return 1;
+    case '<': return INFINITY;
+    default: return -INFINITY;
+  }
+}
+
+/* Add x to the sum s, accumulating the rounding error in e */
+static inline void scan_add(double *s, double *e, double x) {
+  struct dd t = two_sum(*s, x);
+  *s = t.hi;
+  *e += t.lo;
+}
+
+/* Combine y with the running value r (and its error e) */
+static inline void scan_combine(char what, double *r, double *e, double y) {
+  switch (what) {
+    case '+': scan_add(r, e, y); break;
+    case '*': *r *= y; break;
+    case '<': if (y < *r) *r = y; break;
+    case '>': if (y > *r) *r = y; break;
+  }
+}
+
+/* First pass: reduce a slice, a lane of the vectors for every
+   SCAN_LANES elements, then the lanes and the tail together */
+void scan_reduce_slice(long from, long to, int worker, void *context) {
+  struct scan_job *job = context;
+  if (worker == job->workers - 1) return;
+
+  double identity = scan_identity(job->what);
+  vector_scan r = (vector_scan) { 0 } + identity, e = { 0 }, x;
+  long i = from;
+
+  for (; i + SCAN_LANES <= to; i += SCAN_LANES) {
+    memcpy(&x, job->x + i, sizeof(x));
+    switch (job->what) {
+      case '+': {
+        vector_scan t = r + x;
+        vector_scan b = t - r;
+        e += (r - (t - b)) + (x - b);
+        r = t;
+        break;
+      }
+      case '*':
+        r *= x;
+        break;
+      case '<': {
+        vector_scan_mask m = x < r;
+        r = (vector_scan) (((vector_scan_mask) x & m) | ((vector_scan_mask) r & ~m));
+        break;
+      }
+      case '>': {
+        vector_scan_mask m = x > r;
+        r = (vector_scan) (((vector_scan_mask) x & m) | ((vector_scan_mask) r & ~m));
+        break;
+      }
+    }
+  }
+
+  double total = identity, error = 0;
+  for (int l = 0; l < SCAN_LANES; l++) {
+    scan_combine(job->what, &total, &error, r[l]);
+    error += e[l];
+  }
+  for (; i < to; i++) scan_combine(job->what, &total, &error, job->x[i]);
+  job->total[worker] = total;
+  job->total_error[worker] = error;
+}
+
+/* Second pass: scan a slice from the value of the slices before it */
+void scan_slice(long from, long to, int worker, void *context) {
+  struct scan_job *job = context;
+  double r = job->start[worker], e = job->start_error[worker];
+  double *x = job->x, *output = job->output;
+
+  for (long i = from; i < to && !job_cancelled(); i += SEQUENCE_BLOCK_LENGTH) {
+    long end = to - i < SEQUENCE_BLOCK_LENGTH ? to : i + SEQUENCE_BLOCK_LENGTH;
+    switch (job->what) {
+      case '+':
+        for (long j = i; j < end; j++) {
+          scan_add(&r, &e, x[j]);
+          output[j] = r + e;
+        }
+        break;
+      case '*':
+        for (long j = i; j < end; j++) output[j] = r *= x[j];
+        break;
+      case '<':
+        for (long j = i; j < end; j++) output[j] = r = x[j] < r ? x[j] : r;
+        break;
+      case '>':
+        for (long j = i; j < end; j++) output[j] = r = x[j] > r ? x[j] : r;
+        break;
+    }
+    if (worker == 0) set_job_progress((double) (i - from) / (to - from));
+  }
+}
+
+/* Differences of the consecutive elements of a slice */
+void diff_slice(long from, long to, int worker, void *context) {
+  struct scan_job *job = context;
+  double *x = job->x, *output = job->output;
+
+  for (long i = from; i < to && !job_cancelled(); i += SEQUENCE_BLOCK_LENGTH) {
+    long end = to - i < SEQUENCE_BLOCK_LENGTH ? to : i + SEQUENCE_BLOCK_LENGTH;
+    for (long j = i; j < end; j++) output[j] = x[j + 1] - x[j];
+    if (worker == 0) set_job_progress((double) (i - from) / (to - from));
+  }
+}
+
+/* Replace the sequence at the top of the stack with one of its scans */
+void scan_sequence(char *name, char what) {
+  struct sequence *s = sequence_operand(name);
+  if (s == NULL) return;
+
+  struct buffer *values = sequence_collect(s);
+  if (values == NULL || job_cancelled()) {
+    buffer_release(values);
+    return;
+  }
+
+  // diff needs its input intact, and arrays on the stack can't change
+  long length = what == '-' ? (values->length > 0 ? values->length - 1 : 0) : values->length;
+  struct buffer *b = values;
+  if (what == '-' || values->references > 1) b = buffer_new(length);
+  if (b == NULL) {
+    buffer_release(values);
+    sprintf(error_buffer, "ERROR: The array doesn't fit in memory");
+    return;
+  }
+
+  struct scan_job *job = calloc(1, sizeof(struct scan_job));
+  if (job == NULL) {
+    printf("ERROR: You run out of memory. Exiting.");
+    exit(1);
+  }
+  job->x = values->data;
+  job->output = b->data;
+  job->what = what;
+
+  if (what == '-') parallel_for(length, PARALLEL_MIN_LENGTH, diff_slice, job);
+  else {
+    job->workers = parallel_slices(length, PARALLEL_MIN_LENGTH);
+    if (job->workers > 1) parallel_for(length, PARALLEL_MIN_LENGTH, scan_reduce_slice, job);
+
+    job->start[0] = scan_identity(what);
+    for (int w = 1; w < job->workers; w++) {
+      job->start[w] = job->start[w - 1];
+      job->start_error[w] = job->start_error[w - 1] + job->total_error[w - 1];
+      scan_combine(what, &job->start[w], &job->start_error[w], job->total[w - 1]);
+    }
+    if (!job_cancelled()) parallel_for(length, PARALLEL_MIN_LENGTH, scan_slice, job);
+  }
+  free(job);
+
+  if (b != values) buffer_release(values);
+  if (job_cancelled()) {
+    buffer_release(b);
+    return;
+  }
+
+  double x = pop();
+  double result = make_array(b);
+  push(result);
+  log_operation_1o(x, name, result);
+}
+
+/* cumsum: running sums of a sequence */
+void cumulative_sum(void) {
+  scan_sequence("cumsum", '+');
+}
+
+/* cumprod: running products of a sequence */
+void cumulative_product(void) {
+  scan_sequence("cumprod", '*');
+}
+
+/* cummax: running maximums of a sequence */
+void cumulative_max(void) {
+  scan_sequence("cummax", '>');
+}
+
+/* cummin: running minimums of a sequence */
+void cumulative_min(void) {
+  scan_sequence("cummin", '<');
+}
+
+/* diff: differences between consecutive elements of a sequence */
+void difference(void) {
+  scan_sequence("diff", '-');
+}
@@ -0,0 +1,629 @@
+// SPDX-License-Identifier: GPL-2.0
+/* luka_sequences.c
+ *
+ * A simple RPN calculator for terminal
+ * made with love in Italy.
+ *
+ * Copyright 2025 Davide Mastromatteo
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/* ------------------
+   SEQUENCE FUNCTIONS
+   ------------------ */
+
+/* A sequence is a lazy list of numbers: a source (a range or an array
+   of values) followed by the stages the elements go through. "1 1e9
+   range" takes a few bytes, "sqrt" or "2 *" on it just add a stage
+   and nothing is computed until a reduction (sum, min...) or "array"
+   needs the values. Then the elements are generated in blocks small
+   enough to stay in the L1 cache, every block goes through all the
+   stages and is reduced before the next one is generated, and the
+   range is split among the workers.
+
+   Stage kinds:
+   '1' = x = f1(x)
+   't' = x = f1(x), converting degrees when the stage was added in deg
+   'x' = x = f2(x, constant), the sequence was the x operand
+   'y' = x = f2(constant, x), the sequence was the y operand
+   'w' = x = word(x)
+   'f' = keep x only if word(x) isn't 0 */
+
+struct buffer {
+  int references;
+  long length;
+  double data[];
+};
+
+struct stage {
+  char kind;
+  operation_1o f1;
+  operation_2o f2;
+  double constant;
+  struct program *program;
+};
+
+struct sequence {
+  struct buffer *buffer;
+  double start;
+  double step;
+  long length;
+  char filtered;
+  int n_stages;
+  struct stage stages[];
+};
+
+struct reduction {
+  double sum;
+  double compensation;
+  double product;
+  double min;
+  double max;
+  long count;
+};
+
+struct sequence_job {
+  struct sequence *sequence;
+  struct reduction partial[MAX_WORKERS];
+  double *values[MAX_WORKERS];
+  long lengths[MAX_WORKERS];
+  double *output;
+  int failed;
+};
+
+struct object_class sequence_class;
+
+/* Allocate a buffer of values, NULL if there isn't enough memory */
+struct buffer *buffer_new(long length) {
+  struct buffer *b = arena_try_alloc(ARENA_ARRAYS, sizeof(struct buffer) + length * sizeof(double));
+  if (b == NULL) return NULL;
+  b->references = 1;
+  b->length = length;
+  return b;
+}
+
+/* Release a reference to a buffer */
+void buffer_release(struct buffer *b) {
+  if (b != NULL && --b->references == 0) arena_free(b);
+}
+
+/* Allocate a sequence with room for n stages */
+struct sequence *sequence_new(int n_stages) {
+  struct sequence *s = arena_alloc(ARENA_OBJECTS, sizeof(struct sequence) + n_stages * sizeof(struct stage));
+  memset(s, 0, sizeof(struct sequence));
+  s->n_stages = n_stages;
+  return s;
+}
+
+/* Create the value of a sequence reading a whole buffer */
+double make_array(struct buffer *b) {
+  struct sequence *s = sequence_new(0);
+  s->buffer = b;
+  s->length = b->length;
+  return make_object(&sequence_class, s);
+}
+
+/* Get the sequence of a value, or NULL if it isn't a sequence */
+struct sequence *get_sequence(double value) {
+  return get_object_data(value, &sequence_class);
+}
+
+/* Create a new sequence adding a stage to an existing one */
+double sequence_add_stage(struct sequence *s, struct stage stage) {
+  struct sequence *n = sequence_new(s->n_stages + 1);
+  memcpy(n, s, sizeof(struct sequence) + s->n_stages * sizeof(struct stage));
+  n->n_stages = s->n_stages + 1;
+  n->stages[s->n_stages] = stage;
+  if (stage.kind == 'f') n->filtered = 1;
+  if (n->buffer != NULL) n->buffer->references++;
+  return make_object(&sequence_class, n);
+}
+
+/* Compute the elements [from, from + n) of a sequence in x,
+   returns how many of them are left after the filters */
+int sequence_block(struct sequence *s, long from, int n, double *x) {
+  if (s->buffer != NULL) memcpy(x, s->buffer->data + from, n * sizeof(double));
+  else for (int j = 0; j < n; j++) x[j] = s->start + (from + j) * s->step;
+
+  for (int i = 0; i < s->n_stages; i++) {
+    struct stage *stage = &s->stages[i];
+    int k = 0;
+    switch (stage->kind) {
+      case '1':
+        for (int j = 0; j < n; j++) x[j] = stage->f1(x[j]);
+        break;
+      case 't':
+        for (int j = 0; j < n; j++) x[j] = stage->f1(x[j] * stage->constant);
+        break;
+      case 'x':
+        for (int j = 0; j < n; j++) x[j] = stage->f2(x[j], stage->constant);
+        break;
+      case 'y':
+        for (int j = 0; j < n; j++) x[j] = stage->f2(stage->constant, x[j]);
+        break;
+      case 'w':
+        for (int j = 0; j < n; j++) x[j] = run_scratch_function(stage->program, x[j]);
+        break;
+      case 'f':
+        for (int j = 0; j < n; j++) {
+          if (run_scratch_function(stage->program, x[j]) != 0) x[k++] = x[j];
+        }
+        n = k;
+        break;
+    }
+  }
+  return n;
+}
+
+/* Reduce a slice of a sequence: sum (compensated), product, min, max and count */
+void sequence_reduce_slice(long from, long to, int worker, void *context) {
+  struct sequence_job *job = context;
+  struct reduction *r = &job->partial[worker];
+  double x[SEQUENCE_BLOCK_LENGTH];
+
+  r->sum = r->compensation = 0;
+  r->product = 1;
+  r->min = INFINITY;
+  r->max = -INFINITY;
+  r->count = 0;
+
+  for (long i = from; i < to && !job_cancelled(); i += SEQUENCE_BLOCK_LENGTH) {
+    int n = sequence_block(job->sequence, i, to - i < SEQUENCE_BLOCK_LENGTH ? to - i : SEQUENCE_BLOCK_LENGTH, x);
+    for (int j = 0; j < n; j++) {
+      double t = r->sum + x[j];
+      r->compensation += fabs(r->sum) >= fabs(x[j]) ? (r->sum - t) + x[j] : (x[j] - t) + r->sum;
+      r->sum = t;
+      r->product *= x[j];
+      if (x[j] < r->min) r->min = x[j];
+      if (x[j] > r->max) r->max = x[j];
+    }
+    r->count += n;
+    if (worker == 0) set_job_progress((double) (i - from) / (to - from));
+  }
+}
+
+/* Reduce a whole sequence, combining the results of the workers */
+struct reduction sequence_reduce(struct sequence *s) {
+  struct sequence_job *job = calloc(1, sizeof(struct sequence_job));
+  if (job == NULL) {
+    printf("ERROR: You run out of memory. Exiting.");
+    exit(1);
+  }
+  job->sequence = s;
+
+  int workers = parallel_for(s->length, PARALLEL_MIN_LENGTH, sequence_reduce_slice, job);
+
+  struct reduction r = job->partial[0];
+  for (int w = 1; w < workers; w++) {
+    struct reduction *p = &job->partial[w];
+    r.compensation += p->compensation;
+    double t = r.sum + p->sum;
+    r.compensation += fabs(r.sum) >= fabs(p->sum) ? (r.sum - t) + p->sum : (p->sum - t) + r.sum;
+    r.sum = t;
+    r.product *= p->product;
+    if (p->min < r.min) r.min = p->min;
+    if (p->max > r.max) r.max = p->max;
+    r.count += p->count;
+  }
+  r.sum += r.compensation;
+  free(job);
+  return r;
+}
+
+/* Compute a slice of a sequence. Without filters every element
+   has its place in the output, otherwise the worker keeps its own
+   list of values, put together at the end */
+void sequence_collect_slice(long from, long to, int worker, void *context) {
+  struct sequence_job *job = context;
+  double x[SEQUENCE_BLOCK_LENGTH];
+  long capacity = 0;
+
+  for (long i = from; i < to && !job_cancelled(); i += SEQUENCE_BLOCK_LENGTH) {
+    int block = to - i < SEQUENCE_BLOCK_LENGTH ? to - i : SEQUENCE_BLOCK_LENGTH;
+
+    if (job->output != NULL) {
+      sequence_block(job->sequence, i, block, job->output + i);
+    }
+    else {
+      int n = sequence_block(job->sequence, i, block, x);
+      if (job->lengths[worker] + n > capacity) {
+        capacity = capacity * 2 + SEQUENCE_BLOCK_LENGTH;
+        double *values = realloc(job->values[worker], capacity * sizeof(double));
+        if (values == NULL) {
+          job->failed = 1;
+          return;
+        }
+        job->values[worker] = values;
+      }
+      memcpy(job->values[worker] + job->lengths[worker], x, n * sizeof(double));
+      job->lengths[worker] += n;
+    }
+    if (worker == 0) set_job_progress((double) (i - from) / (to - from));
+  }
+}
+
+/* Compute all the values of a sequence in a buffer,
+   NULL (with an error) if they don't fit in memory */
+struct buffer *sequence_collect(struct sequence *s) {
+  if (s->buffer != NULL && s->n_stages == 0) {
+    s->buffer->references++;
+    return s->buffer;
+  }
+
+  struct sequence_job *job = calloc(1, sizeof(struct sequence_job));
+  if (job == NULL) {
+    printf("ERROR: You run out of memory. Exiting.");
+    exit(1);
+  }
+  job->sequence = s;
+
+  struct buffer *b = NULL;
+  if (!s->filtered) {
+    b = buffer_new(s->length);
+    if (b == NULL) {
+      free(job);
+      sprintf(error_buffer, "ERROR: The sequence doesn't fit in memory");
+      return NULL;
+    }
+    job->output = b->data;
+  }
+
+  int workers = parallel_for(s->length, PARALLEL_MIN_LENGTH, sequence_collect_slice, job);
+
+  if (s->filtered) {
+    long length = 0;
+    for (int w = 0; w < workers; w++) length += job->lengths[w];
+    if (!job->failed) b = buffer_new(length);
+    if (b != NULL) {
+      length = 0;
+      for (int w = 0; w < workers; w++) {
+        memcpy(b->data + length, job->values[w], job->lengths[w] * sizeof(double));
+        length += job->lengths[w];
+      }
+    }
+    else sprintf(error_buffer, "ERROR: The sequence doesn't fit in memory");
+    for (int w = 0; w < workers; w++) free(job->values[w]);
+  }
+
+  free(job);
+  return b;
+}
+
+/* Format a sequence as its length followed by as many
+   of its first values as fit */
+void sequence_format(struct object *o, char *buffer, int size) {
+  struct sequence *s = o->data;
+  double x[SEQUENCE_PREVIEW_LENGTH + 1];
+  char value[26];
+
+  int n = s->length < SEQUENCE_PREVIEW_LENGTH + 1 ? s->length : SEQUENCE_PREVIEW_LENGTH + 1;
+  n = sequence_block(s, 0, n, x);
+
+  if (s->filtered) snprintf(buffer, size, "[?]");
+  else snprintf(buffer, size, "[%ld]", s->length);
+
+  int used = strlen(buffer);
+  int more = s->filtered || s->length > SEQUENCE_PREVIEW_LENGTH;
+  for (int j = 0; j < n && j < SEQUENCE_PREVIEW_LENGTH; j++) {
+    int length = snprintf(value, sizeof(value), " %.6lg", x[j]);
+    if (used + length + 4 >= size) {
+      more = 1;
+      break;
+    }
+    strcpy(buffer + used, value);
+    used += length;
+  }
+  if (more && used + 4 < size) strcpy(buffer + used, " ...");
+}
+
+/* A sequence isn't a number */
+double sequence_to_double(struct object *o) {
+  (void) o;
+  return NAN;
+}
+
+/* A single operand operation on a sequence adds a stage */
+int sequence_operation_1o(operation_1o f, double x, double *r) {
+  struct stage stage = { .kind = '1', .f1 = f };
+  *r = sequence_add_stage(get_sequence(x), stage);
+  return 1;
+}
+
+/* Apply an operation element by element to two sequences,
+   which have to be computed first */
+int sequence_zip(operation_2o f, struct sequence *sx, struct sequence *sy, double *r) {
+  struct buffer *bx = sequence_collect(sx);
+  if (bx == NULL) return -1;
+  struct buffer *by = sequence_collect(sy);
+  if (by == NULL) {
+    buffer_release(bx);
+    return -1;
+  }
+
+  int result = -1;
+  struct buffer *b = NULL;
+  if (bx->length != by->length) sprintf(error_buffer, "ERROR: The sequences have different lengths");
+  else if ((b = buffer_new(bx->length)) == NULL) sprintf(error_buffer, "ERROR: The sequence doesn't fit in memory");
+  else {
+    for (long i = 0; i < b->length; i++) b->data[i] = f(bx->data[i], by->data[i]);
+    *r = make_array(b);
+    result = 1;
+  }
+
+  buffer_release(bx);
+  buffer_release(by);
+  return result;
+}
+
+/* A two operands operation between a sequence and a number adds a stage,
+   between two sequences works element by element */
+int sequence_operation_2o(operation_2o f, double x, double y, double *r) {
+  struct sequence *sx = get_sequence(x);
+  struct sequence *sy = get_sequence(y);
+
+  if (sx != NULL && sy != NULL) return sequence_zip(f, sx, sy, r);
+
+  if (sx != NULL) {
+    struct stage stage = { .kind = 'x', .f2 = f, .constant = to_number(y) };
+    *r = sequence_add_stage(sx, stage);
+  }
+  else {
+    struct stage stage = { .kind = 'y', .f2 = f, .constant = to_number(x) };
+    *r = sequence_add_stage(sy, stage);
+  }
+  return 1;
+}
+
+/* Compute a trigonometric operation on a sequence.
+   Returns 0 if x isn't a sequence */
+int compute_sequence_trigonometric_operation(operation_1o f, double x, double *r) {
+  struct sequence *s = get_sequence(x);
+  if (s == NULL) return 0;
+
+  struct stage stage = { .kind = 't', .f1 = f, .constant = mode == 'd' ? M_PI / 180 : 1 };
+  *r = sequence_add_stage(s, stage);
+  return 1;
+}
+
+/* Free a sequence */
+void sequence_release(struct object *o) {
+  struct sequence *s = o->data;
+  buffer_release(s->buffer);
+  arena_free(s);
+}
+
+struct object_class sequence_class = {
+  "sequence", 4, 0,
+  sequence_format,
+  sequence_to_double,
+  sequence_operation_1o,
+  sequence_operation_2o,
+  NULL,
+  sequence_release
+};
+
+/* range: push the sequence y, y+1, ... up to x (or down to x) */
+void push_range(void) {
+  if (sp < 2) return;
+  double to = to_number(pick(sp));
+  double from = to_number(pick(sp - 1));
+
+  if (!isfinite(from) || !isfinite(to) || fabs(to - from) >= (double) LONG_MAX) {
+    sprintf(error_buffer, "ERROR: Invalid range");
+    return;
+  }
+
+  struct sequence *s = sequence_new(0);
+  s->start = from;
+  s->step = to >= from ? 1 : -1;
+  s->length = (long) floor(fabs(to - from)) + 1;
+
+  pop();
+  pop();
+  push(make_object(&sequence_class, s));
+}
+
+/* Take the sequence at the top of the stack, without popping it */
+struct sequence *sequence_operand(char *name) {
+  struct sequence *s = sp > 0 ? get_sequence(pick(sp)) : NULL;
+  if (s == NULL) sprintf(error_buffer, "ERROR: %s needs a sequence", name);
+  return s;
+}
+
+/* Replace a sequence with one of its reductions */
+void reduce_sequence(char *name, char what) {
+  struct sequence *s = sequence_operand(name);
+  if (s == NULL) return;
+
+  struct reduction r = sequence_reduce(s);
+  if (job_cancelled()) return;
+
+  double result = 0;
+  switch (what) {
+    case '+': result = r.sum; break;
+    case '*': result = r.product; break;
+    case '<': result = r.count > 0 ? r.min : NAN; break;
+    case '>': result = r.count > 0 ? r.max : NAN; break;
+    case 'n': result = r.count; break;
+  }
+
+  double x = pop();
+  push(result);
+  log_operation_1o(x, name, result);
+}
+
+/* sum: sum of the elements of a sequence */
+void sequence_sum(void) {
+  reduce_sequence("sum", '+');
+}
+
+/* prod: product of the elements of a sequence */
+void sequence_product(void) {
+  reduce_sequence("prod", '*');
+}
+
+/* min: smallest element of a sequence */
+void sequence_min(void) {
+  reduce_sequence("min", '<');
+}
+
+/* max: largest element of a sequence */
+void sequence_max(void) {
+  reduce_sequence("max", '>');
+}
+
+/* len: number of elements of a sequence */
+void sequence_length(void) {
+  struct sequence *s = sequence_operand("len");
+  if (s == NULL) return;
+  if (s->filtered) {
+    reduce_sequence("len", 'n');
+    return;
+  }
+  double x = pop();
+  push(s->length);
+  log_operation_1o(x, "len", s->length);
+}
+
+/* array: compute the values of the sequence at the top of the stack,
+   or pack the x values below x in an array */
+void push_array(void) {
+  if (sp < 1) return;
+  struct sequence *s = get_sequence(pick(sp));
+  struct buffer *b;
+
+  if (s != NULL) {
+    b = sequence_collect(s);
+    if (b == NULL || job_cancelled()) {
+      buffer_release(b);
+      return;
+    }
+    pop();
+    push(make_array(b));
+    return;
+  }
+
+  double n = to_number(pick(sp));
+  if (n < 0 || n != floor(n) || n > sp - 1) {
+    sprintf(error_buffer, "ERROR: There aren't %lg values to pack", n);
+    return;
+  }
+  if ((b = buffer_new((long) n)) == NULL) {
+    sprintf(error_buffer, "ERROR: The array doesn't fit in memory");
+    return;
+  }
+  pop();
+  for (long i = b->length - 1; i >= 0; i--) b->data[i] = to_number(pop());
+  push(make_array(b));
+}
+
+/* Get the program of a word that can be used on the elements */
+struct program *get_element_function(char *name) {
+  struct word *w = get_word(name);
+  if (w == NULL) {
+    snprintf(error_buffer, sizeof(error_buffer), "ERROR: Unknown word %s", name);
+    return NULL;
+  }
+  if (!is_scratch_program(w->program) || program_uses_random(w->program)) {
+    snprintf(error_buffer, sizeof(error_buffer), "ERROR: %s can't be used on the elements", name);
+    return NULL;
+  }
+
+  /* A sequence is computed again every time it's needed, so it would
+     change with the memories the word loads */
+  if (program_uses_memories(w->program)) {
+    snprintf(error_buffer, sizeof(error_buffer), "ERROR: %s loads memories, it can't be used on the elements", name);
+    return NULL;
+  }
+  return w->program;
+}
+
+/* map: apply a word to every element of a sequence */
+void sequence_map(char *parameter) {
+  struct sequence *s = sequence_operand("map");
+  if (s == NULL) return;
+  struct stage stage = { .kind = 'w', .program = get_element_function(parameter) };
+  if (stage.program == NULL) return;
+  double r = sequence_add_stage(s, stage);
+  pop();
+  push(r);
+}
+
+/* filter: keep the elements of a sequence for which a word isn't 0 */
+void sequence_filter(char *parameter) {
+  struct sequence *s = sequence_operand("filter");
+  if (s == NULL) return;
+  struct stage stage = { .kind = 'f', .program = get_element_function(parameter) };
+  if (stage.program == NULL) return;
+  double r = sequence_add_stage(s, stage);
+  pop();
+  push(r);
+}
+
+/* aload: load an array from a text file, the values
+   separated by spaces, tabs, commas or new lines */
+void load_array(char *parameter) {
+  FILE *file = fopen(parameter, "r");
+  if (file == NULL) {
+    snprintf(error_buffer, sizeof(error_buffer), "ERROR: Can't open %s", parameter);
+    return;
+  }
+
+  struct buffer *b = NULL;
+  long n = 0, capacity = 0;
+  int ok = 1;
+  char *line = NULL;
+  size_t line_capacity = 0;
+
+  for (long row = 1; ok && getline(&line, &line_capacity, file) != -1; row++) {
+    char *p = line, *end;
+    for (;;) {
+      while (*p == ' ' || *p == '\t' || *p == ',' || *p == '\r' || *p == '\n') p++;
+      if (*p == '\0') break;
+      double value = strtod(p, &end);
+      if (end == p) {
+        snprintf(error_buffer, sizeof(error_buffer), "ERROR: Invalid number in line %ld", row);
+        ok = 0;
+        break;
+      }
+      p = end;
+      if (n >= capacity) {
+        capacity = capacity * 2 + SEQUENCE_BLOCK_LENGTH;
+        struct buffer *grown = arena_try_realloc(ARENA_ARRAYS, b, sizeof(struct buffer) + capacity * sizeof(double));
+        if (grown == NULL) {
+          sprintf(error_buffer, "ERROR: The array doesn't fit in memory");
+          ok = 0;
+          break;
+        }
+        b = grown;
+      }
+      b->data[n++] = value;
+    }
+  }
+  fclose(file);
+  free(line);
+
+  if (!ok) {
+    arena_free(b);
+    return;
+  }
+  if (b == NULL && (b = buffer_new(0)) == NULL) {
+    sprintf(error_buffer, "ERROR: The array doesn't fit in memory");
+    return;
+  }
+  b->references = 1;
+  b->length = n;
+  push(make_array(b));
+}
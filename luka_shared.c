@@ -0,0 +1,309 @@
+// SPDX-License-Identifier: GPL-2.0
+/* luka_shared.c
+ *
+ * A simple RPN calculator for terminal
+ * made with love in Italy.
+ *
+ * Copyright 2025 Davide Mastromatteo
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/* -----------------------
+   SHARED MEMORY FUNCTIONS
+   ----------------------- */
+
+/* The memories whose name starts with @ are shared registers: they
+   live in the POSIX shared memory segment /luka-<namespace>, mapped
+   the first time one of them is used (or at start with --shared), so
+   every luka of the same namespace sees them.
+
+   Each register is a seqlock: the writer makes its sequence number
+   odd, writes, and makes it even again, while a reader copies the
+   register and keeps it only if the sequence was the same even number
+   before and after. Readers never take a lock and never see half a
+   write. Writers, that are rare, serialize on a spinlock in the
+   segment holding the pid of its owner. Every write also bumps the
+   generation of the segment, so the memory panel copies the table only
+   after some process changed it.
+
+   A process may die holding the lock, maybe in the middle of a write.
+   The next writer finds its owner gone, takes the lock over and empties
+   the registers left with an odd sequence; a reader still finding one
+   after SHARED_READ_RETRIES tries does the same, but only if the owner
+   is dead: a live writer is simply waited for. Waiting, for the lock
+   or for a register, stops if the command is cancelled.
+
+   A fresh segment is all zeros, which is an empty table, so there's
+   nothing to initialize. Shared registers hold plain numbers and are
+   outside undo and redo, since other processes may have changed them
+   in the meantime. */
+
+#define SHARED_NAME_WORDS ((MAX_MEMORY_NAME_LENGTH + 8) / 8)
+
+struct shared_register {
+  atomic_uint sequence;
+  atomic_ullong name[SHARED_NAME_WORDS];
+  atomic_ullong value;
+};
+
+struct shared_segment {
+  atomic_ulong generation;
+  atomic_uint lock;
+  struct shared_register registers[SHARED_REGISTERS];
+};
+
+/* Copy of the table shown by the memory panel */
+struct shared_view {
+  unsigned long generation;
+  int n;
+  char names[SHARED_REGISTERS][SHARED_NAME_WORDS * 8];
+  double values[SHARED_REGISTERS];
+} shared_view = { .generation = -1UL };
+
+pthread_once_t shared_once = PTHREAD_ONCE_INIT;
+
+/* Map the segment of the namespace, creating it if needed */
+void shared_map(void) {
+  char name[64];
+  snprintf(name, sizeof(name), "/luka-%s", shared_namespace);
+
+  int fd = shm_open(name, O_RDWR | O_CREAT, 0600);
+  if (fd == -1) return;
+  // Growing to the same size is harmless, so every process can do it
+  if (ftruncate(fd, sizeof(struct shared_segment)) == 0) {
+    void *p = mmap(NULL, sizeof(struct shared_segment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (p != MAP_FAILED) shared_segment = p;
+  }
+  close(fd);
+}
+
+/* Get the shared segment, mapping it the first time */
+struct shared_segment *get_shared_segment(void) {
+  unrepeatable = 1;
+  pthread_once(&shared_once, shared_map);
+  if (shared_segment == NULL) {
+    snprintf(error_buffer, sizeof(error_buffer), "ERROR: Can't open the shared registers of %s", shared_namespace);
+  }
+  return shared_segment;
+}
+
+/* Tell if a memory name refers to a shared register */
+int is_shared_name(char *name) {
+  return name[0] == '@';
+}
+
+/* Pack a register name (without the @) in whole words */
+void shared_pack_name(char *name, unsigned long long *words) {
+  char buffer[SHARED_NAME_WORDS * 8] = { 0 };
+  strncpy(buffer, name, sizeof(buffer) - 1);
+  memcpy(words, buffer, sizeof(buffer));
+}
+
+
+/* Write a register, holding the writers' lock */
+void shared_write(struct shared_register *r, unsigned long long *name, double value) {
+  unsigned long long bits;
+  memcpy(&bits, &value, sizeof(bits));
+
+  unsigned sequence = atomic_load_explicit(&r->sequence, memory_order_relaxed);
+  atomic_store_explicit(&r->sequence, sequence + 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  for (int w = 0; w < SHARED_NAME_WORDS; w++) atomic_store_explicit(&r->name[w], name[w], memory_order_relaxed);
+  atomic_store_explicit(&r->value, bits, memory_order_relaxed);
+  atomic_store_explicit(&r->sequence, sequence + 2, memory_order_release);
+}
+
+/* Tell if the process holding the writers' lock is gone */
+int shared_owner_dead(unsigned owner) {
+  return owner != 0 && kill((pid_t) owner, 0) == -1 && errno == ESRCH;
+}
+
+/* Empty the registers a dead writer left in the middle of a write,
+   returns how many there were */
+int shared_repair(struct shared_segment *s) {
+  int repaired = 0;
+  for (int i = 0; i < SHARED_REGISTERS; i++) {
+    struct shared_register *r = &s->registers[i];
+    unsigned sequence = atomic_load_explicit(&r->sequence, memory_order_relaxed);
+    if (!(sequence & 1)) continue;
+    for (int w = 0; w < SHARED_NAME_WORDS; w++) atomic_store_explicit(&r->name[w], 0, memory_order_relaxed);
+    atomic_store_explicit(&r->value, 0, memory_order_relaxed);
+    atomic_store_explicit(&r->sequence, sequence + 1, memory_order_release);
+    repaired++;
+  }
+  return repaired;
+}
+
+/* Take the writers' lock, taking it over from a dead owner.
+   Returns 0, with an error, if the command is cancelled meanwhile */
+int shared_lock(struct shared_segment *s) {
+  unsigned self = (unsigned) getpid();
+  for (;;) {
+    unsigned owner = 0;
+    if (atomic_compare_exchange_weak_explicit(&s->lock, &owner, self, memory_order_acquire, memory_order_relaxed)) return 1;
+    if (shared_owner_dead(owner) &&
+        atomic_compare_exchange_strong_explicit(&s->lock, &owner, self, memory_order_acquire, memory_order_relaxed)) {
+      shared_repair(s);
+      return 1;
+    }
+    if (job_cancelled()) {
+      sprintf(error_buffer, "ERROR: The shared registers are locked");
+      return 0;
+    }
+    sched_yield();
+  }
+}
+
+/* Release the writers' lock */
+
+void shared_unlock(struct shared_segment *s) {
+  atomic_fetch_add_explicit(&s->generation, 1, memory_order_release);
+  atomic_store_explicit(&s->lock, 0, memory_order_release);
+}
+
+/* Read a register without locking, retrying while it's being written.
+   Returns 0, with an error, if the command is cancelled meanwhile */
+int shared_read(struct shared_segment *s, int i, unsigned long long *name, double *value) {
+  struct shared_register *r = &s->registers[i];
+  unsigned before, after;
+  unsigned long long bits;
+  for (int tries = 1; ; tries++) {
+    before = atomic_load_explicit(&r->sequence, memory_order_acquire);
+    for (int w = 0; w < SHARED_NAME_WORDS; w++) name[w] = atomic_load_explicit(&r->name[w], memory_order_relaxed);
+    bits = atomic_load_explicit(&r->value, memory_order_relaxed);
+    atomic_thread_fence(memory_order_acquire);
+    after = atomic_load_explicit(&r->sequence, memory_order_relaxed);
+    if (!(before & 1) && before == after) break;
+
+    if (tries % SHARED_READ_RETRIES == 0) {
+      // Only a dead writer's lock is taken, to repair what it left
+      unsigned owner = atomic_load_explicit(&s->lock, memory_order_relaxed);
+      unsigned self = (unsigned) getpid();
+      if (shared_owner_dead(owner) &&
+          atomic_compare_exchange_strong_explicit(&s->lock, &owner, self, memory_order_acquire, memory_order_relaxed)) {
+        if (shared_repair(s) > 0) atomic_fetch_add_explicit(&s->generation, 1, memory_order_release);
+        atomic_store_explicit(&s->lock, 0, memory_order_release);
+      }
+      else if (job_cancelled()) {
+        sprintf(error_buffer, "ERROR: A shared register is being written");
+        return 0;
+      }
+      else sched_yield();
+    }
+  }
+  memcpy(value, &bits, sizeof(bits));
+  return 1;
+}
+
+/* Find a register by its packed name, -1 if there's none.
+   With empty == 1 find a free register instead */
+int shared_find(struct shared_segment *s, unsigned long long *name, int empty) {
+  unsigned long long found[SHARED_NAME_WORDS];
+  double value;
+  for (int i = 0; i < SHARED_REGISTERS; i++) {
+    if (!shared_read(s, i, found, &value)) continue;
+    if (empty ? found[0] == 0 : memcmp(found, name, sizeof(found)) == 0) return i;
+  }
+  return -1;
+}
+
+/* store @name: write a shared register */
+void shared_store(char *parameter, double value) {
+  if (!is_number(value)) {
+    sprintf(error_buffer, "ERROR: Only numbers can be shared");
+    return;
+  }
+  if (parameter[1] == '\0') {
+    sprintf(error_buffer, "ERROR: A shared register needs a name");
+    return;
+  }
+
+  struct shared_segment *s = get_shared_segment();
+  if (s == NULL) return;
+
+  unsigned long long name[SHARED_NAME_WORDS];
+  shared_pack_name(parameter + 1, name);
+  if (!shared_lock(s)) return;
+  int i = shared_find(s, name, 0);
+  if (i == -1) i = shared_find(s, name, 1);
+  if (i != -1) shared_write(&s->registers[i], name, to_number(value));
+  shared_unlock(s);
+
+  if (i == -1) sprintf(error_buffer, "ERROR: You can't share more than %d registers", SHARED_REGISTERS);
+}
+
+/* Read a shared register, returns 0 if it doesn't exist */
+int shared_load(char *parameter, double *value) {
+  if (parameter[1] == '\0') {
+    sprintf(error_buffer, "ERROR: A shared register needs a name");
+    return 0;
+  }
+
+  struct shared_segment *s = get_shared_segment();
+  if (s == NULL) return 0;
+
+  unsigned long long name[SHARED_NAME_WORDS], found[SHARED_NAME_WORDS];
+  shared_pack_name(parameter + 1, name);
+  for (int i = 0; i < SHARED_REGISTERS; i++) {
+    if (!shared_read(s, i, found, value)) return 0;
+    if (memcmp(found, name, sizeof(found)) == 0) return 1;
+  }
+  return 0;
+}
+
+/* del @name: free a shared register */
+void shared_delete(char *parameter) {
+  if (parameter[1] == '\0') {
+    sprintf(error_buffer, "ERROR: A shared register needs a name");
+    return;
+  }
+
+  struct shared_segment *s = get_shared_segment();
+  if (s == NULL) return;
+
+  unsigned long long name[SHARED_NAME_WORDS], empty[SHARED_NAME_WORDS] = { 0 };
+  shared_pack_name(parameter + 1, name);
+  if (!shared_lock(s)) return;
+  int i = shared_find(s, name, 0);
+  if (i != -1) shared_write(&s->registers[i], empty, 0);
+  shared_unlock(s);
+}
+
+/* Bring the copy shown by the memory panel up to date,
+   reading the table only if its generation changed */
+void refresh_shared_view(void) {
+  struct shared_segment *s = shared_segment;
+  if (s == NULL) return;
+
+  unsigned long generation = atomic_load_explicit(&s->generation, memory_order_acquire);
+  if (generation == shared_view.generation) return;
+
+  shared_view.n = 0;
+  for (int i = 0; i < SHARED_REGISTERS; i++) {
+    unsigned long long name[SHARED_NAME_WORDS];
+    double value;
+    if (!shared_read(s, i, name, &value) || name[0] == 0) continue;
+    memcpy(shared_view.names[shared_view.n], name, sizeof(name));
+    shared_view.names[shared_view.n][sizeof(name) - 1] = '\0';
+    shared_view.values[shared_view.n++] = value;
+  }
+  shared_view.generation = generation;
+}
+
+/* Unmap the shared segment, that stays for the other processes */
+void free_shared_segment(void) {
+  if (shared_segment != NULL) munmap(shared_segment, sizeof(struct shared_segment));
+  shared_segment = NULL;
+}
@@ -0,0 +1,343 @@
+// SPDX-License-Identifier: GPL-2.0
+/* luka_solve.c
+ *
+ * A simple RPN calculator for terminal
+ * made with love in Italy.
+ *
+ * Copyright 2025 Davide Mastromatteo
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/* ----------------
+   SOLVER FUNCTIONS
+   ---------------- */
+
+/* Like the SOLVE and ∫ keys of the HP-15C, solve and integrate work on
+   a word used as a function of x. The word is already compiled and
+   runs on a private stack, so a sample costs as much as the operations
+   of its body.
+
+   solve finds a root between y and x by Brent's method, widening the
+   interval first if the function has the same sign at both ends.
+   integrate uses the 15 points Gauss-Kronrod rule on sub-intervals:
+   every round the ones with too large an error are halved, and the
+   new halves are computed by the workers at the same time. Infinite
+   ends are mapped to finite ones by a change of variable. */
+
+#define KRONROD_POINTS 8
+
+const double kronrod_x[KRONROD_POINTS] = {
+  0.991455371120812639206854697526329, 0.949107912342758524526189684047851,
+  0.864864423359769072789712788640926, 0.741531185599394439863864773280788,
+  0.586087235467691130294144845693013, 0.405845151377397166906606412076961,
+  0.207784955007898467600689403773245, 0.000000000000000000000000000000000
+};
+
+const double kronrod_w[KRONROD_POINTS] = {
+  0.022935322010529224963732008058970, 0.063092092629978553290700663189204,
+  0.104790010322250183839876322541518, 0.140653259715525918745189590510238,
+  0.169004726639267902826583426598550, 0.190350578064785409913256402421014,
+  0.204432940075298892414161999234649, 0.209482141084727828012999174891714
+};
+
+// Weights of the 7 points Gauss rule, on the odd Kronrod points
+const double gauss_w[KRONROD_POINTS / 2] = {
+  0.129484966168869693270611432679082, 0.279705391489276667901467771423780,
+  0.381830050505118944950369775488975, 0.417959183673469387755102040816327
+};
+
+struct interval {
+  double a;
+  double b;
+  double value;
+  double error;
+};
+
+struct integration {
+  struct program *program;
+  char ends;
+  double a;
+  double b;
+  struct interval *intervals;
+  long *pending;
+  int failed;
+};
+
+/* Get the word used as a function, NULL (with an error) if it can't be */
+struct program *get_function(char *name, char *command) {
+  struct word *w = get_word(name);
+  if (w == NULL) {
+    snprintf(error_buffer, sizeof(error_buffer), "ERROR: Unknown word %s", name);
+    return NULL;
+  }
+  if (!is_scratch_program(w->program) || program_uses_random(w->program)) {
+    snprintf(error_buffer, sizeof(error_buffer), "ERROR: %s can't be used by %s", name, command);
+    return NULL;
+  }
+  return w->program;
+}
+
+/* tol t: set the tolerance of solve and integrate */
+void set_tolerance(char *parameter) {
+  double t = 0;
+  if (!check_input_if_numeric(parameter, &t) || !(t > 0 && t < 1)) {
+    sprintf(error_buffer, "ERROR: The tolerance must be between 0 and 1");
+    return;
+  }
+  tolerance = t;
+}
+
+/* Find a root of f in [a, b] by Brent's method: inverse quadratic
+   interpolation or secant steps, falling back to bisection when they
+   don't shrink the interval enough. NaN (with an error) on failure */
+double brent(struct program *f, double a, double b) {
+  double fa = run_scratch_function(f, a);
+  double fb = run_scratch_function(f, b);
+
+  // Widen the interval until f changes sign
+  for (int i = 0; i < SOLVE_MAX_ITERATIONS && fa * fb > 0 && isfinite(fa) && isfinite(fb); i++) {
+    if (fabs(fa) < fabs(fb)) fa = run_scratch_function(f, a += 1.6 * (a - b));
+    else fb = run_scratch_function(f, b += 1.6 * (b - a));
+  }
+  if (isnan(fa) || isnan(fb)) {
+    sprintf(error_buffer, "ERROR: The function can't be evaluated");
+    return NAN;
+  }
+  if (fa * fb > 0) {
+    sprintf(error_buffer, "ERROR: No sign change found");
+    return NAN;
+  }
+
+  double c = a, fc = fa, d = b - a, e = d;
+  for (int i = 0; i < SOLVE_MAX_ITERATIONS && !job_cancelled(); i++) {
+    if ((fb > 0 && fc > 0) || (fb < 0 && fc < 0)) {
+      c = a;
+      fc = fa;
+      d = e = b - a;
+    }
+    if (fabs(fc) < fabs(fb)) {
+      a = b; b = c; c = a;
+      fa = fb; fb = fc; fc = fa;
+    }
+
+    double tol = 2 * DBL_EPSILON * fabs(b) + 0.5 * tolerance * fmax(1, fabs(b));
+    double middle = 0.5 * (c - b);
+    if (fabs(middle) <= tol || fb == 0) return b;
+
+    if (fabs(e) >= tol && fabs(fa) > fabs(fb)) {
+      double p, q, r, s = fb / fa;
+      if (a == c) {
+        p = 2 * middle * s;
+        q = 1 - s;
+      }
+      else {
+        q = fa / fc;
+        r = fb / fc;
+        p = s * (2 * middle * q * (q - r) - (b - a) * (r - 1));
+        q = (q - 1) * (r - 1) * (s - 1);
+      }
+      if (p > 0) q = -q;
+      p = fabs(p);
+      if (2 * p < fmin(3 * middle * q - fabs(tol * q), fabs(e * q))) {
+        e = d;
+        d = p / q;
+      }
+      else d = e = middle;
+    }
+    else d = e = middle;
+
+    a = b;
+    fa = fb;
+    b += fabs(d) > tol ? d : copysign(tol, middle);
+    fb = run_scratch_function(f, b);
+    if (isnan(fb)) {
+      sprintf(error_buffer, "ERROR: The function can't be evaluated");
+      return NAN;
+    }
+  }
+  return b;
+}
+
+/* solve name: root of the word between y and x */
+void solve(char *parameter) {
+  if (sp < 2) return;
+  struct program *f = get_function(parameter, "solve");
+  if (f == NULL) return;
+
+  double a = to_number(pick(sp - 1)), b = to_number(pick(sp));
+  double r = brent(f, a, b);
+  if (isnan(r) || job_cancelled()) return;
+
+  char name[MAX_INPUT_BUFFER];
+  snprintf(name, sizeof(name), "solve %s", parameter);
+  double x = pop();
+  double y = pop();
+  push(r);
+  log_operation_2o(y, x, name, r);
+}
+
+/* Value of the integrand at t, after the change of variable
+   mapping the infinite ends to finite ones */
+double integrand(struct integration *job, double t) {
+  double u;
+  switch (job->ends) {
+    case '+':   // [a, inf): x = a + t / (1 - t), t in [0, 1)
+      u = 1 / (1 - t);
+      return run_scratch_function(job->program, job->a + t * u) * u * u;
+    case '-':   // (-inf, b]: x = b - (1 - t) / t, t in (0, 1]
+      u = 1 / t;
+      return run_scratch_function(job->program, job->b - (1 - t) * u) * u * u;
+    case '*':   // (-inf, inf): x = t / (1 - t^2), t in (-1, 1)
+      u = 1 / (1 - t * t);
+      return run_scratch_function(job->program, t * u) * (1 + t * t) * u * u;
+    default:
+      return run_scratch_function(job->program, t);
+  }
+}
+
+/* Apply the Gauss-Kronrod rule to an interval. The error estimate
+   is the one of QUADPACK, from the difference with the Gauss rule */
+void gauss_kronrod(struct integration *job, struct interval *in) {
+  double center = 0.5 * (in->a + in->b), half = 0.5 * (in->b - in->a);
+  double f[2 * KRONROD_POINTS - 1];
+
+  for (int i = 0; i < KRONROD_POINTS - 1; i++) {
+    f[2 * i] = integrand(job, center - half * kronrod_x[i]);
+    f[2 * i + 1] = integrand(job, center + half * kronrod_x[i]);
+  }
+  f[2 * KRONROD_POINTS - 2] = integrand(job, center);
+
+  double fc = f[2 * KRONROD_POINTS - 2];
+  double kronrod = fc * kronrod_w[KRONROD_POINTS - 1];
+  double gauss = fc * gauss_w[KRONROD_POINTS / 2 - 1];
+  for (int i = 0; i < KRONROD_POINTS - 1; i++) {
+    double sum = f[2 * i] + f[2 * i + 1];
+    kronrod += kronrod_w[i] * sum;
+    if (i % 2 == 1) gauss += gauss_w[i / 2] * sum;
+  }
+
+  double mean = 0.5 * kronrod, spread = kronrod_w[KRONROD_POINTS - 1] * fabs(fc - mean);
+  for (int i = 0; i < KRONROD_POINTS - 1; i++) {
+    spread += kronrod_w[i] * (fabs(f[2 * i] - mean) + fabs(f[2 * i + 1] - mean));
+  }
+
+  double error = fabs((kronrod - gauss) * half);
+  spread *= fabs(half);
+  if (spread != 0 && error != 0) error = spread * fmin(1, pow(200 * error / spread, 1.5));
+
+  in->value = kronrod * half;
+  in->error = error;
+  if (!isfinite(in->value)) job->failed = 1;
+}
+
+/* Compute the pending intervals [from, to) */
+void integrate_slice(long from, long to, int worker, void *context) {
+  struct integration *job = context;
+  (void) worker;
+  for (long i = from; i < to && !job->failed; i++) gauss_kronrod(job, &job->intervals[job->pending[i]]);
+}
+
+/* Integral of the function from a to b, with its estimated error */
+double integral(struct integration *job, double *error) {
+  double a = job->a, b = job->b;
+  job->ends = isinf(a) && isinf(b) ? '*' : isinf(b) ? '+' : isinf(a) ? '-' : 'f';
+  if (job->ends == '*') { a = -1; b = 1; }
+  if (job->ends == '+') { a = 0; b = 1; }
+  if (job->ends == '-') { a = 0; b = 1; }
+
+  job->intervals = malloc(INTEGRATE_MAX_INTERVALS * sizeof(struct interval));
+  job->pending = malloc(INTEGRATE_MAX_INTERVALS * sizeof(long));
+  if (job->intervals == NULL || job->pending == NULL) {
+    printf("ERROR: You run out of memory. Exiting.");
+    exit(1);
+  }
+
+  long n = 1, n_pending = 1;
+  job->intervals[0] = (struct interval) { .a = a, .b = b };
+  job->pending[0] = 0;
+
+  double value = 0;
+  for (;;) {
+    parallel_for(n_pending, INTEGRATE_PARALLEL_INTERVALS, integrate_slice, job);
+    if (job->failed || job_cancelled()) break;
+
+    value = 0;
+    *error = 0;
+    for (long i = 0; i < n; i++) {
+      value += job->intervals[i].value;
+      *error += job->intervals[i].error;
+    }
+
+    double target = fmax(tolerance, tolerance * fabs(value));
+    if (*error <= target) break;
+
+    // Halve the intervals with more than their share of the error
+    n_pending = 0;
+    for (long i = 0, old_n = n; i < old_n && n < INTEGRATE_MAX_INTERVALS; i++) {
+      struct interval *in = &job->intervals[i];
+      double middle = 0.5 * (in->a + in->b);
+      if (in->error <= target / old_n || middle <= in->a || middle >= in->b) continue;
+      job->intervals[n] = (struct interval) { .a = middle, .b = in->b };
+      in->b = middle;
+      job->pending[n_pending++] = i;
+      job->pending[n_pending++] = n++;
+    }
+    if (n_pending == 0) break;
+    set_job_progress(fmin(1, target / *error));
+  }
+
+  free(job->intervals);
+  free(job->pending);
+  return value;
+}
+
+/* integrate name: integral of the word from y to x,
+   leaving the estimated error in y, like the HP-15C */
+void integrate(char *parameter) {
+  if (sp < 2) return;
+  struct integration job = { .program = get_function(parameter, "integrate") };
+  if (job.program == NULL) return;
+
+  job.a = to_number(pick(sp - 1));
+  job.b = to_number(pick(sp));
+  if (isnan(job.a) || isnan(job.b)) {
+    sprintf(error_buffer, "ERROR: Invalid interval");
+    return;
+  }
+
+  double sign = 1;
+  if (job.a > job.b) {
+    double t = job.a;
+    job.a = job.b;
+    job.b = t;
+    sign = -1;
+  }
+
+  double error = 0;
+  double r = job.a == job.b ? 0 : sign * integral(&job, &error);
+  if (job.failed) {
+    sprintf(error_buffer, "ERROR: The function isn't finite in the interval");
+    return;
+  }
+  if (job_cancelled()) return;
+
+  char name[MAX_INPUT_BUFFER];
+  snprintf(name, sizeof(name), "integrate %s", parameter);
+  double x = pop();
+  double y = pop();
+  push(error);
+  push(r);
+  log_operation_2o(y, x, name, r);
+}
@@ -0,0 +1,363 @@
+// SPDX-License-Identifier: GPL-2.0
+/* luka_sort.c
+ *
+ * A simple RPN calculator for terminal
+ * made with love in Italy.
+ *
+ * Copyright 2025 Davide Mastromatteo
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/* --------------
+   SORT FUNCTIONS
+   -------------- */
+
+/* Arrays are sorted by a LSD radix sort on the bits of the doubles,
+   turned in keys that compare as unsigned integers: the sign bit is
+   flipped for the positive values and all the bits for the negative
+   ones. Every NaN becomes the same positive NaN, so they all end up
+   after +inf. Each pass the workers count the digits of their slice,
+   then move their values to the places given by the counts; a pass is
+   skipped when all the values have the same digit.
+
+   The median and the percentiles don't sort the array: introselect
+   partitions it around a median of three until the element is in
+   place, falling back to the radix sort of what is left when the
+   partitions keep coming out unbalanced. */
+
+#define RADIX_BUCKETS (1 << RADIX_BITS)
+#define SIGN_BIT 0x8000000000000000ULL
+
+struct radix_job {
+  unsigned long long *keys;
+  unsigned long long *next_keys;
+  long *index;
+  long *next_index;
+  int shift;
+  long counts[MAX_WORKERS][RADIX_BUCKETS];
+};
+
+/* Turn a double in a key with the same order */
+unsigned long long sort_key(double x) {
+  if (isnan(x)) x = NAN;
+  unsigned long long bits = double_bits(x);
+  return (bits & SIGN_BIT) ? ~bits : bits ^ SIGN_BIT;
+}
+
+/* Turn a key back in its double */
+double sort_value(unsigned long long key) {
+  unsigned long long bits = (key & SIGN_BIT) ? key ^ SIGN_BIT : ~key;
+  double x;
+  memcpy(&x, &bits, sizeof(x));
+  return x;
+}
+
+/* Count the digits of a slice */
+void radix_count_slice(long from, long to, int worker, void *context) {
+  struct radix_job *job = context;
+  long *counts = job->counts[worker];
+
+  memset(counts, 0, sizeof(job->counts[worker]));
+  for (long i = from; i < to; i++) counts[(job->keys[i] >> job->shift) & (RADIX_BUCKETS - 1)]++;
+}
+
+/* Move the keys of a slice to their places for the next pass */
+void radix_scatter_slice(long from, long to, int worker, void *context) {
+  struct radix_job *job = context;
+  long *places = job->counts[worker];
+
+  for (long i = from; i < to; i++) {
+    long place = places[(job->keys[i] >> job->shift) & (RADIX_BUCKETS - 1)]++;
+    job->next_keys[place] = job->keys[i];
+    if (job->index != NULL) job->next_index[place] = job->index[i];
+  }
+}
+
+/* Sort n keys, moving the indexes (if any) along with them.
+   The sort is stable. Returns 0 if there isn't enough memory */
+int radix_sort(unsigned long long *keys, long *index, long n) {
+  if (n < 2) return 1;
+  struct radix_job *job = malloc(sizeof(struct radix_job));
+  unsigned long long *next_keys = malloc(n * sizeof(unsigned long long));
+  long *next_index = index != NULL ? malloc(n * sizeof(long)) : NULL;
+  if (job == NULL || next_keys == NULL || (index != NULL && next_index == NULL)) {
+    free(job);
+    free(next_keys);
+    free(next_index);
+    return 0;
+  }
+
+  job->keys = keys;
+  job->next_keys = next_keys;
+  job->index = index;
+  job->next_index = next_index;
+
+  for (job->shift = 0; job->shift < 64 && !job_cancelled(); job->shift += RADIX_BITS) {
+    int workers = parallel_for(n, PARALLEL_MIN_LENGTH, radix_count_slice, job);
+
+    // Each worker starts after the values with smaller digits
+    // and after the ones with the same digit in the slices before
+    long place = 0, first_digit = (job->keys[0] >> job->shift) & (RADIX_BUCKETS - 1);
+    long same = 0;
+    for (int w = 0; w < workers; w++) same += job->counts[w][first_digit];
+    if (same == n) continue;
+
+    for (long d = 0; d < RADIX_BUCKETS; d++) {
+      for (int w = 0; w < workers; w++) {
+        long count = job->counts[w][d];
+        job->counts[w][d] = place;
+        place += count;
+      }
+    }
+    parallel_for(n, PARALLEL_MIN_LENGTH, radix_scatter_slice, job);
+
+    unsigned long long *k = job->keys;
+    job->keys = job->next_keys;
+    job->next_keys = k;
+    long *i = job->index;
+    job->index = job->next_index;
+    job->next_index = i;
+    set_job_progress((double) job->shift / 64);
+  }
+
+  if (job->keys != keys) {
+    memcpy(keys, job->keys, n * sizeof(unsigned long long));
+    if (index != NULL) memcpy(index, job->index, n * sizeof(long));
+  }
+
+  free(job->next_keys == keys ? job->keys : job->next_keys);
+  free(job->next_index == index ? job->index : job->next_index);
+  free(job);
+  return 1;
+}
+
+/* Sort n values in place, returns 0 if there isn't enough memory */
+int sort_values(double *x, long n) {
+  if (n < INSERTION_SORT_LENGTH) {
+    for (long i = 1; i < n; i++) {
+      unsigned long long key = sort_key(x[i]);
+      long j = i;
+      for (; j > 0 && sort_key(x[j - 1]) > key; j--) x[j] = x[j - 1];
+      x[j] = sort_value(key);
+    }
+    return 1;
+  }
+
+  unsigned long long *keys = malloc(n * sizeof(unsigned long long));
+  if (keys == NULL) return 0;
+  for (long i = 0; i < n; i++) keys[i] = sort_key(x[i]);
+  int ok = radix_sort(keys, NULL, n);
+  if (ok) for (long i = 0; i < n; i++) x[i] = sort_value(keys[i]);
+  free(keys);
+  return ok;
+}
+
+/* Tell if two values are the same, NaN being equal to NaN */
+int same_value(double x, double y) {
+  return x == y || (isnan(x) && isnan(y));
+}
+
+/* Swap two values */
+void swap_values(double *x, long i, long j) {
+  double t = x[i];
+  x[i] = x[j];
+  x[j] = t;
+}
+
+/* Put the k-th smallest of n values (without NaN) in x[k], with the
+   smaller ones before it and the others after it.
+   Returns 0 if there isn't enough memory */
+int select_value(double *x, long n, long k) {
+  long lo = 0, hi = n - 1;
+  int depth = 0;
+  for (long m = n; m > 1; m /= 2) depth += 2;
+
+  while (hi - lo >= INSERTION_SORT_LENGTH) {
+    if (depth-- == 0) return sort_values(x + lo, hi - lo + 1);
+
+    // Median of three as pivot
+    long mid = lo + (hi - lo) / 2;
+    if (x[mid] < x[lo]) swap_values(x, mid, lo);
+    if (x[hi] < x[lo]) swap_values(x, hi, lo);
+    if (x[hi] < x[mid]) swap_values(x, hi, mid);
+    double pivot = x[mid];
+
+    // Three way partition: [lo, lt) < pivot, [lt, gt] = pivot, (gt, hi] > pivot
+    long lt = lo, gt = hi, i = lo;
+    while (i <= gt) {
+      if (x[i] < pivot) swap_values(x, lt++, i++);
+      else if (x[i] > pivot) swap_values(x, i, gt--);
+      else i++;
+    }
+
+    if (k < lt) hi = lt - 1;
+    else if (k > gt) lo = gt + 1;
+    else return 1;
+  }
+  return sort_values(x + lo, hi - lo + 1);
+}
+
+/* Get a copy of the values of the sequence at the top of the stack,
+   that can be changed, NULL (with an error) on failure */
+struct buffer *sort_operand(char *name) {
+  struct sequence *s = sequence_operand(name);
+  if (s == NULL) return NULL;
+
+  struct buffer *b = sequence_collect(s);
+  if (b == NULL || b->references == 1) return b;
+
+  struct buffer *copy = buffer_new(b->length);
+  if (copy == NULL) sprintf(error_buffer, "ERROR: The array doesn't fit in memory");
+  else memcpy(copy->data, b->data, b->length * sizeof(double));
+  buffer_release(b);
+  return copy;
+}
+
+/* Replace the sequence at the top of the stack with an array */
+void replace_sequence(struct buffer *b, char *name) {
+  if (job_cancelled()) {
+    buffer_release(b);
+    return;
+  }
+  double r = make_array(b);
+  double x = pop();
+  push(r);
+  log_operation_1o(x, name, r);
+}
+
+/* sort: sort an array, the NaN at the end */
+void sort_array(void) {
+  struct buffer *b = sort_operand("sort");
+  if (b == NULL) return;
+  if (!sort_values(b->data, b->length)) {
+    sprintf(error_buffer, "ERROR: The array doesn't fit in memory");
+    buffer_release(b);
+    return;
+  }
+  replace_sequence(b, "sort");
+}
+
+/* Percentile p of the values of an array without NaN, interpolating
+   between the two closest ones. NaN (with an error) on failure */
+double percentile(struct buffer *b, double p) {
+  long n = 0;
+  for (long i = 0; i < b->length; i++) {
+    if (!isnan(b->data[i])) b->data[n++] = b->data[i];
+  }
+  if (n == 0) {
+    sprintf(error_buffer, "ERROR: There are no values");
+    return NAN;
+  }
+
+  double position = p / 100 * (n - 1);
+  long k = (long) floor(position);
+  if (!select_value(b->data, n, k)) {
+    sprintf(error_buffer, "ERROR: The array doesn't fit in memory");
+    return NAN;
+  }
+  double r = b->data[k];
+  if (position > k) {
+    double next = b->data[k + 1];
+    for (long i = k + 2; i < n; i++) if (b->data[i] < next) next = b->data[i];
+    r += (position - k) * (next - r);
+  }
+  return r;
+}
+
+/* Replace the array with one of its percentiles */
+void compute_percentile(double p, char *name) {
+  struct buffer *b = sort_operand(name);
+  if (b == NULL) return;
+  double r = percentile(b, p);
+  buffer_release(b);
+  if (error_buffer[0] != '\0' || job_cancelled()) return;
+
+  double x = pop();
+  push(r);
+  log_operation_1o(x, name, r);
+}
+
+/* median: middle value of an array, ignoring the NaN */
+void compute_median(void) {
+  compute_percentile(50, "median");
+}
+
+/* pct p: p-th percentile of an array, ignoring the NaN */
+void compute_pct(char *parameter) {
+  char *end;
+  double p = strtod(parameter, &end);
+  if (end == parameter || *end != '\0' || !(p >= 0 && p <= 100)) {
+    sprintf(error_buffer, "ERROR: The percentile has to be between 0 and 100");
+    return;
+  }
+  char name[MAX_INPUT_BUFFER];
+  snprintf(name, sizeof(name), "pct %s", parameter);
+  compute_percentile(p, name);
+}
+
+/* rank: position of each value in the sorted array, from 1,
+   ties getting the mean of their positions and NaN staying NaN */
+void rank_array(void) {
+  struct buffer *b = sort_operand("rank");
+  if (b == NULL) return;
+
+  long n = b->length;
+  unsigned long long *keys = malloc(n * sizeof(unsigned long long) + 1);
+  long *index = malloc(n * sizeof(long) + 1);
+  int ok = keys != NULL && index != NULL;
+  if (ok) {
+    for (long i = 0; i < n; i++) {
+      keys[i] = sort_key(b->data[i]);
+      index[i] = i;
+    }
+    ok = radix_sort(keys, index, n);
+  }
+  if (!ok) {
+    sprintf(error_buffer, "ERROR: The array doesn't fit in memory");
+    free(keys);
+    free(index);
+    buffer_release(b);
+    return;
+  }
+
+  for (long i = 0; i < n;) {
+    long j = i + 1;
+    while (j < n && same_value(sort_value(keys[j]), sort_value(keys[i]))) j++;
+    double r = isnan(sort_value(keys[i])) ? NAN : (i + j + 1) / 2.0;
+    for (; i < j; i++) b->data[index[i]] = r;
+  }
+
+  free(keys);
+  free(index);
+  replace_sequence(b, "rank");
+}
+
+/* uniq: the different values of an array, sorted */
+void unique_array(void) {
+  struct buffer *b = sort_operand("uniq");
+  if (b == NULL) return;
+  if (!sort_values(b->data, b->length)) {
+    sprintf(error_buffer, "ERROR: The array doesn't fit in memory");
+    buffer_release(b);
+    return;
+  }
+
+  long n = 0;
+  for (long i = 0; i < b->length; i++) {
+    if (n == 0 || !same_value(b->data[i], b->data[n - 1])) b->data[n++] = b->data[i];
+  }
+  b->length = n;
+  replace_sequence(b, "uniq");
+}
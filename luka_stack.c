@@ -21,6 +21,10 @@
  */
 
 void locate(int, int);
+void journal_record(char, int, double, double, char*);
+void rotate_stack_left(int);
+void rotate_stack_right(int);
+void swap_stack(int);
 
 /* ---------------
    STACK FUNCTIONS
@@ -42,6 +46,7 @@ double pop(void) {
   }
 
   double result = pick(sp);
+  journal_record('o', sp, 0, 0, NULL);
   sp--;
   return result;
 }
@@ -63,34 +68,33 @@ void push(double val) {
       }
 
       // The stack need to be resized
-      int new_stack_length = current_stack_length + INCREMENT_STACK_STEP;
+      int new_stack_length = current_stack_length * 2;
       if (new_stack_length > MAX_STACK_LENGTH) new_stack_length = MAX_STACK_LENGTH;
 
-      stack = realloc(stack, (new_stack_length) * sizeof(double));
-      if (stack == NULL) {
-        printf("ERROR: You run out of memory. Exiting.");
-        exit(1);
-      }
+      stack = arena_realloc(ARENA_STACK, stack, (new_stack_length) * sizeof(double));
+      memset(stack + current_stack_length, 0, (new_stack_length - current_stack_length) * sizeof(double));
       current_stack_length = new_stack_length;
     }
 
+    journal_record('u', sp, ((double*) stack)[sp], val, NULL);
     ((double*) stack)[sp] = val;
     sp++;
 }
 
-/* Clear the stack */
+/* Clear the stack.
+   The values are left in the buffer, so the
+   clear can be undone without copying them back */
 void clear(void) {
+  if (sp == 0) return;
+  journal_record('c', sp, 0, 0, NULL);
   sp = 0;
-  ((double*) stack)[sp] = 0;
 }
 
 /* Swap the x and y register */
 void swap(void) {
   if (sp<2) return;
-  double x = pop();
-  double y = pop();
-  push(x);
-  push(y);
+  swap_stack(sp);
+  journal_record('s', sp, 0, 0, NULL);
 }
 
 /* roll the entire stack to the left: the third item become the second, 
@@ -98,10 +102,8 @@ void swap(void) {
    become the last */
 void lroll(void) {
   if (sp == 0) return;
-  double first_value = pick(1); 
-
-  for (int i=0; i<((sp) - 1); i++) stack[i] = stack[i+1];
-  stack[sp - 1] = first_value;
+  rotate_stack_left(sp);
+  journal_record('l', sp, 0, 0, NULL);
 }
 
 /* roll the entire stack to the right: the first item become the second, 
@@ -109,8 +111,6 @@ void lroll(void) {
    become the first */
 void rroll(void) {
   if (sp == 0) return;
-  double last_value = pick(sp);
-
-  for (int i=(sp - 1); i>0; i--) stack[i] = stack[i-1];
-  stack[0] = last_value;
+  rotate_stack_right(sp);
+  journal_record('r', sp, 0, 0, NULL);
 }
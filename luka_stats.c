@@ -0,0 +1,148 @@
+// SPDX-License-Identifier: GPL-2.0
+/* luka_stats.c
+ *
+ * A simple RPN calculator for terminal
+ * made with love in Italy.
+ *
+ * Copyright 2025 Davide Mastromatteo
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/* --------------------
+   STATISTICS FUNCTIONS
+   -------------------- */
+
+/* The statistics registers work like the HP calculators ones:
+   Σ+ accumulates the pair (x, y) taken from the stack, Σ- removes it.
+   Nothing is kept but a handful of running accumulators updated with
+   the Welford algorithm, so every update is O(1) and the memory used
+   doesn't depend on the number of samples collected. Every change
+   records the previous registers in the journal, so undo and the
+   rollback of a cancelled command bring them back too. */
+
+/* Add the pair (x, y) to the statistics registers */
+void statistics_add(double x, double y) {
+  statistics.n++;
+
+  double dx = x - statistics.mean_x;
+  statistics.mean_x += dx / statistics.n;
+  double dy = y - statistics.mean_y;
+  statistics.mean_y += dy / statistics.n;
+
+  statistics.m2_x += dx * (x - statistics.mean_x);
+  statistics.m2_y += dy * (y - statistics.mean_y);
+  statistics.c_xy += dx * (y - statistics.mean_y);
+
+  if (statistics.n == 1 || x < statistics.min_x) statistics.min_x = x;
+  if (statistics.n == 1 || x > statistics.max_x) statistics.max_x = x;
+}
+
+/* Remove the pair (x, y) from the statistics registers.
+   Min and max can't be rolled back without the samples,
+   so they are left untouched like the HP calculators do */
+void statistics_remove(double x, double y) {
+  if (statistics.n <= 1) {
+    memset(&statistics, 0, sizeof(statistics));
+    return;
+  }
+
+  int n = statistics.n - 1;
+  double old_mean_x = statistics.mean_x - (x - statistics.mean_x) / n;
+  double old_mean_y = statistics.mean_y - (y - statistics.mean_y) / n;
+
+  statistics.m2_x -= (x - old_mean_x) * (x - statistics.mean_x);
+  statistics.m2_y -= (y - old_mean_y) * (y - statistics.mean_y);
+  statistics.c_xy -= (x - old_mean_x) * (y - statistics.mean_y);
+
+  statistics.mean_x = old_mean_x;
+  statistics.mean_y = old_mean_y;
+  statistics.n = n;
+}
+
+/* Σ+: accumulate x (and y) and drop x from the stack */
+void sigma_plus(void) {
+  if (sp < 1) return;
+  double y = to_number(pick(sp - 1));
+  double x = to_number(pop());
+  journal_record_statistics();
+  statistics_add(x, y);
+  log_operation_1o(x, "Σ+", statistics.n);
+}
+
+/* Σ-: remove x (and y) from the accumulators and drop x from the stack */
+void sigma_minus(void) {
+  if (sp < 1) return;
+  if (statistics.n == 0) {
+    sprintf(error_buffer, "ERROR: The statistics registers are empty");
+    return;
+  }
+  double y = to_number(pick(sp - 1));
+  double x = to_number(pop());
+  journal_record_statistics();
+  statistics_remove(x, y);
+  log_operation_1o(x, "Σ-", statistics.n);
+}
+
+/* Clear the statistics registers */
+void sigma_clear(void) {
+  journal_record_statistics();
+  memset(&statistics, 0, sizeof(statistics));
+}
+
+/* Check that enough samples have been collected */
+int statistics_check(int min_samples) {
+  if (statistics.n < min_samples) {
+    sprintf(error_buffer, "ERROR: At least %d samples are needed", min_samples);
+    return 0;
+  }
+  return 1;
+}
+
+/* Push the mean of y and the mean of x */
+void push_mean(void) {
+  if (!statistics_check(1)) return;
+  push(statistics.mean_y);
+  push(statistics.mean_x);
+}
+
+/* Push the sample standard deviation of y and of x */
+void push_standard_deviation(void) {
+  if (!statistics_check(2)) return;
+  push(sqrt(statistics.m2_y / (statistics.n - 1)));
+  push(sqrt(statistics.m2_x / (statistics.n - 1)));
+}
+
+/* Push the slope and the intercept of the
+   linear regression y = slope * x + intercept */
+void push_linear_regression(void) {
+  if (!statistics_check(2)) return;
+  if (statistics.m2_x == 0) {
+    sprintf(error_buffer, "ERROR: All the x samples are equal");
+    return;
+  }
+  double slope = statistics.c_xy / statistics.m2_x;
+  push(slope);
+  push(statistics.mean_y - slope * statistics.mean_x);
+}
+
+/* Push the correlation coefficient between x and y */
+void push_correlation(void) {
+  if (!statistics_check(2)) return;
+  if (statistics.m2_x == 0 || statistics.m2_y == 0) {
+    sprintf(error_buffer, "ERROR: The correlation is undefined for constant samples");
+    return;
+  }
+  push(statistics.c_xy / sqrt(statistics.m2_x * statistics.m2_y));
+}
@@ -0,0 +1,194 @@
+// SPDX-License-Identifier: GPL-2.0
+/* luka_stream.c
+ *
+ * A simple RPN calculator for terminal
+ * made with love in Italy.
+ *
+ * Copyright 2025 Davide Mastromatteo
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+/* ----------------
+   STREAM FUNCTIONS
+   ---------------- */
+
+/* With --stream=N luka doesn't show the calculator: it reads numbers
+   from the standard input and, for each one, writes the moving
+   average, the exponential moving average, the minimum, the maximum
+   and the standard deviation of the last N numbers.
+
+   Every number costs O(1) and the memory doesn't grow: the last N
+   numbers are kept in a ring, the mean and the squared deviations are
+   updated Welford style, adding the new number and taking out the one
+   leaving the window, and the minimum and the maximum come from
+   monotonic deques of the numbers that may still become the minimum
+   (or the maximum) before they leave the window. The EMA uses
+   alpha = 2 / (N + 1), like a moving average of N numbers.
+
+   The input is read in blocks, and the output is flushed after every
+   block, so a live feed is answered as soon as each chunk arrives. */
+
+struct rolling_window {
+  long length;
+  long n;
+  double *values;
+  long *min;
+  long *max;
+  long min_head, min_tail;
+  long max_head, max_tail;
+  double mean;
+  double m2;
+  double ema;
+  double alpha;
+};
+
+/* Create a window of the last length numbers */
+struct rolling_window *rolling_window_new(long length) {
+  struct rolling_window *w = calloc(1, sizeof(struct rolling_window));
+  if (w != NULL) {
+    w->values = malloc(length * sizeof(double));
+    w->min = malloc(length * sizeof(long));
+    w->max = malloc(length * sizeof(long));
+  }
+  if (w == NULL || w->values == NULL || w->min == NULL || w->max == NULL) {
+    printf("ERROR: You run out of memory. Exiting.");
+    exit(1);
+  }
+  w->length = length;
+  w->alpha = 2.0 / (length + 1);
+  return w;
+}
+
+void rolling_window_free(struct rolling_window *w) {
+  free(w->values);
+  free(w->min);
+  free(w->max);
+  free(w);
+}
+
+/* Value of the i-th number of the stream, still in the window */
+static inline double rolling_value(struct rolling_window *w, long i) {
+  return w->values[i % w->length];
+}
+
+/* Add the i-th number to a monotonic deque, whose front is the
+   minimum (or the maximum, with sign -1) of the window */
+static inline void rolling_deque_push(struct rolling_window *w, long *deque, long *head, long *tail, long i, double sign) {
+  double x = rolling_value(w, i);
+  if (*tail > *head && deque[*head % w->length] <= i - w->length) (*head)++;
+  while (*tail > *head && sign * rolling_value(w, deque[(*tail - 1) % w->length]) >= sign * x) (*tail)--;
+  deque[(*tail)++ % w->length] = i;
+}
+
+/* Add a number to the window, dropping the oldest one when it's full */
+void rolling_window_add(struct rolling_window *w, double x) {
+  long i = w->n++;
+
+  if (i < w->length) {
+    double delta = x - w->mean;
+    w->mean += delta / (i + 1);
+    w->m2 += delta * (x - w->mean);
+    w->ema = i == 0 ? x : w->ema + w->alpha * (x - w->ema);
+  } else {
+    double old = rolling_value(w, i);
+    double mean = w->mean + (x - old) / w->length;
+    w->m2 += (x - old) * (x - mean + old - w->mean);
+    if (w->m2 < 0) w->m2 = 0;
+    w->mean = mean;
+    w->ema += w->alpha * (x - w->ema);
+  }
+  w->values[i % w->length] = x;
+
+  rolling_deque_push(w, w->min, &w->min_head, &w->min_tail, i, 1);
+  rolling_deque_push(w, w->max, &w->max_head, &w->max_tail, i, -1);
+}
+
+/* Write the statistics of the window after its last number */
+void rolling_window_print(struct rolling_window *w, double x) {
+  long count = w->n < w->length ? w->n : w->length;
+  double sdev = count > 1 ? sqrt(w->m2 / (count - 1)) : 0;
+  double min = rolling_value(w, w->min[w->min_head % w->length]);
+  double max = rolling_value(w, w->max[w->max_head % w->length]);
+
+  if (numeric_format == 'f') printf("%lf\t%lf\t%lf\t%lf\t%lf\t%lf\n", x, w->mean, w->ema, min, max, sdev);
+  else printf("%.10lg\t%.10lg\t%.10lg\t%.10lg\t%.10lg\t%.10lg\n", x, w->mean, w->ema, min, max, sdev);
+}
+
+/* Feed the numbers of a line to the window: numbers are separated by
+   spaces, tabs, commas or semicolons, anything else is skipped */
+void stream_line(struct rolling_window *w, char *line) {
+  char *p = line;
+  for (;;) {
+    p += strspn(p, " \t\r,;");
+    if (*p == '\0') return;
+
+    char *end;
+    double x = strtod(p, &end);
+    if (end == p || !isfinite(x)) {
+      p += strcspn(p, " \t\r,;");
+      continue;
+    }
+    p = end;
+    rolling_window_add(w, x);
+    rolling_window_print(w, x);
+  }
+}
+
+/* Run the stream mode until the end of the input */
+int run_stream(long length) {
+  struct rolling_window *w = rolling_window_new(length);
+  char *buffer = malloc(STREAM_BUFFER_LENGTH + 1);
+  if (buffer == NULL) {
+    printf("ERROR: You run out of memory. Exiting.");
+    exit(1);
+  }
+
+  printf("# x\tmean\tema\tmin\tmax\tsdev\n");
+  fflush(stdout);
+
+  long used = 0;
+  for (;;) {
+    ssize_t n = read(STDIN_FILENO, buffer + used, STREAM_BUFFER_LENGTH - used);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) break;
+    used += n;
+
+    // Every whole line, or the whole buffer if a line doesn't fit it
+    char *line = buffer, *newline;
+    while ((newline = memchr(line, '\n', buffer + used - line)) != NULL) {
+      *newline = '\0';
+      stream_line(w, line);
+      line = newline + 1;
+    }
+    if (line == buffer && used == STREAM_BUFFER_LENGTH) {
+      buffer[used] = '\0';
+      stream_line(w, buffer);
+      line = buffer + used;
+    }
+    used = buffer + used - line;
+    memmove(buffer, line, used);
+    fflush(stdout);
+  }
+
+  if (used > 0) {
+    buffer[used] = '\0';
+    stream_line(w, buffer);
+  }
+  fflush(stdout);
+  free(buffer);
+  rolling_window_free(w);
+  return 0;
+}
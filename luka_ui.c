@@ -43,12 +43,19 @@ void show_command_line_help(void) {
     printf("  -r, --rad          Set angle mode to radians (default)\n");
     printf("  -s, --sci          Use scientific notation for numbers (default)\n");
     printf("  -f, --fix          Use fixed-point notation for numbers\n");
+    printf("  -j, --journal=N    Keep up to N stack changes for undo/redo\n");
+    printf("  -b, --budget=SECS  Cancel any command running longer than SECS\n");
+    printf("  -S, --shared=NAME  Share the @ registers with the other luka of NAME\n");
+    printf("  -n, --norc         Don't run ~/.lukarc at start\n");
+    printf("  -w, --stream=N     Read numbers from the input and write the moving\n");
+    printf("                     mean, EMA, min, max and sdev of the last N\n");
     printf("  -V, --version      Show version information and exit\n");
     printf("  -h, --help         Display this help message and exit\n\n");
 
     printf("Examples:\n");
     printf("  luka --deg --fix     Start in degrees mode with fixed-point display\n");
-    printf("  luka -s              Start with scientific display mode\n\n");
+    printf("  luka -s              Start with scientific display mode\n");
+    printf("  luka -w 100 < feed   Moving statistics of the last 100 numbers of feed\n\n");
 
     printf("This is free software released under the GNU GPL v2.\n");
     printf("Made with love in Italy by Davide Mastromatteo\n");
@@ -69,20 +76,101 @@ void show_license_message(void) {
   printf("Check the license at https://www.gnu.org/licenses/old-licenses/gpl-2.0.html\n");
   printf("\n");
   printf("press ENTER to continue\n");
-  getchar();
+  wait_for_enter();
 }
 
-/* Show the memories panel */
+/* Show the bytes held by each subsystem of the session */
+void show_memory_usage(void) {
+  int live_objects = 0;
+  for (int i = 0; i < objects_length; i++) live_objects += objects[i].class != NULL;
+
+  printf("\x1B[1;1H\x1B[2J");
+  printf("Memory in use\n\n");
+  for (int s = 0; s < ARENA_SUBSYSTEMS; s++) {
+    printf("  %-10s %10ld bytes", arena_subsystem_names[s], arena_live[s]);
+    if (s == ARENA_HISTORY) printf("   %d entries", n_operation_log);
+    if (s == ARENA_MEMORIES) printf("   %d memories", n_memories);
+    if (s == ARENA_OBJECTS) printf("   %d live objects", live_objects);
+    if (s == ARENA_WORDS) printf("   %d words", n_words);
+    printf("\n");
+  }
+  printf("\n  pools      %10ld bytes in %ld chunks, %ld in use\n",
+         arena_chunks * ARENA_CHUNK_BYTES, arena_chunks, arena_pooled);
+  printf("\nMemoized operations\n\n");
+  for (int i = 0; i < MEMO_CACHES; i++) {
+    printf("  %-10s %10ld hits %10ld misses\n", memo_caches[i].name, memo_caches[i].hits, memo_caches[i].misses);
+  }
+  printf("\n");
+  printf("press ENTER to continue\n");
+  wait_for_enter();
+}
+
+/* Show the whole value of x, with all the digits of a big integer,
+   on a screen of its own where it can be copied */
+void show_value(void) {
+  if (sp < 1) return;
+
+  printf("\x1B[1;1H\x1B[2J");
+  struct bigint *b = get_object_data(pick(sp), &bigint_class);
+  if (b != NULL) {
+    char *digits = malloc((b->length + 1) * 10 + 2);
+    if (digits == NULL) {
+      printf("ERROR: You run out of memory. Exiting.");
+      exit(1);
+    }
+    bigint_to_string(b, digits);
+    printf("x, %d digits\n\n%s\n\n", (int) strlen(digits) - (b->sign < 0), digits);
+    free(digits);
+  }
+  else {
+    char buffer[MAX_INPUT_BUFFER * 4];
+    format_value(buffer, sizeof(buffer), pick(sp));
+    printf("x\n\n%s\n\n", buffer);
+  }
+  printf("press ENTER to continue\n");
+  wait_for_enter();
+}
+
+/* Show the statistics registers next to the memories */
+void show_statistics(void) {
+  if (statistics.n == 0) return;
+
+  int row = 5;
+  locate (64, 4);
+  printf("─────STATS─────");
+  locate (64, row++);
+  printf("n    %d", statistics.n);
+  locate (64, row++);
+  printf("x̄    %lg", statistics.mean_x);
+  if (statistics.n > 1) {
+    locate (64, row++);
+    printf("sx   %lg", sqrt(statistics.m2_x / (statistics.n - 1)));
+  }
+  locate (64, row++);
+  printf("min  %lg", statistics.min_x);
+  locate (64, row++);
+  printf("max  %lg", statistics.max_x);
+  locate (64, row++);
+  printf("ȳ    %lg", statistics.mean_y);
+  if (statistics.n > 1 && statistics.m2_x > 0 && statistics.m2_y > 0) {
+    locate (64, row++);
+    printf("r    %lg", statistics.c_xy / sqrt(statistics.m2_x * statistics.m2_y));
+  }
+}
+
+/* Show the memories panel, the shared registers after the memories */
 void show_memories(void) {
   int k = 0;
   locate (40, 4);
   printf("──────MEMORY─────\n");
 
-  int begin = (n_memories - MEMORY_MAX_VIEWABLE_ELEMENTS - memory_view_offset) > 0 ? n_memories - MEMORY_MAX_VIEWABLE_ELEMENTS - memory_view_offset: 0;
+  refresh_shared_view();
+  int n = n_memories + (shared_segment != NULL ? shared_view.n : 0);
+  int begin = (n - MEMORY_MAX_VIEWABLE_ELEMENTS - memory_view_offset) > 0 ? n - MEMORY_MAX_VIEWABLE_ELEMENTS - memory_view_offset: 0;
   int end = (begin + MEMORY_MAX_VIEWABLE_ELEMENTS);
 
-  if ((end + memory_view_offset > n_memories) && (memory_view_offset > 0)) memory_view_offset--;
-  if (end > n_memories) end = n_memories;
+  if ((end + memory_view_offset > n) && (memory_view_offset > 0)) memory_view_offset--;
+  if (end > n) end = n;
 
   if (begin > 0) {
     locate (41, 4);
@@ -90,16 +178,31 @@ void show_memories(void) {
   }
 
   for (int i = begin; i < end; i++) {
+    if (i >= n_memories) {
+      int j = i - n_memories;
+      locate (40, (5 + (k++)));
+      if (numeric_format == 's') printf("@%s - %lg", shared_view.names[j], shared_view.values[j]);
+      if (numeric_format == 'f') printf("@%s - %lf", shared_view.names[j], shared_view.values[j]);
+      continue;
+    }
     if (strcmp(memories[i], "") == 0) continue;
     locate (40, (5 + (k++)));
+    if (is_object(values[i])) {
+      char value[26];
+      format_value(value, sizeof(value), values[i]);
+      printf("%s - %s", memories[i], value);
+      continue;
+    }
     if (numeric_format == 's') printf("%s - %lg", memories[i], values[i]);    
     if (numeric_format == 'f') printf("%s - %lf", memories[i], values[i]);    
   }
 
-  if (end < n_memories) {
+  if (end < n) {
     locate (41, (6 + k - 1));
     printf("⇣");    
   } 
+
+  show_statistics();
 }
 
 
@@ -135,9 +238,84 @@ void show_history(void) {
 }
 
 
+/* Set the dot (column, row) of a braille plot: each character is a
+   cell of 2 x 4 dots, numbered as in the Unicode braille block */
+void plot_dot(unsigned char cells[PLOT_HEIGHT][PLOT_WIDTH], int column, int row) {
+  static const unsigned char bits[4][2] = { {0x01, 0x08}, {0x02, 0x10}, {0x04, 0x20}, {0x40, 0x80} };
+  if (row < 0 || row >= PLOT_HEIGHT * 4) return;
+  cells[row / 4][column / 2] |= bits[row % 4][column % 2];
+}
+
+/* Show the plot panel. A dot column covers PLOT_OVERSAMPLING samples
+   and is drawn from the lowest to the highest of them, so steep parts
+   stay connected; y = 0 is dotted when it's in sight */
+void show_plot(void) {
+  struct plot *p = &plot_view;
+  unsigned char cells[PLOT_HEIGHT][PLOT_WIDTH] = { { 0 } };
+  int rows = PLOT_HEIGHT * 4;
+
+  locate (40, 4);
+  printf("──────PLOT %.20s─────\n", p->name);
+
+  double lo = INFINITY, hi = -INFINITY;
+  for (int i = 0; i <= PLOT_SAMPLES; i++) {
+    if (!isfinite(p->samples[i])) continue;
+    if (p->samples[i] < lo) lo = p->samples[i];
+    if (p->samples[i] > hi) hi = p->samples[i];
+  }
+  double a = p->center - PLOT_SAMPLES / 2 * p->step, b = p->center + PLOT_SAMPLES / 2 * p->step;
+
+  // An end at 0 may come out as a rounding error of the center
+  if (fabs(a) < 1e-9 * p->step) a = 0;
+  if (fabs(b) < 1e-9 * p->step) b = 0;
+  if (lo > hi) {
+    locate (40, 5);
+    printf("No finite values in %lg..%lg", a, b);
+    return;
+  }
+  double top = hi, bottom = lo;
+  if (top == bottom) {
+    top += 1;
+    bottom -= 1;
+  }
+  double scale = (rows - 1) / (top - bottom);
+
+  if (bottom <= 0 && top >= 0) {
+    int row = (int) lround(top * scale);
+    for (int c = 0; c < PLOT_WIDTH * 2; c += 2) plot_dot(cells, c, row);
+  }
+
+  for (int c = 0; c < PLOT_WIDTH * 2; c++) {
+    double column_lo = INFINITY, column_hi = -INFINITY;
+    for (int i = c * PLOT_OVERSAMPLING; i <= (c + 1) * PLOT_OVERSAMPLING; i++) {
+      if (!isfinite(p->samples[i])) continue;
+      if (p->samples[i] < column_lo) column_lo = p->samples[i];
+      if (p->samples[i] > column_hi) column_hi = p->samples[i];
+    }
+    if (column_lo > column_hi) continue;
+    int first = (int) lround((top - column_hi) * scale), last = (int) lround((top - column_lo) * scale);
+    for (int row = first; row <= last; row++) plot_dot(cells, c, row);
+  }
+
+  // U+2800 + bits, in UTF-8
+  for (int r = 0; r < PLOT_HEIGHT; r++) {
+    locate (40, 5 + r);
+    for (int c = 0; c < PLOT_WIDTH; c++) printf("%c%c%c", 0xE2, 0xA0 | (cells[r][c] >> 6), 0x80 | (cells[r][c] & 0x3F));
+  }
+  locate (40, 5 + PLOT_HEIGHT);
+  printf("x %.4lg..%.4lg  y %.4lg..%.4lg", a, b, lo, hi);
+}
+
 /* Print a nicely formatted value of the stack
    depending on the numeric_format set */
 void print_stack_value(char* buffer, double number) {
+  if (is_object(number)) {
+    char value[26];
+    format_value(value, sizeof(value), number);
+    printf("│ %s │ %25s│\n", buffer, value);
+    return;
+  }
+
   double abs_number = number < 0 ? number * -1 : number; 
   if ((abs_number >= 1e10) || (abs_number > 0 && abs_number < 1e-6)) {
     printf("│ %s │ %25.15e│\n", buffer, number);
@@ -161,16 +339,22 @@ void show_rpn_modes(void) {
   if (numeric_format == 'f') strcpy(numeric_format_string, "fix");
   if (numeric_format == 's') strcpy(numeric_format_string, "sci");
 
-  printf("┌─────┬─────┐ \n");	
-  printf("│ %s │ %s │ \n", mode_string, numeric_format_string);
-  printf("└─────┴─────┘ \n");	
+  char arithmetic_mode_string[] = "err";
+  if (arithmetic_mode == 'd') strcpy(arithmetic_mode_string, "dbl");
+  if (arithmetic_mode == 'b') strcpy(arithmetic_mode_string, "big");
+  if (arithmetic_mode == 'q') strcpy(arithmetic_mode_string, " dd");
+  if (arithmetic_mode == 'k') strcpy(arithmetic_mode_string, "dec");
+
+  printf("┌─────┬─────┬─────┐ \n");	
+  printf("│ %s │ %s │ %s │ \n", mode_string, numeric_format_string, arithmetic_mode_string);
+  printf("└─────┴─────┴─────┘ \n");	
 }
 
 /* Shows the calculator Stack */
 void show_stack(void) {
   printf("┌────┬──────────STACK───────────┐\n");
 
-  char buffer[3];
+  char buffer[12];
 
   int start = 0;
   if (sp > MAX_VIEWABLE_STACK) {
@@ -193,6 +377,10 @@ void show_lateral_panel(void) {
   switch (history_mode) {
     case 'l':show_history(); break;
     case 'm':show_memories(); break;
+    case 'p':
+      if (plot_view.program != NULL) show_plot();
+      else show_history();
+      break;
   }
 }
 
@@ -233,7 +421,7 @@ void show_credits(void) {
   printf("Check the license at https://www.gnu.org/licenses/old-licenses/gpl-2.0.html\n");
   printf("\n\n");
   printf("press ENTER to continue\n");
-  getchar();
+  wait_for_enter();
 }
 
 /* Shows the help screen */
@@ -245,23 +433,42 @@ void show_help(void) {
     printf(" Basic Ops:     +  -  *  /  ^\n");
     printf(" Stack Ops:     d(drop)   s(swap)   c(clear)\n");
     printf(" Rotate Stack:  roll      unroll    ← → (keys)\n");
-    printf(" Stack View:    ↑ ↓ (view history/memory)\n\n");
+    printf(" Stack View:    ↑ ↓ (view history/memory)\n");
+    printf(" Undo/Redo:     u(undo)   r(redo)\n\n");
 
     printf(" Functions:\n");
-    printf("  sqrt  log  ln  log10  ! (factorial)  \\ (recip)\n");
+    printf("  sqrt  exp  log  ln  log10  ! (factorial)  \\ (recip)\n");
     printf("  sin  cos  tan  asin  acos  atan\n\n");
-    printf(" Modes: deg / rad       Format: fix / sci\n\n");
-
-    printf(" Constants:     pi   e   rnd (random)\n");
-    printf(" Memory:        store [name]   load [name]   del [name]\n\n");
+    printf("  mod (remainder)\n\n");
+    printf(" Modes: deg / rad       Format: fix / sci\n");
+    printf(" Arithmetic:    dbl (doubles)   big (exact big integers)   dd (32 digits)   dec [k] (k places)\n\n");
+
+    printf(" Constants:     pi   e   rnd (random)   rndn (normal)\n");
+    printf(" Random:        runif  rnorm  seed [n]  mc [w]\n");
+    printf(" Memory:        store [name]   load [name]   del [name]   (@name: shared)\n");
+    printf(" Time budget:   budget [seconds]  (Esc/Ctrl-C cancel a command)\n");
+    printf(" Statistics:    Σ+ (s+)  Σ- (s-)  sclr  mean  sdev  lr  corr\n");
+    printf(" Words:         : name body ;  (e.g. : vat 1.22 * ;)\n");
+    printf(" Control:       < > <= >= == !=   n times .. loop   n 0 do i .. loop   if .. else .. then\n");
+    printf(" Infix:         (3+4)*sin(x)   (names load memories)\n");
+    printf(" Solve:         solve [w]  integrate [w]  tol [t]\n");
+    printf(" Plot:          tabulate [w]  plot [w]  (↑ ↓ zoom)\n");
+    printf(" Sequences:     range  array  aload [file]  map [w]  filter [w]  sum prod min max len\n");
+    printf(" Scans:         cumsum  cumprod  cummax  cummin  diff\n");
+    printf(" Sorting:       sort  median  pct [p]  rank  uniq\n");
+    printf(" Matrices:      matrix  mload [file]  eye  inv  det  trn\n");
+    printf(" FFT:           fft  ifft  conv  psd\n");
+    printf(" Polynomials:   poly  peval  proots  (+ - * / mod ^)\n\n");
 
     printf(" Commands:\n");
     printf("  ENTER      Repeat last input\n");
     printf("  h/help     Show this help screen\n");
+    printf("  mem        Show the memory used by the session\n");
+    printf("  show       Show x in full (all the digits of a big integer)\n");
     printf("  ?          Show credits and license\n");
     printf("  q/quit     Exit program\n");
 
     printf("──────────────────────────────────────────────────────\n");
     printf(" Press ENTER to return...");
-    getchar();
+    wait_for_enter();
 }
@@ -0,0 +1,756 @@
+// SPDX-License-Identifier: GPL-2.0
+/* luka_words.c
+ *
+ * A simple RPN calculator for terminal
+ * made with love in Italy.
+ *
+ * Copyright 2025 Davide Mastromatteo
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+operation_0o get_operation_0o(char*);
+operation_1o get_operation_1o(char*);
+operation_0o_with_parameter get_operation_0o_with_parameter(char*);
+operation_1o get_trigonometric_operation_1o(char*);
+operation_2o get_operation_2o(char*);
+int parse_numeric_input(char*, double*);
+int check_input_if_numeric(char*, double*);
+double random_uniform(unsigned long long*);
+double random_normal(unsigned long long*);
+void push_normal(void);
+
+/* --------------
+   WORD FUNCTIONS
+   -------------- */
+
+/* User defined words work like in Forth: ": vat 1.22 * ;" defines vat.
+   The body is compiled once, when the word is defined, into a program:
+   an array of instructions already pointing to the functions to call,
+   so running a word doesn't look anything up by name.
+   While compiling, small words are inlined in their caller, then the
+   program is optimized: operations on constants are folded and
+   instructions undoing each other (swap swap, roll unroll) are dropped.
+
+   Control flow is compiled to jumps: "if ... else ... then" runs a
+   branch when x isn't 0, "limit start do ... loop" runs the body with
+   the index i going from start to limit - 1 (j is the index of the
+   loop outside), "n times ... loop" runs it n times.
+
+   Instruction kinds:
+   'n' = push a number          value
+   '0' = no operand operation   f0
+   '1' = one operand operation  f1
+   't' = trigonometric op.      f1
+   '2' = two operands operation f2
+   'p' = operation w/ parameter fp, parameter
+   'w' = call a word            callee
+   'b' = jump                   target
+   'z' = pop, jump if 0         target
+   'd' = start a do loop        target = past its loop
+   'x' = start a times loop     target = past its loop
+   'l' = end of a loop          target = start of its body
+   'i' = push a loop index      target = how many loops outside */
+
+struct program;
+
+struct instruction {
+  char kind;
+  int target;
+  union {
+    double value;
+    operation_0o f0;
+    operation_1o f1;
+    operation_2o f2;
+    operation_0o_with_parameter fp;
+    struct program *callee;
+  };
+  char *name;
+  char *parameter;
+};
+
+struct program {
+  struct instruction *code;
+  int length;
+  int capacity;
+  char *strings;
+  struct program *next;
+};
+
+struct word {
+  char *name;
+  struct program *program;
+};
+
+/* A loop running, in a program */
+struct loop {
+  double index;
+  double limit;
+};
+
+/* Tell if an instruction jumps somewhere */
+int is_jump(char kind) {
+  return kind == 'b' || kind == 'z' || kind == 'd' || kind == 'x' || kind == 'l';
+}
+
+/* Tell if a token is a control flow word */
+int is_control_word(char *token) {
+  static char *control_words[] = { "if", "else", "then", "do", "times", "loop", "i", "j" };
+  for (int i = 0; i < (int) (sizeof(control_words) / sizeof(control_words[0])); i++) {
+    if (strcmp(token, control_words[i]) == 0) return 1;
+  }
+  return 0;
+}
+
+/* Allocate an empty program.
+   Every program is kept in a list, so the objects among its
+   constants survive the collector even after a redefinition */
+struct program *program_new(void) {
+  struct program *p = arena_alloc(ARENA_WORDS, sizeof(struct program));
+  p->code = NULL;
+  p->length = 0;
+  p->capacity = 0;
+  p->strings = NULL;
+  p->next = programs;
+  programs = p;
+  return p;
+}
+
+/* Free a program */
+void program_free(struct program *p) {
+  struct program **link = &programs;
+  while (*link != NULL && *link != p) link = &(*link)->next;
+  if (*link == NULL) return;
+  *link = p->next;
+  arena_free(p->code);
+  arena_free(p->strings);
+  arena_free(p);
+}
+
+/* Mark the constants of every program as reachable */
+void mark_programs(void) {
+  for (struct program *p = programs; p != NULL; p = p->next) {
+    for (int i = 0; i < p->length; i++) {
+      if (p->code[i].kind == 'n') mark_value(p->code[i].value);
+    }
+  }
+}
+
+/* Free all the programs and the word table */
+void free_words(void) {
+  while (programs != NULL) program_free(programs);
+  arena_free(words);
+  words = NULL;
+}
+
+/* Append an instruction to a program */
+void program_append(struct program *p, struct instruction instruction) {
+  if (p->length >= p->capacity) {
+    int new_capacity = p->capacity == 0 ? INITIAL_PROGRAM_LENGTH : p->capacity * 2;
+    p->code = arena_realloc(ARENA_WORDS, p->code, new_capacity * sizeof(struct instruction));
+    p->capacity = new_capacity;
+  }
+  p->code[p->length++] = instruction;
+}
+
+/* Remove n instructions from a program, starting at position i,
+   moving the jumps that land past them */
+void program_remove(struct program *p, int i, int n) {
+  memmove(&p->code[i], &p->code[i + n], (p->length - i - n) * sizeof(struct instruction));
+  p->length -= n;
+  for (int k = 0; k < p->length; k++) {
+    struct instruction *c = &p->code[k];
+    if (is_jump(c->kind) && c->target > i) c->target = c->target >= i + n ? c->target - n : i;
+  }
+}
+
+/* Tell if some jump lands on an instruction */
+int is_jump_target(struct program *p, int position) {
+  for (int k = 0; k < p->length; k++) {
+    if (is_jump(p->code[k].kind) && p->code[k].target == position) return 1;
+  }
+  return 0;
+}
+
+/* Search a user defined word */
+struct word *get_word(char *name) {
+  for (int i = 0; i < n_words; i++) {
+    if (strcmp(words[i].name, name) == 0) return &words[i];
+  }
+  return NULL;
+}
+
+/* Compile a single token at the end of a program.
+   Operations taking a parameter consume the next token too:
+   returns the number of tokens used, 0 on error */
+int compile_token(struct program *p, char **tokens, int n) {
+  struct instruction instruction = { 0 };
+  struct word *w;
+  char *token = tokens[0];
+
+  instruction.name = token;
+
+  if (parse_numeric_input(token, &instruction.value)) instruction.kind = 'n';
+  else if ((w = get_word(token))) {
+    // small words are copied in place, the others are called
+    if (w->program->length <= INLINE_WORD_THRESHOLD) {
+      int base = p->length;
+      for (int i = 0; i < w->program->length; i++) {
+        program_append(p, w->program->code[i]);
+        if (is_jump(p->code[p->length - 1].kind)) p->code[p->length - 1].target += base;
+      }
+      return 1;
+    }
+    instruction.kind = 'w';
+    instruction.callee = w->program;
+    instruction.name = w->name;
+  }
+  else if ((instruction.f2 = get_operation_2o(token))) instruction.kind = '2';
+  else if ((instruction.f1 = get_operation_1o(token))) instruction.kind = '1';
+  else if ((instruction.f1 = get_trigonometric_operation_1o(token))) instruction.kind = 't';
+  else if ((instruction.fp = get_operation_0o_with_parameter(token))) {
+    if (n < 2) {
+      sprintf(error_buffer, "ERROR: %s needs a parameter", token);
+      return 0;
+    }
+    instruction.kind = 'p';
+    instruction.parameter = tokens[1];
+    program_append(p, instruction);
+    return 2;
+  }
+  else if ((instruction.f0 = get_operation_0o(token))) instruction.kind = '0';
+  else {
+    sprintf(error_buffer, "ERROR: Unknown word %s", token);
+    return 0;
+  }
+
+  program_append(p, instruction);
+  return 1;
+}
+
+/* Tell if two instructions undo each other */
+int instructions_cancel_out(struct instruction *a, struct instruction *b) {
+  if (a->kind != '0' || b->kind != '0') return 0;
+  if (a->f0 == swap && b->f0 == swap) return 1;
+  if (a->f0 == lroll && b->f0 == rroll) return 1;
+  if (a->f0 == rroll && b->f0 == lroll) return 1;
+  return 0;
+}
+
+/* Optimize a program: fold the operations whose operands are all
+   constants, drop the constants dropped right away and the
+   instructions that undo each other. Repeat until nothing changes */
+void optimize_program(struct program *p) {
+  int changed = 1;
+
+  while (changed) {
+    changed = 0;
+    for (int i = 0; i < p->length; i++) {
+      struct instruction *c = &p->code[i];
+      double r = 0;
+
+      // A jump landing in the middle of a group keeps it as it is
+      if (i >= 1 && is_jump_target(p, i)) continue;
+
+      if (i >= 1 && c->kind == '1' && c[-1].kind == 'n') {
+        int folded = compute_object_operation_1o(c->f1, c[-1].value, &r);
+        if (folded == -1) continue;
+        if (folded == 0) r = c->f1(c[-1].value);
+        c[-1].value = r;
+        program_remove(p, i, 1);
+        changed = 1;
+      }
+      else if (i >= 2 && c->kind == '2' && c[-1].kind == 'n' && c[-2].kind == 'n' && !is_jump_target(p, i - 1)) {
+        int folded = compute_object_operation_2o(c->f2, c[-1].value, c[-2].value, &r);
+        if (folded == -1) continue;
+        if (folded == 0) r = c->f2(c[-1].value, c[-2].value);
+        c[-2].value = r;
+        program_remove(p, i - 1, 2);
+        changed = 1;
+      }
+      else if (i >= 2 && c->kind == '0' && c->f0 == swap && c[-1].kind == 'n' && c[-2].kind == 'n' && !is_jump_target(p, i - 1)) {
+        struct instruction t = c[-1];
+        c[-1] = c[-2];
+        c[-2] = t;
+        program_remove(p, i, 1);
+        changed = 1;
+      }
+      else if (i >= 1 && c->kind == '0' && c->f0 == drop && c[-1].kind == 'n') {
+        program_remove(p, i - 1, 2);
+        changed = 1;
+      }
+      else if (i >= 1 && instructions_cancel_out(&c[-1], c)) {
+        program_remove(p, i - 1, 2);
+        changed = 1;
+      }
+      if (changed) break;
+    }
+  }
+}
+
+/* Split a line in tokens, in place */
+int tokenize(char *input, char **tokens, int max_tokens) {
+  int n = 0;
+  char *token = strtok(input, " ");
+  while (token != NULL && n < max_tokens) {
+    tokens[n++] = token;
+    token = strtok(NULL, " ");
+  }
+  return n;
+}
+
+/* Compile a control flow word, keeping the constructs still open
+   (the positions of their first instruction) in a stack.
+   Returns 0 on error */
+int compile_control_word(struct program *p, char *token, int *open, int *n_open) {
+  struct instruction instruction = { .name = token };
+  int loops = 0;
+  for (int k = 0; k < *n_open; k++) loops += p->code[open[k]].kind != 'z' && p->code[open[k]].kind != 'b';
+  char top = *n_open > 0 ? p->code[open[*n_open - 1]].kind : 0;
+
+  if (strcmp(token, "i") == 0 || strcmp(token, "j") == 0) {
+    instruction.kind = 'i';
+    instruction.target = token[0] == 'j';
+    if (loops <= instruction.target) {
+      sprintf(error_buffer, "ERROR: %s is only known inside %s", token, token[0] == 'i' ? "a loop" : "two loops");
+      return 0;
+    }
+    program_append(p, instruction);
+    return 1;
+  }
+
+  if (strcmp(token, "if") == 0 || strcmp(token, "do") == 0 || strcmp(token, "times") == 0) {
+    if (*n_open == MAX_CONTROL_DEPTH) {
+      sprintf(error_buffer, "ERROR: Too many nested if, do and times");
+      return 0;
+    }
+    instruction.kind = token[0] == 'i' ? 'z' : token[0] == 'd' ? 'd' : 'x';
+    open[(*n_open)++] = p->length;
+    program_append(p, instruction);
+    return 1;
+  }
+
+  if (strcmp(token, "else") == 0) {
+    if (top != 'z') {
+      sprintf(error_buffer, "ERROR: else without if");
+      return 0;
+    }
+    instruction.kind = 'b';
+    program_append(p, instruction);
+    p->code[open[*n_open - 1]].target = p->length;
+    open[*n_open - 1] = p->length - 1;
+    return 1;
+  }
+
+  if (strcmp(token, "then") == 0) {
+    if (top != 'z' && top != 'b') {
+      sprintf(error_buffer, "ERROR: then without if");
+      return 0;
+    }
+    p->code[open[--(*n_open)]].target = p->length;
+    return 1;
+  }
+
+  // loop
+  if (top != 'd' && top != 'x') {
+    sprintf(error_buffer, "ERROR: loop without do or times");
+    return 0;
+  }
+  instruction.kind = 'l';
+  instruction.target = open[*n_open - 1] + 1;
+  program_append(p, instruction);
+  p->code[open[--(*n_open)]].target = p->length;
+  return 1;
+}
+
+/* Compile a list of tokens in a program */
+int compile_tokens(struct program *p, char **tokens, int n) {
+  int open[MAX_CONTROL_DEPTH];
+  int n_open = 0;
+
+  for (int i = 0; i < n; ) {
+    if (is_control_word(tokens[i])) {
+      if (!compile_control_word(p, tokens[i], open, &n_open)) return 0;
+      i++;
+      continue;
+    }
+    int used = compile_token(p, tokens + i, n - i);
+    if (used == 0) return 0;
+    i += used;
+  }
+
+  if (n_open > 0) {
+    sprintf(error_buffer, "ERROR: %s without %s", p->code[open[n_open - 1]].name,
+            p->code[open[n_open - 1]].kind == 'z' || p->code[open[n_open - 1]].kind == 'b' ? "then" : "loop");
+    return 0;
+  }
+  optimize_program(p);
+  return 1;
+}
+
+/* Start a loop from start to limit, returns 0 if it doesn't run at all */
+int loop_start(struct loop *loops, int *depth, double start, double limit) {
+  if (!(start < limit) || *depth == MAX_CONTROL_DEPTH) return 0;
+  loops[*depth].index = start;
+  loops[*depth].limit = limit;
+  (*depth)++;
+  return 1;
+}
+
+/* End an iteration of the innermost loop, returns 1 if it goes round again */
+int loop_next(struct loop *loops, int *depth) {
+  if (*depth == 0) return 0;
+  if (++loops[*depth - 1].index < loops[*depth - 1].limit) return 1;
+  (*depth)--;
+  return 0;
+}
+
+/* Run a program on the stack */
+void run_program(struct program *p) {
+  struct instruction *code = p->code;
+  struct instruction *c = code;
+  struct instruction *end = c + p->length;
+  struct loop loops[MAX_CONTROL_DEPTH];
+  int depth = 0;
+  double start;
+
+  for (; c < end; c++) {
+    switch (c->kind) {
+      case 'n': push(c->value); break;
+      case '0': compute_operation_0o(c->f0); break;
+      case '1': compute_operation_1o(c->f1, c->name); break;
+      case 't': compute_trigonometric_operation_1o(c->f1, c->name); break;
+      case '2': compute_operation_2o(c->f2, c->name); break;
+      case 'p': compute_operation_0o_with_parameter(c->fp, c->parameter); break;
+      case 'w': run_program(c->callee); break;
+      case 'b': c = code + c->target - 1; break;
+      case 'z':
+        if (sp < 1) {
+          sprintf(error_buffer, "ERROR: if needs a value to test");
+          return;
+        }
+        if (to_number(pop()) == 0) c = code + c->target - 1;
+        break;
+      case 'd':
+      case 'x':
+        if (sp < (c->kind == 'd' ? 2 : 1)) {
+          sprintf(error_buffer, "ERROR: %s", c->kind == 'd' ? "do needs a limit and a start" : "times needs a count");
+          return;
+        }
+        start = c->kind == 'd' ? to_number(pop()) : 0;
+        if (!loop_start(loops, &depth, start, to_number(pop()))) c = code + c->target - 1;
+        break;
+      case 'l':
+        // a loop stops at the first error, and can be cancelled
+        if (job_cancelled() || error_buffer[0] != '\0') return;
+        if (loop_next(loops, &depth)) c = code + c->target - 1;
+        break;
+      case 'i': push(c->target < depth ? loops[depth - 1 - c->target].index : 0); break;
+    }
+  }
+}
+
+/* Generator used by rnd and rndn on a private stack, if any */
+_Thread_local unsigned long long *scratch_random = NULL;
+
+/* Set when the private stack belongs to the calculator thread: the
+   memo caches aren't locked, the workers compute everything */
+_Thread_local int scratch_memo = 0;
+
+/* Tell if a program can run on a private stack: it may only use
+   numbers, operations, constants, random values, memories and swap or drop */
+int is_scratch_program(struct program *p) {
+  for (int i = 0; i < p->length; i++) {
+    struct instruction *c = &p->code[i];
+    switch (c->kind) {
+      case 'w':
+        if (!is_scratch_program(c->callee)) return 0;
+        break;
+      case 'p':
+        if (c->fp != load) return 0;
+        break;
+      case '0':
+        if (c->f0 != push_pi && c->f0 != push_e && c->f0 != push_random &&
+            c->f0 != push_normal && c->f0 != swap && c->f0 != drop) return 0;
+        break;
+    }
+  }
+  return 1;
+}
+
+/* Tell if a program draws random values */
+int program_uses_random(struct program *p) {
+  for (int i = 0; i < p->length; i++) {
+    struct instruction *c = &p->code[i];
+    if (c->kind == 'w' && program_uses_random(c->callee)) return 1;
+    if (c->kind == '0' && (c->f0 == push_random || c->f0 == push_normal)) return 1;
+  }
+  return 0;
+}
+
+/* Tell if a program loads memories, whose values may change later */
+int program_uses_memories(struct program *p) {
+  for (int i = 0; i < p->length; i++) {
+    struct instruction *c = &p->code[i];
+    if (c->kind == 'w' && program_uses_memories(c->callee)) return 1;
+    if (c->kind == 'p' && c->fp == load) return 1;
+  }
+  return 0;
+}
+
+/* Run a program on a private stack of doubles, leaving the calculator
+   alone, so that many threads can run it at once on different values.
+   Returns how many values are left in the stack, -1 on error */
+int run_scratch_program(struct program *p, double *s, int n) {
+  struct instruction *code = p->code;
+  struct instruction *c = code;
+  struct instruction *end = c + p->length;
+  struct loop loops[MAX_CONTROL_DEPTH];
+  int depth = 0;
+  double t;
+  int i;
+
+  for (; c < end; c++) {
+    switch (c->kind) {
+      case 'n':
+        if (n >= SCRATCH_STACK_LENGTH) return -1;
+        s[n++] = to_number(c->value);
+        break;
+      case '1':
+        if (n < 1) return -1;
+        s[n - 1] = scratch_memo ? apply_operation_1o(c->f1, s[n - 1]) : c->f1(s[n - 1]);
+        break;
+      case 't':
+        if (n < 1) return -1;
+        t = mode == 'd' ? s[n - 1] * M_PI / 180 : s[n - 1];
+        s[n - 1] = scratch_memo ? apply_operation_1o(c->f1, t) : c->f1(t);
+        break;
+      case '2':
+        if (n < 2) return -1;
+        s[n - 2] = scratch_memo ? apply_operation_2o(c->f2, s[n - 1], s[n - 2]) : c->f2(s[n - 1], s[n - 2]);
+        n--;
+        break;
+      case 'p':
+        if (n >= SCRATCH_STACK_LENGTH) return -1;
+        if (is_shared_name(c->parameter)) {
+          if (!shared_load(c->parameter, &s[n++])) return -1;
+          break;
+        }
+        if ((i = search_memory(c->parameter)) == -1) return -1;
+        s[n++] = to_number(values[i]);
+        break;
+      case 'w':
+        if ((n = run_scratch_program(c->callee, s, n)) < 0) return -1;
+        break;
+      case 'b':
+        c = code + c->target - 1;
+        break;
+      case 'z':
+        if (n < 1) return -1;
+        if (s[--n] == 0) c = code + c->target - 1;
+        break;
+      case 'd':
+        if (n < 2) return -1;
+        n -= 2;
+        if (!loop_start(loops, &depth, s[n + 1], s[n])) c = code + c->target - 1;
+        break;
+      case 'x':
+        if (n < 1) return -1;
+        n--;
+        if (!loop_start(loops, &depth, 0, s[n])) c = code + c->target - 1;
+        break;
+      case 'l':
+        if (job_cancelled()) return -1;
+        if (loop_next(loops, &depth)) c = code + c->target - 1;
+        break;
+      case 'i':
+        if (n >= SCRATCH_STACK_LENGTH) return -1;
+        s[n++] = c->target < depth ? loops[depth - 1 - c->target].index : 0;
+        break;
+      case '0':
+        if (c->f0 == push_pi || c->f0 == push_e) {
+          if (n >= SCRATCH_STACK_LENGTH) return -1;
+          s[n++] = c->f0 == push_pi ? M_PI : M_E;
+        }
+        else if (c->f0 == push_random || c->f0 == push_normal) {
+          if (n >= SCRATCH_STACK_LENGTH || scratch_random == NULL) return -1;
+          s[n++] = c->f0 == push_random ? random_uniform(scratch_random) : random_normal(scratch_random);
+        }
+        else if (c->f0 == swap) {
+          if (n < 2) return -1;
+          t = s[n - 1];
+          s[n - 1] = s[n - 2];
+          s[n - 2] = t;
+        }
+        else if (c->f0 == drop) {
+          if (n < 1) return -1;
+          n--;
+        }
+        else return -1;
+        break;
+      default:
+        return -1;
+    }
+  }
+  return n;
+}
+
+/* Use a program as a function of x, on a private stack */
+double run_scratch_function(struct program *p, double x) {
+  double s[SCRATCH_STACK_LENGTH];
+  s[0] = x;
+  int n = run_scratch_program(p, s, 1);
+  return n >= 1 ? s[n - 1] : NAN;
+}
+
+/* Tell if a program has no objects among its constants */
+int has_only_numbers(struct program *p) {
+  for (int i = 0; i < p->length; i++) {
+    struct instruction *c = &p->code[i];
+    if (c->kind == 'n' && is_object(c->value)) return 0;
+    if (c->kind == 'w' && !has_only_numbers(c->callee)) return 0;
+  }
+  return 1;
+}
+
+/* Run a program on a private copy of the stack, when it only deals
+   with numbers: no journal, no history and no checks on the way, the
+   stack is written back at the end. Returns 0 if it has to run on the
+   calculator stack instead, having changed nothing */
+int run_fast_program(struct program *p) {
+  double s[SCRATCH_STACK_LENGTH];
+
+  if (sp > SCRATCH_STACK_LENGTH || !is_scratch_program(p) || !has_only_numbers(p)) return 0;
+  for (int i = 0; i < sp; i++) if (is_object(stack[i])) return 0;
+  for (int i = 0; i < n_memories; i++) if (is_object(values[i])) return 0;
+
+  memcpy(s, stack, sp * sizeof(double));
+  if (program_uses_random(p)) unrepeatable = 1;
+  scratch_random = random_state;
+  scratch_memo = 1;
+  int n = run_scratch_program(p, s, sp);
+  scratch_memo = 0;
+  scratch_random = NULL;
+  if (n < 0) return job_cancelled();
+
+  while (sp > 0) pop();
+  for (int i = 0; i < n; i++) push(s[i]);
+  return 1;
+}
+
+/* Run a program as a single command: a single entry in the history
+   and a single, collapsed, step in the journal */
+void run_command_program(struct program *p, char *name) {
+  history_suspended++;
+  journal_collapse_begin();
+  if (!run_fast_program(p)) run_program(p);
+  journal_collapse_end();
+  history_suspended--;
+  log_operation_result(name);
+}
+
+/* Run a word: the whole word is a single entry in the history */
+void run_word(struct word *w) {
+  run_command_program(w->program, w->name);
+}
+
+/* Define a word: ": name body ;"
+   The program keeps the line, as its instructions refer to the tokens */
+void define_word(char *input) {
+  char *line = arena_strdup(ARENA_WORDS, input);
+  char *tokens[MAX_INPUT_BUFFER];
+  int n = tokenize(line, tokens, MAX_INPUT_BUFFER);
+  double dummy;
+
+  if (n < 3 || strcmp(tokens[n - 1], ";") != 0) {
+    sprintf(error_buffer, "ERROR: A definition looks like : name body ;");
+    arena_free(line);
+    return;
+  }
+
+  if (parse_numeric_input(tokens[1], &dummy)) {
+    sprintf(error_buffer, "ERROR: A number can't be a word name");
+    arena_free(line);
+    return;
+  }
+
+  if (is_control_word(tokens[1])) {
+    sprintf(error_buffer, "ERROR: %s can't be redefined", tokens[1]);
+    arena_free(line);
+    return;
+  }
+
+  struct program *p = program_new();
+  p->strings = line;
+  if (!compile_tokens(p, tokens + 2, n - 3)) {
+    program_free(p);
+    return;
+  }
+
+  // A redefinition doesn't change the words already compiled with the old one
+  struct word *w = get_word(tokens[1]);
+  if (w == NULL) {
+    if (n_words >= current_words_length) {
+      current_words_length += INCREMENT_WORDS_STEP;
+      words = arena_realloc(ARENA_WORDS, words, current_words_length * sizeof(struct word));
+    }
+    w = &words[n_words++];
+    w->name = tokens[1];
+  }
+  w->program = p;
+}
+
+/* Tell if a line holds more than a command and its parameter */
+int is_command_line(char *input) {
+  char first[MAX_INPUT_BUFFER], second[MAX_INPUT_BUFFER];
+  if (sscanf(input, "%99s %99s", first, second) < 2) return 0;
+  return get_operation_0o_with_parameter(first) == NULL;
+}
+
+/* Tell if a line has two numbers one after the other,
+   which an infix expression never has */
+int has_adjacent_numbers(char *input) {
+  char copy[MAX_INPUT_BUFFER];
+  char *tokens[MAX_INPUT_BUFFER];
+  double value;
+
+  snprintf(copy, sizeof(copy), "%s", input);
+  int n = tokenize(copy, tokens, MAX_INPUT_BUFFER);
+  for (int i = 1; i < n; i++) {
+    if (check_input_if_numeric(tokens[i - 1], &value) && check_input_if_numeric(tokens[i], &value)) return 1;
+  }
+  return 0;
+}
+
+/* Compile a line of commands, like "10 0 do i + loop", as a word
+   without a name. Returns NULL on error */
+struct program *compile_line(char *input) {
+  char *line = arena_strdup(ARENA_WORDS, input);
+  char *tokens[MAX_INPUT_BUFFER];
+  int n = tokenize(line, tokens, MAX_INPUT_BUFFER);
+
+  struct program *p = program_new();
+  p->strings = line;
+  if (!compile_tokens(p, tokens, n)) {
+    program_free(p);
+    return NULL;
+  }
+  return p;
+}
+
+/* Run a line of commands as a single command */
+void run_line(struct program *p, char *input) {
+  run_command_program(p, input);
+  program_free(p);
+}